@@ -1,236 +1,2023 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include <cuda_runtime.h>
+#include <cooperative_groups.h>
+#include <curand_kernel.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
 
-#define G 6.67430e-11f
+namespace cg = cooperative_groups;
+
+#define G 6.67430e-11
 #define DT 0.1f
-#define SOFTENING 1e-5f
+// Смягчение Пламмера: a ~ d / (r^2 + SOFTENING)^(3/2), в квадрате расстояния, чтобы 1/r^3
+// считался одним rsqrt. openmp.c смягчает иначе - d / (r^3 + 1e-10), так что при тесных
+// сближениях траектории двух версий расходятся
+#define SOFTENING 1e-5
 #define OUTPUT_EVERY 10
+#define SNAPSHOT_RING 4
+#define ENERGY_HOST_WARN_N 20000  // выше этого n энергия на хосте тормозит вывод (--energy)
+#define GEN_TOTAL_MASS 1.0e12f  // полная масса сгенерированной системы, кг
+#define GEN_RADIUS 100.0f       // масштаб сгенерированной системы, м
+#define GEN_DEFAULT_N 100000
+#define BODIES_MAGIC "NBIN"
+#define BODIES_VERSION 1
+#define TRAJ_MAGIC "NTRJ"       // бинарные траектории, формат описан в ../openmp/trajectory.h
+#define TRAJ_VERSION 1
+#define TRAJ_DOUBLE 1u
+#define TRAJ_ZLIB 2u
+#define TRAJ_HEADER_BYTES 32
+#define CHECKPOINT_MAGIC "NCKG"
+#define CHECKPOINT_VERSION 1
 
-typedef struct {
-    float x, y, z;
-} Vector3f;
+// Точность расчёта. Real - тип хранения состояния (масса, положения, скорости, ускорения),
+// Calc - тип, в котором считается взаимодействие пары:
+//   fp32  - Real = Calc = float, 1 / r^3 через rsqrtf
+//   fp64  - Real = Calc = double
+//   mixed - состояние в double, разность положений приводится к float и пара считается в float;
+//           частичные суммы каждой плитки добавляются к ускорению в double
+enum Precision { PRECISION_FP32, PRECISION_FP64, PRECISION_MIXED };
 
-__global__ void compute_forces_newton3(float* masses, float* positions, float* accelerations, int n) {
-    int tid = threadIdx.x + blockIdx.x * blockDim.x;
-    int total_pairs = n * (n - 1) / 2;
+static const char* precision_names[] = { "FP32 (rsqrtf)", "FP64", "Mixed (FP64 state, FP32 interactions)" };
 
-    if (tid >= total_pairs) return;
-    int i = 0, j = 0;
-    int remaining = tid;
+// Упакованное тело (x, y, z, m) для плиточного ядра
+template <typename Real> struct Body4;
+template <> struct Body4<float> {
+    typedef float4 type;
+    static __device__ __forceinline__ float4 make(float x, float y, float z, float m) { return make_float4(x, y, z, m); }
+};
+template <> struct Body4<double> {
+    typedef double4 type;
+    static __device__ __forceinline__ double4 make(double x, double y, double z, double m) { return make_double4(x, y, z, m); }
+};
 
-    for (i = 0; i < n - 1; i++) {
-        int pairs_in_row = n - i - 1;
-        if (remaining < pairs_in_row) {
-            j = i + 1 + remaining;
-            break;
-        }
-        remaining -= pairs_in_row;
-    }
+// (r^2 + SOFTENING)^(-3/2) по уже смягчённому квадрату расстояния
+template <typename Calc> __device__ __forceinline__ Calc inv_dist3(Calc dist2);
+template <> __device__ __forceinline__ float inv_dist3<float>(float dist2) {
+    float inv = rsqrtf(dist2);
+    return inv * inv * inv;
+}
+template <> __device__ __forceinline__ double inv_dist3<double>(double dist2) {
+    double inv = rsqrt(dist2);
+    return inv * inv * inv;
+}
 
-    Vector3f ri = {
-        positions[i * 3],
-        positions[i * 3 + 1],
-        positions[i * 3 + 2]
-    };
+#define TILE_SIZE 256
+#define PAIR_GRID_MAX 65536   // Предел сетки ядра compute_forces_newton3
 
-    Vector3f rj = {
-        positions[j * 3],
-        positions[j * 3 + 1],
-        positions[j * 3 + 2]
-    };
+// Номер строки i пары (i, j), i < j, по линейному номеру k в верхнем треугольнике матрицы n x n.
+// Перед строкой i лежит S(i) = i * (2n - i - 1) / 2 пар, i - наибольший корень S(i) <= k;
+// после вычисления в double результат уточняется на случай ошибки округления.
+__device__ __forceinline__ void triangular_pair(long long k, int n, int* pi, int* pj) {
+    double b = 2.0 * n - 1.0;
+    int i = (int)((b - sqrt(b * b - 8.0 * (double)k)) * 0.5);
+    if (i < 0) i = 0;
+    if (i > n - 2) i = n - 2;
+    while (i > 0 && (long long)i * (2LL * n - i - 1) / 2 > k) i--;
+    while (i < n - 2 && (long long)(i + 1) * (2LL * n - i - 2) / 2 <= k) i++;
+    *pi = i;
+    *pj = (int)(k - (long long)i * (2LL * n - i - 1) / 2) + i + 1;
+}
+
+// Третий закон Ньютона: сила пары считается один раз и добавляется обоим телам.
+// Число пар может не поместиться в int, поэтому сетка ограничена PAIR_GRID_MAX блоками, а поток
+// проходит пары с шагом, равным размеру сетки
+template <typename Real, typename Calc>
+__global__ void compute_forces_newton3(Real* masses, Real* positions, Real* accelerations, int n) {
+    long long total_pairs = (long long)n * (n - 1) / 2;
+    long long stride = (long long)gridDim.x * blockDim.x;
 
-    float dx = rj.x - ri.x;
-    float dy = rj.y - ri.y;
-    float dz = rj.z - ri.z;
+    for (long long k = threadIdx.x + (long long)blockIdx.x * blockDim.x; k < total_pairs; k += stride) {
+        int i, j;
+        triangular_pair(k, n, &i, &j);
 
-    float dist2 = dx * dx + dy * dy + dz * dz + SOFTENING;
-    float dist = sqrtf(dist2);
-    float invDist3 = 1.0f / (dist * dist2);
+        Calc dx = (Calc)(positions[j * 3] - positions[i * 3]);
+        Calc dy = (Calc)(positions[j * 3 + 1] - positions[i * 3 + 1]);
+        Calc dz = (Calc)(positions[j * 3 + 2] - positions[i * 3 + 2]);
 
-    float force_mag = G * masses[i] * masses[j] * invDist3;
-    float fx = force_mag * dx / dist;
-    float fy = force_mag * dy / dist;
-    float fz = force_mag * dz / dist;
+        Calc dist2 = dx * dx + dy * dy + dz * dz + (Calc)SOFTENING;
+        Calc force_mag = (Calc)G * (Calc)masses[i] * (Calc)masses[j] * inv_dist3(dist2);
+        Calc fx = force_mag * dx;
+        Calc fy = force_mag * dy;
+        Calc fz = force_mag * dz;
 
-    atomicAdd(&accelerations[i * 3], fx / masses[i]);
-    atomicAdd(&accelerations[i * 3 + 1], fy / masses[i]);
-    atomicAdd(&accelerations[i * 3 + 2], fz / masses[i]);
+        atomicAdd(&accelerations[i * 3], (Real)(fx / (Calc)masses[i]));
+        atomicAdd(&accelerations[i * 3 + 1], (Real)(fy / (Calc)masses[i]));
+        atomicAdd(&accelerations[i * 3 + 2], (Real)(fz / (Calc)masses[i]));
 
-    atomicAdd(&accelerations[j * 3], -fx / masses[j]);
-    atomicAdd(&accelerations[j * 3 + 1], -fy / masses[j]);
-    atomicAdd(&accelerations[j * 3 + 2], -fz / masses[j]);
+        atomicAdd(&accelerations[j * 3], (Real)(-fx / (Calc)masses[j]));
+        atomicAdd(&accelerations[j * 3 + 1], (Real)(-fy / (Calc)masses[j]));
+        atomicAdd(&accelerations[j * 3 + 2], (Real)(-fz / (Calc)masses[j]));
+    }
 }
 
-__global__ void clear_accelerations(float* accelerations, int n) {
+// Упаковка положений и масс в (x, y, z, m) для плиточного ядра
+template <typename Real>
+__device__ __forceinline__ void pack_body(const Real* masses, const Real* positions,
+                                          typename Body4<Real>::type* bodies, int idx) {
+    bodies[idx] = Body4<Real>::make(positions[idx * 3], positions[idx * 3 + 1], positions[idx * 3 + 2], masses[idx]);
+}
+
+template <typename Real>
+__global__ void pack_bodies(Real* masses, Real* positions, typename Body4<Real>::type* bodies, int n) {
     int idx = threadIdx.x + blockIdx.x * blockDim.x;
 
     if (idx >= n) return;
 
-    accelerations[idx * 3] = 0.0f;
-    accelerations[idx * 3 + 1] = 0.0f;
-    accelerations[idx * 3 + 2] = 0.0f;
+    pack_body(masses, positions, bodies, idx);
 }
 
-__global__ void euler_integrate(float* positions, float* velocities, float* accelerations, int n, float dt) {
+// Плиточный расчёт пар для тела i_begin + local по источникам [j_begin, j_end): тела блоками
+// по TILE_SIZE загружаются в shared memory, ускорение накапливается в регистрах и записывается
+// один раз без атомиков (accumulate = 1 - добавляется к уже записанному; accelerations
+// индексируется local). Формула та же, что в compute_forces_newton3; вклад тела в самого себя
+// равен нулю (dx = 0), а хвост последней плитки заполняется нулевыми массами. Вызывается всеми
+// потоками блока (в том числе с local >= i_count), иначе __syncthreads зависнет.
+template <typename Real, typename Calc>
+__device__ __forceinline__ void tiled_body_acceleration(const typename Body4<Real>::type* bodies, Real* accelerations,
+                                                        int local, int i_begin, int i_count,
+                                                        int j_begin, int j_end, int accumulate) {
+    typedef typename Body4<Real>::type Body;
+    __shared__ Body tile[TILE_SIZE];
+
+    int i = i_begin + local;
+    Body bi = local < i_count ? bodies[i] : Body4<Real>::make(0, 0, 0, 0);
+    Real ax = 0, ay = 0, az = 0;
+
+    for (int base = j_begin; base < j_end; base += TILE_SIZE) {
+        int j = base + threadIdx.x;
+        tile[threadIdx.x] = j < j_end ? bodies[j] : Body4<Real>::make(0, 0, 0, 0);
+        __syncthreads();
+
+        Calc tx = 0, ty = 0, tz = 0;
+        #pragma unroll 8
+        for (int k = 0; k < TILE_SIZE; k++) {
+            Body bj = tile[k];
+            Calc dx = (Calc)(bj.x - bi.x);
+            Calc dy = (Calc)(bj.y - bi.y);
+            Calc dz = (Calc)(bj.z - bi.z);
+
+            Calc dist2 = dx * dx + dy * dy + dz * dz + (Calc)SOFTENING;
+            Calc scale = (Calc)G * (Calc)bj.w * inv_dist3(dist2);
+
+            tx += scale * dx;
+            ty += scale * dy;
+            tz += scale * dz;
+        }
+        ax += tx;
+        ay += ty;
+        az += tz;
+        __syncthreads();
+    }
+
+    if (local < i_count) {
+        if (accumulate) {
+            ax += accelerations[local * 3];
+            ay += accelerations[local * 3 + 1];
+            az += accelerations[local * 3 + 2];
+        }
+        accelerations[local * 3] = ax;
+        accelerations[local * 3 + 1] = ay;
+        accelerations[local * 3 + 2] = az;
+    }
+}
+
+// Плиточное ядро всех пар: один поток на тело
+template <typename Real, typename Calc>
+__global__ void compute_forces_tiled(const typename Body4<Real>::type* bodies, Real* accelerations, int n) {
+    tiled_body_acceleration<Real, Calc>(bodies, accelerations, threadIdx.x + blockIdx.x * blockDim.x, 0, n, 0, n, 0);
+}
+
+// Плиточное ядро для части тел [i_begin, i_begin + i_count) и источников [j_begin, j_end)
+template <typename Real, typename Calc>
+__global__ void compute_forces_tiled_range(const typename Body4<Real>::type* bodies, Real* accelerations,
+                                           int i_begin, int i_count, int j_begin, int j_end, int accumulate) {
+    tiled_body_acceleration<Real, Calc>(bodies, accelerations, threadIdx.x + blockIdx.x * blockDim.x,
+                                        i_begin, i_count, j_begin, j_end, accumulate);
+}
+
+template <typename Real>
+__global__ void clear_accelerations(Real* accelerations, int n) {
     int idx = threadIdx.x + blockIdx.x * blockDim.x;
-    
+
     if (idx >= n) return;
-    
-    float vx_old = velocities[idx * 3];
-    float vy_old = velocities[idx * 3 + 1];
-    float vz_old = velocities[idx * 3 + 2];
-    
+
+    accelerations[idx * 3] = 0;
+    accelerations[idx * 3 + 1] = 0;
+    accelerations[idx * 3 + 2] = 0;
+}
+
+template <typename Real>
+__device__ __forceinline__ void euler_body(Real* positions, Real* velocities, const Real* accelerations, int idx, Real dt) {
+    Real vx_old = velocities[idx * 3];
+    Real vy_old = velocities[idx * 3 + 1];
+    Real vz_old = velocities[idx * 3 + 2];
+
     // Формула: v_{n} = v_{n-1} + a_{n-1} * Δt
     velocities[idx * 3] += accelerations[idx * 3] * dt;
     velocities[idx * 3 + 1] += accelerations[idx * 3 + 1] * dt;
     velocities[idx * 3 + 2] += accelerations[idx * 3 + 2] * dt;
-    
+
     // Формула: r_{n} = r_{n-1} + v_{n-1} * Δt
-    positions[idx * 3] += vx_old * dt;   
+    positions[idx * 3] += vx_old * dt;
     positions[idx * 3 + 1] += vy_old * dt;
     positions[idx * 3 + 2] += vz_old * dt;
 }
 
-int main() {
-    int deviceCount;
-    cudaGetDeviceCount(&deviceCount);
-    cudaDeviceProp prop;
-    cudaGetDeviceProperties(&prop, 0);
+template <typename Real>
+__global__ void euler_integrate(Real* positions, Real* velocities, Real* accelerations, int n, Real dt) {
+    int idx = threadIdx.x + blockIdx.x * blockDim.x;
 
-    int n = 3;
-    float* h_masses = (float*)malloc(n * sizeof(float));
-    float* h_positions = (float*)malloc(n * 3 * sizeof(float));
-    float* h_velocities = (float*)malloc(n * 3 * sizeof(float));
-    float* h_accelerations = (float*)malloc(n * 3 * sizeof(float));
-    h_masses[0] = 1.0e6f;
-    h_masses[1] = 1.0e3f;
-    h_masses[2] = 1.0e3f;
+    if (idx >= n) return;
+
+    euler_body(positions, velocities, accelerations, idx, dt);
+}
+
+// Leapfrog (kick-drift-kick): полшага скорости и полный шаг положения одним ядром
+template <typename Real>
+__device__ __forceinline__ void leapfrog_kick_drift_body(Real* positions, Real* velocities, const Real* accelerations, int idx, Real dt) {
+    Real half_dt = (Real)0.5 * dt;
+    for (int d = 0; d < 3; d++) {
+        velocities[idx * 3 + d] += accelerations[idx * 3 + d] * half_dt;
+        positions[idx * 3 + d] += velocities[idx * 3 + d] * dt;
+    }
+}
+
+template <typename Real>
+__global__ void leapfrog_kick_drift(Real* positions, Real* velocities, Real* accelerations, int n, Real dt) {
+    int idx = threadIdx.x + blockIdx.x * blockDim.x;
+
+    if (idx >= n) return;
+
+    leapfrog_kick_drift_body(positions, velocities, accelerations, idx, dt);
+}
+
+// Второй полшаг скорости по ускорениям в новых положениях
+template <typename Real>
+__device__ __forceinline__ void leapfrog_kick_body(Real* velocities, const Real* accelerations, int idx, Real dt) {
+    Real half_dt = (Real)0.5 * dt;
+    velocities[idx * 3] += accelerations[idx * 3] * half_dt;
+    velocities[idx * 3 + 1] += accelerations[idx * 3 + 1] * half_dt;
+    velocities[idx * 3 + 2] += accelerations[idx * 3 + 2] * half_dt;
+}
+
+template <typename Real>
+__global__ void leapfrog_kick(Real* velocities, Real* accelerations, int n, Real dt) {
+    int idx = threadIdx.x + blockIdx.x * blockDim.x;
+
+    if (idx >= n) return;
+
+    leapfrog_kick_body(velocities, accelerations, idx, dt);
+}
+
+// Персистентное ядро: весь пакет шагов (Эйлер или leapfrog, плиточные силы) за один запуск.
+// Фазы шага разделяются grid.sync(), поэтому ядро запускается только кооперативно
+// и с числом блоков не больше, чем одновременно помещается на устройстве.
+template <typename Real, typename Calc>
+__global__ void persistent_time_loop(Real* masses, Real* positions, Real* velocities, Real* accelerations,
+                                     typename Body4<Real>::type* bodies, int n, Real dt, int steps, int leapfrog) {
+    cg::grid_group grid = cg::this_grid();
+    int first = threadIdx.x + blockIdx.x * blockDim.x;
+    int stride = gridDim.x * blockDim.x;
+
+    for (int s = 0; s < steps; s++) {
+        if (leapfrog) {
+            for (int idx = first; idx < n; idx += stride) {
+                leapfrog_kick_drift_body(positions, velocities, accelerations, idx, dt);
+            }
+            grid.sync();
+        }
+
+        for (int idx = first; idx < n; idx += stride) {
+            pack_body(masses, positions, bodies, idx);
+        }
+        grid.sync();
+
+        // Граница цикла одинакова для всех потоков блока (см. tiled_body_acceleration)
+        for (int base = blockIdx.x * blockDim.x; base < n; base += stride) {
+            tiled_body_acceleration<Real, Calc>(bodies, accelerations, base + threadIdx.x, 0, n, 0, n, 0);
+        }
+        grid.sync();
+
+        for (int idx = first; idx < n; idx += stride) {
+            if (leapfrog) {
+                leapfrog_kick_body(velocities, accelerations, idx, dt);
+            } else {
+                euler_body(positions, velocities, accelerations, idx, dt);
+            }
+        }
+        grid.sync();
+    }
+}
+
+// RK4: накопление стадии (k_vel, k_acc) с весом w в суммы и подготовка следующей стадии
+// stage = state + c * k одним проходом; first = 1 для k1 (суммы инициализируются)
+template <typename Real>
+__global__ void rk4_accumulate(Real* positions, Real* velocities, Real* k_vel, Real* k_acc,
+                               Real* stage_pos, Real* stage_vel, Real* sum_pos, Real* sum_vel,
+                               int n, Real w, Real c, int first) {
+    int idx = threadIdx.x + blockIdx.x * blockDim.x;
+
+    if (idx >= n * 3) return;
+
+    Real kv = k_vel[idx];
+    Real ka = k_acc[idx];
+    sum_pos[idx] = first ? kv : sum_pos[idx] + w * kv;
+    sum_vel[idx] = first ? ka : sum_vel[idx] + w * ka;
+    stage_pos[idx] = positions[idx] + c * kv;
+    stage_vel[idx] = velocities[idx] + c * ka;
+}
+
+// RK4: итог шага state += dt/6 * (k1 + 2 k2 + 2 k3 + k4)
+template <typename Real>
+__global__ void rk4_finish(Real* positions, Real* velocities, Real* sum_pos, Real* sum_vel,
+                           Real* k4_vel, Real* k4_acc, int n, Real dt) {
+    int idx = threadIdx.x + blockIdx.x * blockDim.x;
 
-    h_positions[0] = 0.0f; h_positions[1] = 0.0f; h_positions[2] = 0.0f;
-    h_positions[3] = 5.0f; h_positions[4] = 0.0f; h_positions[5] = 0.0f;
-    h_positions[6] = 0.0f; h_positions[7] = 5.0f; h_positions[8] = 0.0f;
-    float v_orbit = sqrtf(G * h_masses[0] / 5.0f);
+    if (idx >= n * 3) return;
+
+    Real w = dt / (Real)6.0;
+    positions[idx] += w * (sum_pos[idx] + k4_vel[idx]);
+    velocities[idx] += w * (sum_vel[idx] + k4_acc[idx]);
+}
+
+// Полная энергия системы (на хосте, в double): кинетическая плюс -G m_i m_j / r_ij.
+// Расчёт O(n^2) на одном ядре идёт в потоке-писателе в каждой точке вывода, поэтому при
+// большом n с --energy писатель не успевает и цикл ждёт свободный слот кольца снимков
+template <typename Real>
+double total_energy(const Real* masses, const Real* positions, const Real* velocities, int n) {
+    double kinetic = 0.0, potential = 0.0;
+    for (int i = 0; i < n; i++) {
+        double v2 = 0.0;
+        for (int d = 0; d < 3; d++) {
+            v2 += (double)velocities[i * 3 + d] * velocities[i * 3 + d];
+        }
+        kinetic += 0.5 * masses[i] * v2;
+        for (int j = i + 1; j < n; j++) {
+            double dx = (double)positions[j * 3] - positions[i * 3];
+            double dy = (double)positions[j * 3 + 1] - positions[i * 3 + 1];
+            double dz = (double)positions[j * 3 + 2] - positions[i * 3 + 2];
+            potential -= G * masses[i] * masses[j] / sqrt(dx * dx + dy * dy + dz * dz);
+        }
+    }
+    return kinetic + potential;
+}
+
+enum Integrator { INTEGRATOR_EULER, INTEGRATOR_LEAPFROG, INTEGRATOR_RK4 };
+
+static const char* integrator_names[] = { "Explicit Euler", "Leapfrog (KDK Velocity Verlet)", "Runge-Kutta 4" };
+
+enum ForceKernel { FORCES_TILED, FORCES_NEWTON3 };
+
+static const char* force_kernel_names[] = { "Tiled all-pairs (shared memory, no atomics)", "Newton's 3rd law pairs (atomics)" };
+
+enum LoopMode { LOOP_GRAPH, LOOP_STREAM, LOOP_PERSISTENT };
+
+static const char* loop_mode_names[] = { "CUDA Graph per output batch", "Stream launches", "Persistent cooperative kernel" };
+
+// Параметры запуска ядер; все ядра ставятся в один поток без синхронизации с хостом
+template <typename Real>
+struct LaunchConfig {
+    ForceKernel kernel;
+    typename Body4<Real>::type* d_bodies;   // упакованные тела для плиточного ядра
+    int grid_size_forces;
+    int grid_size_pairs;
+    int grid_size_components;
+    int block_size;
+    cudaStream_t stream;
+};
+
+// Состояние системы на устройстве и буферы промежуточных стадий RK4
+template <typename Real>
+struct DeviceState {
+    Real* masses;
+    Real* positions;
+    Real* velocities;
+    Real* accelerations;
+    Real* stage_pos;
+    Real* stage_vel;
+    Real* stage_acc;
+    Real* sum_pos;
+    Real* sum_vel;
+};
+
+// Вычисление ускорений для заданных положений выбранным ядром
+template <typename Real, typename Calc>
+static void compute_accelerations(Real* d_masses, Real* d_positions, Real* d_accelerations, int n,
+                                  const LaunchConfig<Real>* launch) {
+    if (launch->kernel == FORCES_TILED) {
+        pack_bodies<<<launch->grid_size_forces, launch->block_size, 0, launch->stream>>>(d_masses, d_positions, launch->d_bodies, n);
+        compute_forces_tiled<Real, Calc><<<launch->grid_size_forces, TILE_SIZE, 0, launch->stream>>>(launch->d_bodies, d_accelerations, n);
+        return;
+    }
+    clear_accelerations<<<launch->grid_size_forces, launch->block_size, 0, launch->stream>>>(d_accelerations, n);
+    if (n > 1) {
+        compute_forces_newton3<Real, Calc><<<launch->grid_size_pairs, launch->block_size, 0, launch->stream>>>(d_masses, d_positions, d_accelerations, n);
+    }
+}
+
+// Постановка в поток одного шага выбранной схемы
+template <typename Real, typename Calc>
+static void enqueue_step(Integrator integrator, const DeviceState<Real>* d, int n, Real dt, const LaunchConfig<Real>* launch) {
+    int grid = launch->grid_size_forces;
+    int grid_components = launch->grid_size_components;
+    int block = launch->block_size;
+    cudaStream_t stream = launch->stream;
+
+    if (integrator == INTEGRATOR_LEAPFROG) {
+        leapfrog_kick_drift<<<grid, block, 0, stream>>>(d->positions, d->velocities, d->accelerations, n, dt);
+        compute_accelerations<Real, Calc>(d->masses, d->positions, d->accelerations, n, launch);
+        leapfrog_kick<<<grid, block, 0, stream>>>(d->velocities, d->accelerations, n, dt);
+    } else if (integrator == INTEGRATOR_RK4) {
+        compute_accelerations<Real, Calc>(d->masses, d->positions, d->accelerations, n, launch);
+        rk4_accumulate<<<grid_components, block, 0, stream>>>(d->positions, d->velocities, d->velocities, d->accelerations,
+            d->stage_pos, d->stage_vel, d->sum_pos, d->sum_vel, n, (Real)1.0, (Real)0.5 * dt, 1);
+        compute_accelerations<Real, Calc>(d->masses, d->stage_pos, d->stage_acc, n, launch);
+        rk4_accumulate<<<grid_components, block, 0, stream>>>(d->positions, d->velocities, d->stage_vel, d->stage_acc,
+            d->stage_pos, d->stage_vel, d->sum_pos, d->sum_vel, n, (Real)2.0, (Real)0.5 * dt, 0);
+        compute_accelerations<Real, Calc>(d->masses, d->stage_pos, d->stage_acc, n, launch);
+        rk4_accumulate<<<grid_components, block, 0, stream>>>(d->positions, d->velocities, d->stage_vel, d->stage_acc,
+            d->stage_pos, d->stage_vel, d->sum_pos, d->sum_vel, n, (Real)2.0, dt, 0);
+        compute_accelerations<Real, Calc>(d->masses, d->stage_pos, d->stage_acc, n, launch);
+        rk4_finish<<<grid_components, block, 0, stream>>>(d->positions, d->velocities, d->sum_pos, d->sum_vel,
+            d->stage_vel, d->stage_acc, n, dt);
+    } else {
+        compute_accelerations<Real, Calc>(d->masses, d->positions, d->accelerations, n, launch);
+        euler_integrate<<<grid, block, 0, stream>>>(d->positions, d->velocities, d->accelerations, n, dt);
+    }
+}
+
+// Запуск персистентного ядра на steps шагов
+template <typename Real, typename Calc>
+static void launch_persistent(const DeviceState<Real>* d, int n, Real dt, int steps, Integrator integrator,
+                              const LaunchConfig<Real>* launch, int persistent_blocks) {
+    Real* masses = d->masses;
+    Real* positions = d->positions;
+    Real* velocities = d->velocities;
+    Real* accelerations = d->accelerations;
+    typename Body4<Real>::type* bodies = launch->d_bodies;
+    int leapfrog = integrator == INTEGRATOR_LEAPFROG;
+    void* args[] = { &masses, &positions, &velocities, &accelerations, &bodies, &n, &dt, &steps, &leapfrog };
+    cudaLaunchCooperativeKernel((void*)persistent_time_loop<Real, Calc>, persistent_blocks, TILE_SIZE, args, 0, launch->stream);
+}
 
-    h_velocities[0] = 0.0f; h_velocities[1] = 0.0f; h_velocities[2] = 0.0f;
-    h_velocities[3] = 0.0f; h_velocities[4] = v_orbit; h_velocities[5] = 0.0f;
-    h_velocities[6] = -v_orbit; h_velocities[7] = 0.0f; h_velocities[8] = 0.0f; 
+// Вывод траекторий: по умолчанию кадры trajectories.bin в формате ../openmp/trajectory.h
+// (в CSV переводит openmp/traj2csv), trajectories.csv включается --output=csv для небольших N
+struct TrajectoryOutput {
+    FILE* fout;
+    const char* path;
+    int csv;
+    uint32_t flags;
+    int stride;             // сохраняется каждое stride-е тело
+    int n;
+    int stored;
+    size_t raw_bytes;
+    unsigned char* raw;     // кадр float/double x, y, z сохранённых тел
+    unsigned char* packed;  // перемешанный по разрядам и сжатый кадр (TRAJ_ZLIB)
+    size_t packed_capacity;
+};
 
-    for (int i = 0; i < n * 3; i++) {
-        h_accelerations[i] = 0.0f;
+// offset > 0 - продолжение после рестарта: файл обрезается до длины на момент контрольной точки
+static int trajectory_open(TrajectoryOutput* out, int csv, int n, int stride, uint32_t flags, uint64_t offset) {
+    memset(out, 0, sizeof(*out));
+    out->csv = csv;
+    out->n = n;
+    out->path = csv ? "trajectories.csv" : "trajectories.bin";
+    out->fout = fopen(out->path, offset > 0 ? (csv ? "r+" : "r+b") : (csv ? "w" : "wb"));
+    if (!out->fout) {
+        printf("Error: Cannot open %s for writing\n", out->path);
+        return -1;
     }
+    if (offset > 0) {
+        // Кадры, записанные после контрольной точки, будут посчитаны заново
+        // (совпадение заголовка бинарного файла проверяется ниже)
+        // Длина проверяется до ftruncate: короткий файл он дополнил бы нулями
+        if (fseek(out->fout, 0, SEEK_END) != 0 || (uint64_t)ftell(out->fout) < offset ||
+            ftruncate(fileno(out->fout), (off_t)offset) != 0 || fseek(out->fout, 0, SEEK_END) != 0) {
+            printf("Error: %s is shorter than the checkpoint expects\n", out->path);
+            return -1;
+        }
+        if (csv) {
+            return 0;
+        }
+    }
+    if (csv) {
+        fprintf(out->fout, "t");
+        for (int i = 0; i < n; i++) {
+            fprintf(out->fout, ",x%d,y%d,z%d", i+1, i+1, i+1);
+        }
+        fprintf(out->fout, "\n");
+        return 0;
+    }
+
+#ifndef USE_ZLIB
+    if (flags & TRAJ_ZLIB) {
+        printf("Error: trajectory compression requires a build with -DUSE_ZLIB -lz\n");
+        return -1;
+    }
+#endif
+    out->flags = flags;
+    out->stride = stride;
+    out->stored = (n + stride - 1) / stride;
+    out->raw_bytes = (size_t)out->stored * 3 * ((flags & TRAJ_DOUBLE) ? sizeof(double) : sizeof(float));
+    out->raw = (unsigned char*)malloc(out->raw_bytes ? out->raw_bytes : 1);
+#ifdef USE_ZLIB
+    if (flags & TRAJ_ZLIB) {
+        out->packed_capacity = compressBound(out->raw_bytes);
+        out->packed = (unsigned char*)malloc(out->packed_capacity + out->raw_bytes + 1);
+    }
+#endif
+    if (!out->raw || ((flags & TRAJ_ZLIB) && !out->packed)) {
+        printf("Error: cannot allocate trajectory buffers\n");
+        return -1;
+    }
+
+    uint32_t version = TRAJ_VERSION;
+    uint32_t stride32 = (uint32_t)stride;
+    uint64_t n64 = (uint64_t)n, stored64 = (uint64_t)out->stored;
+    unsigned char header[TRAJ_HEADER_BYTES];
+    memcpy(header, TRAJ_MAGIC, 4);
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &out->flags, 4);
+    memcpy(header + 12, &stride32, 4);
+    memcpy(header + 16, &n64, 8);
+    memcpy(header + 24, &stored64, 8);
+    if (offset > 0) {
+        unsigned char existing[TRAJ_HEADER_BYTES];
+        if (offset < TRAJ_HEADER_BYTES || fseek(out->fout, 0, SEEK_SET) != 0 ||
+            fread(existing, 1, sizeof(existing), out->fout) != sizeof(existing) ||
+            memcmp(existing, header, sizeof(header)) != 0 || fseek(out->fout, 0, SEEK_END) != 0) {
+            printf("Error: %s does not match the restarted run\n", out->path);
+            return -1;
+        }
+        return 0;
+    }
+    fwrite(header, 1, sizeof(header), out->fout);
+    return 0;
+}
+
+// Длина уже записанной части траектории - для контрольной точки
+static uint64_t trajectory_offset(TrajectoryOutput* out) {
+    fflush(out->fout);
+    return (uint64_t)ftell(out->fout);
+}
+
+// Один кадр: положения хранятся как x, y, z подряд для каждого тела
+// Кадр в момент t; -1, если кадр не записан целиком (как traj_write_frame в openmp)
+template <typename Real>
+static int trajectory_write(TrajectoryOutput* out, float t, const Real* pos) {
+    if (out->csv) {
+        fprintf(out->fout, "%.6f", t);
+        for (int i = 0; i < out->n; i++) {
+            fprintf(out->fout, ",%.6f,%.6f,%.6f", (double)pos[i*3], (double)pos[i*3+1], (double)pos[i*3+2]);
+        }
+        fprintf(out->fout, "\n");
+        return fflush(out->fout) == 0 && !ferror(out->fout) ? 0 : -1;
+    }
+
+    size_t stride = out->stride;
+    if (out->flags & TRAJ_DOUBLE) {
+        double* raw = (double*)out->raw;
+        for (size_t k = 0; k < (size_t)out->stored; k++) {
+            raw[3*k] = (double)pos[k*stride*3];
+            raw[3*k+1] = (double)pos[k*stride*3+1];
+            raw[3*k+2] = (double)pos[k*stride*3+2];
+        }
+    } else {
+        float* raw = (float*)out->raw;
+        for (size_t k = 0; k < (size_t)out->stored; k++) {
+            raw[3*k] = (float)pos[k*stride*3];
+            raw[3*k+1] = (float)pos[k*stride*3+1];
+            raw[3*k+2] = (float)pos[k*stride*3+2];
+        }
+    }
+
+    const unsigned char* data = out->raw;
+    uint64_t bytes = out->raw_bytes;
+#ifdef USE_ZLIB
+    if (out->flags & TRAJ_ZLIB) {
+        size_t size = (out->flags & TRAJ_DOUBLE) ? sizeof(double) : sizeof(float);
+        size_t count = 3 * (size_t)out->stored;
+        unsigned char* shuffled = out->packed + out->packed_capacity;
+        for (size_t b = 0; b < size; b++) {
+            for (size_t i = 0; i < count; i++) {
+                shuffled[b * count + i] = out->raw[i * size + b];
+            }
+        }
+        uLongf packed_bytes = out->packed_capacity;
+        if (compress2(out->packed, &packed_bytes, shuffled, out->raw_bytes, Z_BEST_SPEED) != Z_OK) {
+            return -1;
+        }
+        data = out->packed;
+        bytes = packed_bytes;
+    }
+#endif
+
+    double t64 = t;
+    if (fwrite(&t64, sizeof(t64), 1, out->fout) != 1 ||
+        fwrite(&bytes, sizeof(bytes), 1, out->fout) != 1 ||
+        fwrite(data, 1, bytes, out->fout) != bytes) {
+        return -1;
+    }
+    return fflush(out->fout) == 0 ? 0 : -1;
+}
+
+static void trajectory_close(TrajectoryOutput* out) {
+    if (out->fout) {
+        fclose(out->fout);
+    }
+    free(out->raw);
+    free(out->packed);
+}
+
+// Контрольная точка: заголовок и полное состояние (m, r, v, a) в типе хранения Real.
+// Длина файла траекторий на момент точки позволяет после --restart продолжить вывод
+// с того же места, так что расчёт и траектория совпадают бит в бит с непрерывным
+// (кроме ядра newton3: порядок его атомарных сложений не фиксирован и без рестарта)
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t n;
+    int32_t precision;
+    int32_t integrator;
+    int32_t force_kernel;
+    int32_t gpus;
+    int32_t step;
+    float t;
+    float dt;
+    uint64_t output_offset;
+    double energy0;
+    double max_drift;
+} CheckpointHeader;
+
+// Запись во временный файл, fsync и атомарное переименование: на диске всегда целая точка
+template <typename Real>
+static int write_checkpoint(const char* path, const CheckpointHeader* h, const Real* masses, const Real* positions,
+                            const Real* velocities, const Real* accelerations) {
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        return -1;
+    }
+    FILE* fout = fopen(tmp_path, "wb");
+    if (!fout) {
+        return -1;
+    }
+    size_t count = (size_t)h->n * 3;
+    int rc = fwrite(h, sizeof(*h), 1, fout) == 1 &&
+             fwrite(masses, sizeof(Real), h->n, fout) == (size_t)h->n &&
+             fwrite(positions, sizeof(Real), count, fout) == count &&
+             fwrite(velocities, sizeof(Real), count, fout) == count &&
+             fwrite(accelerations, sizeof(Real), count, fout) == count ? 0 : -1;
+    if (fflush(fout) != 0 || fsync(fileno(fout)) != 0) {
+        rc = -1;
+    }
+    if (fclose(fout) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+// Кольцо снимков траектории. В точке вывода положения (и скорости при --energy) копируются
+// на устройстве во временный буфер слота прямо в потоке вычислений, после чего отдельный
+// поток копирования переносит их в закреплённую память хоста. Расчёт сразу продолжается,
+// а форматированием и записью занимается поток-писатель; хост ждёт только если заняты
+// все SNAPSHOT_RING слотов. Снимок с флагом checkpoint несёт ещё скорости и ускорения:
+// после записи кадра писатель сохраняет по нему контрольную точку.
+template <typename Real>
+struct Snapshot {
+    Real* positions;       // закреплённая память хоста
+    Real* velocities;
+    Real* accelerations;
+    Real* d_positions;     // копия на устройстве на момент снимка
+    Real* d_velocities;
+    Real* d_accelerations;
+    cudaEvent_t copied;
+    float t;
+    int step;
+    int checkpoint;
+};
+
+template <typename Real>
+struct SnapshotWriter {
+    Snapshot<Real> slots[SNAPSHOT_RING];
+    int head;               // следующий слот для записи снимка
+    int count;              // снимков, ожидающих писателя
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    cudaStream_t copy_stream;
+    cudaEvent_t batch_done;
+    TrajectoryOutput* out;
+    const Real* masses;
+    int n;
+    float t_end;
+    int report_energy;
+    double energy0;
+    double max_drift;
+    const char* checkpoint_path;    // NULL - без контрольных точек
+    CheckpointHeader checkpoint;    // неизменные поля заголовка точки
+    int checkpoint_errors;
+    int failed;             // кадр траектории не записан: расчёт останавливается
+};
+
+template <typename Real>
+static void* snapshot_writer_main(void* arg) {
+    SnapshotWriter<Real>* w = (SnapshotWriter<Real>*)arg;
+    int tail = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        while (w->count == 0 && !w->done) {
+            pthread_cond_wait(&w->changed, &w->lock);
+        }
+        if (w->count == 0) {
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+        pthread_mutex_unlock(&w->lock);
+
+        Snapshot<Real>* snap = &w->slots[tail];
+        cudaEventSynchronize(snap->copied);
+
+        const Real* pos = snap->positions;
+        // После ошибки кадры больше не пишутся, снимки только освобождаются
+        pthread_mutex_lock(&w->lock);
+        int failed = w->failed;
+        pthread_mutex_unlock(&w->lock);
+        if (!failed && trajectory_write(w->out, snap->t, pos) != 0) {
+            printf("Error: cannot write trajectory frame at t = %.3f to %s\n", snap->t, w->out->path);
+            pthread_mutex_lock(&w->lock);
+            w->failed = 1;
+            pthread_mutex_unlock(&w->lock);
+            failed = 1;
+        }
+        if (failed) {
+            tail = (tail + 1) % SNAPSHOT_RING;
+            pthread_mutex_lock(&w->lock);
+            w->count--;
+            pthread_cond_signal(&w->changed);
+            pthread_mutex_unlock(&w->lock);
+            continue;
+        }
+        if (w->report_energy) {
+            double drift = fabs((total_energy(w->masses, pos, snap->velocities, w->n) - w->energy0) / w->energy0);
+            w->max_drift = drift > w->max_drift ? drift : w->max_drift;
+        }
+        if (w->n >= 3) {
+            printf("%6.1f  (%7.3f,%7.3f)   (%7.3f,%7.3f)   %5.1f%%\n",
+                   snap->t,
+                   pos[3], pos[4],
+                   pos[6], pos[7],
+                   (snap->t / w->t_end) * 100.0f);
+        } else {
+            printf("%6.1f   %5.1f%%\n", snap->t, (snap->t / w->t_end) * 100.0f);
+        }
+        if (snap->checkpoint) {
+            CheckpointHeader h = w->checkpoint;
+            h.step = snap->step;
+            h.t = snap->t;
+            h.max_drift = w->max_drift;
+            h.output_offset = trajectory_offset(w->out);
+            if (write_checkpoint(w->checkpoint_path, &h, w->masses, pos, snap->velocities, snap->accelerations) != 0) {
+                printf("Error: cannot write checkpoint %s\n", w->checkpoint_path);
+                w->checkpoint_errors++;
+            }
+        }
+
+        tail = (tail + 1) % SNAPSHOT_RING;
+        pthread_mutex_lock(&w->lock);
+        w->count--;
+        pthread_cond_signal(&w->changed);
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    return NULL;
+}
+
+template <typename Real>
+static void snapshot_writer_start(SnapshotWriter<Real>* w, TrajectoryOutput* out, const Real* masses, int n, float t_end,
+                                  int report_energy, double energy0, double max_drift,
+                                  const char* checkpoint_path, const CheckpointHeader* checkpoint) {
+    memset(w, 0, sizeof(*w));
+    w->out = out;
+    w->masses = masses;
+    w->n = n;
+    w->t_end = t_end;
+    w->report_energy = report_energy;
+    w->energy0 = energy0;
+    w->max_drift = max_drift;
+    w->checkpoint_path = checkpoint_path;
+    if (checkpoint) {
+        w->checkpoint = *checkpoint;
+    }
+
+    for (int k = 0; k < SNAPSHOT_RING; k++) {
+        Snapshot<Real>* snap = &w->slots[k];
+        cudaHostAlloc(&snap->positions, n * 3 * sizeof(Real), cudaHostAllocDefault);
+        cudaMalloc(&snap->d_positions, n * 3 * sizeof(Real));
+        if (report_energy || checkpoint_path) {
+            cudaHostAlloc(&snap->velocities, n * 3 * sizeof(Real), cudaHostAllocDefault);
+            cudaMalloc(&snap->d_velocities, n * 3 * sizeof(Real));
+        }
+        if (checkpoint_path) {
+            cudaHostAlloc(&snap->accelerations, n * 3 * sizeof(Real), cudaHostAllocDefault);
+            cudaMalloc(&snap->d_accelerations, n * 3 * sizeof(Real));
+        }
+        cudaEventCreateWithFlags(&snap->copied, cudaEventDisableTiming);
+    }
+    cudaStreamCreateWithFlags(&w->copy_stream, cudaStreamNonBlocking);
+    cudaEventCreateWithFlags(&w->batch_done, cudaEventDisableTiming);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->changed, NULL);
+    pthread_create(&w->thread, NULL, snapshot_writer_main<Real>, w);
+}
+
+// Снимок состояния после всех работ, поставленных в compute_stream
+template <typename Real>
+static void snapshot_writer_push(SnapshotWriter<Real>* w, cudaStream_t compute_stream, const Real* d_positions,
+                                 const Real* d_velocities, const Real* d_accelerations, float t, int step, int checkpoint) {
+    pthread_mutex_lock(&w->lock);
+    while (w->count == SNAPSHOT_RING) {
+        pthread_cond_wait(&w->changed, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    Snapshot<Real>* snap = &w->slots[w->head];
+    size_t bytes = w->n * 3 * sizeof(Real);
+    snap->t = t;
+    snap->step = step;
+    snap->checkpoint = checkpoint;
+    int with_velocities = w->report_energy || checkpoint;
+    cudaMemcpyAsync(snap->d_positions, d_positions, bytes, cudaMemcpyDeviceToDevice, compute_stream);
+    if (with_velocities) {
+        cudaMemcpyAsync(snap->d_velocities, d_velocities, bytes, cudaMemcpyDeviceToDevice, compute_stream);
+    }
+    if (checkpoint) {
+        cudaMemcpyAsync(snap->d_accelerations, d_accelerations, bytes, cudaMemcpyDeviceToDevice, compute_stream);
+    }
+    cudaEventRecord(w->batch_done, compute_stream);
+    cudaStreamWaitEvent(w->copy_stream, w->batch_done, 0);
+    cudaMemcpyAsync(snap->positions, snap->d_positions, bytes, cudaMemcpyDeviceToHost, w->copy_stream);
+    if (with_velocities) {
+        cudaMemcpyAsync(snap->velocities, snap->d_velocities, bytes, cudaMemcpyDeviceToHost, w->copy_stream);
+    }
+    if (checkpoint) {
+        cudaMemcpyAsync(snap->accelerations, snap->d_accelerations, bytes, cudaMemcpyDeviceToHost, w->copy_stream);
+    }
+    cudaEventRecord(snap->copied, w->copy_stream);
+    w->head = (w->head + 1) % SNAPSHOT_RING;
+
+    pthread_mutex_lock(&w->lock);
+    w->count++;
+    pthread_cond_signal(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Дожидается записи всех снимков и освобождает кольцо
+template <typename Real>
+static int snapshot_writer_failed(SnapshotWriter<Real>* w) {
+    pthread_mutex_lock(&w->lock);
+    int failed = w->failed;
+    pthread_mutex_unlock(&w->lock);
+    return failed;
+}
+
+template <typename Real>
+static void snapshot_writer_finish(SnapshotWriter<Real>* w) {
+    pthread_mutex_lock(&w->lock);
+    w->done = 1;
+    pthread_cond_signal(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    for (int k = 0; k < SNAPSHOT_RING; k++) {
+        Snapshot<Real>* snap = &w->slots[k];
+        cudaFreeHost(snap->positions);
+        cudaFreeHost(snap->velocities);
+        cudaFreeHost(snap->accelerations);
+        cudaFree(snap->d_positions);
+        cudaFree(snap->d_velocities);
+        cudaFree(snap->d_accelerations);
+        cudaEventDestroy(snap->copied);
+    }
+    cudaStreamDestroy(w->copy_stream);
+    cudaEventDestroy(w->batch_done);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->changed);
+}
+
+// Снимок из массивов хоста (многопроцессорный режим собирает состояние сам)
+template <typename Real>
+static void snapshot_writer_push_host(SnapshotWriter<Real>* w, const Real* positions, const Real* velocities,
+                                      const Real* accelerations, float t, int step, int checkpoint) {
+    pthread_mutex_lock(&w->lock);
+    while (w->count == SNAPSHOT_RING) {
+        pthread_cond_wait(&w->changed, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    Snapshot<Real>* snap = &w->slots[w->head];
+    size_t bytes = w->n * 3 * sizeof(Real);
+    snap->t = t;
+    snap->step = step;
+    snap->checkpoint = checkpoint;
+    memcpy(snap->positions, positions, bytes);
+    if (w->report_energy || checkpoint) {
+        memcpy(snap->velocities, velocities, bytes);
+    }
+    if (checkpoint) {
+        memcpy(snap->accelerations, accelerations, bytes);
+    }
+    cudaEventRecord(snap->copied, 0);
+    w->head = (w->head + 1) % SNAPSHOT_RING;
+
+    pthread_mutex_lock(&w->lock);
+    w->count++;
+    pthread_cond_signal(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Разбиение тел между несколькими GPU. Устройство d считается владельцем непрерывного
+// диапазона [offset, offset + count): хранит для него положения, скорости и ускорения
+// и интегрирует только его, а упакованные тела (x, y, z, m) держит для всех n.
+// На каждом вычислении сил устройство упаковывает свой диапазон и рассылает его остальным
+// через cudaMemcpyPeerAsync (P2P/NVLink при наличии, иначе через хост) в отдельном потоке
+// копирования. Пока копии идут, считается взаимодействие со своим диапазоном, затем по мере
+// прихода событий - с чужими.
+#define MAX_GPUS 16
+#define SCALING_STEPS 20
+
+template <typename Real>
+struct GpuSlice {
+    int device;
+    int offset;
+    int count;
+    cudaStream_t stream;
+    cudaStream_t copy_stream;
+    cudaEvent_t packed;         // свой диапазон упакован
+    cudaEvent_t sent;           // свой диапазон разослан всем
+    cudaEvent_t forces_done;    // чужие диапазоны больше не читаются
+    Real* masses;
+    Real* positions;
+    Real* velocities;
+    Real* accelerations;
+    typename Body4<Real>::type* bodies;
+};
+
+template <typename Real>
+struct MultiGpu {
+    int ngpus;
+    int n;
+    int peer_access;            // все пары устройств связаны напрямую
+    GpuSlice<Real> slices[MAX_GPUS];
+};
+
+template <typename Real>
+static void multi_gpu_init(MultiGpu<Real>* mg, int ngpus, int n, const Real* masses, const Real* positions,
+                           const Real* velocities, const Real* accelerations) {
+    memset(mg, 0, sizeof(*mg));
+    mg->ngpus = ngpus;
+    mg->n = n;
+    mg->peer_access = 1;
+
+    for (int d = 0; d < ngpus; d++) {
+        GpuSlice<Real>* sl = &mg->slices[d];
+        sl->device = d;
+        sl->offset = (int)((long long)n * d / ngpus);
+        sl->count = (int)((long long)n * (d + 1) / ngpus) - sl->offset;
+
+        cudaSetDevice(d);
+        for (int e = 0; e < ngpus; e++) {
+            int can_access = 0;
+            if (e != d && cudaDeviceCanAccessPeer(&can_access, d, e) == cudaSuccess && can_access) {
+                cudaDeviceEnablePeerAccess(e, 0);
+            } else if (e != d) {
+                mg->peer_access = 0;
+            }
+        }
+        cudaStreamCreateWithFlags(&sl->stream, cudaStreamNonBlocking);
+        cudaStreamCreateWithFlags(&sl->copy_stream, cudaStreamNonBlocking);
+        cudaEventCreateWithFlags(&sl->packed, cudaEventDisableTiming);
+        cudaEventCreateWithFlags(&sl->sent, cudaEventDisableTiming);
+        cudaEventCreateWithFlags(&sl->forces_done, cudaEventDisableTiming);
+        cudaEventRecord(sl->forces_done, sl->stream);
+
+        size_t slice_bytes = (size_t)(sl->count > 0 ? sl->count : 1) * 3 * sizeof(Real);
+        cudaMalloc(&sl->masses, (sl->count > 0 ? sl->count : 1) * sizeof(Real));
+        cudaMalloc(&sl->positions, slice_bytes);
+        cudaMalloc(&sl->velocities, slice_bytes);
+        cudaMalloc(&sl->accelerations, slice_bytes);
+        cudaMalloc(&sl->bodies, n * sizeof(typename Body4<Real>::type));
+        cudaMemcpy(sl->masses, masses + sl->offset, sl->count * sizeof(Real), cudaMemcpyHostToDevice);
+        cudaMemcpy(sl->positions, positions + (size_t)sl->offset * 3, sl->count * 3 * sizeof(Real), cudaMemcpyHostToDevice);
+        cudaMemcpy(sl->velocities, velocities + (size_t)sl->offset * 3, sl->count * 3 * sizeof(Real), cudaMemcpyHostToDevice);
+        if (accelerations) {
+            cudaMemcpy(sl->accelerations, accelerations + (size_t)sl->offset * 3, sl->count * 3 * sizeof(Real), cudaMemcpyHostToDevice);
+        }
+    }
+}
+
+template <typename Real>
+static void multi_gpu_free(MultiGpu<Real>* mg) {
+    for (int d = 0; d < mg->ngpus; d++) {
+        GpuSlice<Real>* sl = &mg->slices[d];
+        cudaSetDevice(d);
+        cudaStreamSynchronize(sl->stream);
+        cudaStreamSynchronize(sl->copy_stream);
+        cudaFree(sl->masses);
+        cudaFree(sl->positions);
+        cudaFree(sl->velocities);
+        cudaFree(sl->accelerations);
+        cudaFree(sl->bodies);
+        cudaEventDestroy(sl->packed);
+        cudaEventDestroy(sl->sent);
+        cudaEventDestroy(sl->forces_done);
+        cudaStreamDestroy(sl->stream);
+        cudaStreamDestroy(sl->copy_stream);
+    }
+    cudaSetDevice(0);
+}
+
+// Ускорения всех диапазонов по текущим положениям
+template <typename Real, typename Calc>
+static void multi_gpu_forces(MultiGpu<Real>* mg) {
+    typedef typename Body4<Real>::type Body;
+
+    for (int d = 0; d < mg->ngpus; d++) {
+        GpuSlice<Real>* sl = &mg->slices[d];
+        cudaSetDevice(d);
+        // Упаковка перезаписывает свой диапазон bodies: ждём, пока его прочитают
+        // копии на соседей с предыдущего шага
+        cudaStreamWaitEvent(sl->stream, sl->sent, 0);
+        if (sl->count > 0) {
+            pack_bodies<Real><<<(sl->count + TILE_SIZE - 1) / TILE_SIZE, TILE_SIZE, 0, sl->stream>>>(
+                sl->masses, sl->positions, sl->bodies + sl->offset, sl->count);
+        }
+        cudaEventRecord(sl->packed, sl->stream);
+    }
+
+    // Рассылка: перезаписывать чужую копию можно только после того, как получатель
+    // закончил с ней предыдущий расчёт сил
+    for (int d = 0; d < mg->ngpus; d++) {
+        GpuSlice<Real>* sl = &mg->slices[d];
+        cudaSetDevice(d);
+        cudaStreamWaitEvent(sl->copy_stream, sl->packed, 0);
+        for (int e = 0; e < mg->ngpus; e++) {
+            if (e == d || sl->count == 0) continue;
+            GpuSlice<Real>* dst = &mg->slices[e];
+            cudaStreamWaitEvent(sl->copy_stream, dst->forces_done, 0);
+            cudaMemcpyPeerAsync(dst->bodies + sl->offset, e, sl->bodies + sl->offset, d,
+                                sl->count * sizeof(Body), sl->copy_stream);
+        }
+        cudaEventRecord(sl->sent, sl->copy_stream);
+    }
+
+    for (int e = 0; e < mg->ngpus; e++) {
+        GpuSlice<Real>* sl = &mg->slices[e];
+        cudaSetDevice(e);
+        int grid = (sl->count + TILE_SIZE - 1) / TILE_SIZE;
+        if (sl->count > 0) {
+            compute_forces_tiled_range<Real, Calc><<<grid, TILE_SIZE, 0, sl->stream>>>(
+                sl->bodies, sl->accelerations, sl->offset, sl->count, sl->offset, sl->offset + sl->count, 0);
+        }
+        for (int k = 1; k < mg->ngpus; k++) {
+            GpuSlice<Real>* src = &mg->slices[(e + k) % mg->ngpus];
+            cudaStreamWaitEvent(sl->stream, src->sent, 0);
+            if (sl->count > 0 && src->count > 0) {
+                compute_forces_tiled_range<Real, Calc><<<grid, TILE_SIZE, 0, sl->stream>>>(
+                    sl->bodies, sl->accelerations, sl->offset, sl->count, src->offset, src->offset + src->count, 1);
+            }
+        }
+        cudaEventRecord(sl->forces_done, sl->stream);
+    }
+}
+
+// Шаг Эйлера или leapfrog на всех устройствах (RK4 в этом режиме не поддерживается)
+template <typename Real, typename Calc>
+static void multi_gpu_step(MultiGpu<Real>* mg, Integrator integrator, Real dt) {
+    if (integrator == INTEGRATOR_LEAPFROG) {
+        for (int d = 0; d < mg->ngpus; d++) {
+            GpuSlice<Real>* sl = &mg->slices[d];
+            cudaSetDevice(d);
+            if (sl->count > 0) {
+                leapfrog_kick_drift<Real><<<(sl->count + TILE_SIZE - 1) / TILE_SIZE, TILE_SIZE, 0, sl->stream>>>(
+                    sl->positions, sl->velocities, sl->accelerations, sl->count, dt);
+            }
+        }
+    }
+
+    multi_gpu_forces<Real, Calc>(mg);
+
+    for (int d = 0; d < mg->ngpus; d++) {
+        GpuSlice<Real>* sl = &mg->slices[d];
+        cudaSetDevice(d);
+        if (sl->count == 0) continue;
+        int grid = (sl->count + TILE_SIZE - 1) / TILE_SIZE;
+        if (integrator == INTEGRATOR_LEAPFROG) {
+            leapfrog_kick<Real><<<grid, TILE_SIZE, 0, sl->stream>>>(sl->velocities, sl->accelerations, sl->count, dt);
+        } else {
+            euler_integrate<Real><<<grid, TILE_SIZE, 0, sl->stream>>>(sl->positions, sl->velocities, sl->accelerations, sl->count, dt);
+        }
+    }
+}
+
+// Сбор состояния с устройств на хост (velocities и accelerations могут быть NULL)
+template <typename Real>
+static void multi_gpu_gather(MultiGpu<Real>* mg, Real* positions, Real* velocities, Real* accelerations) {
+    for (int d = 0; d < mg->ngpus; d++) {
+        GpuSlice<Real>* sl = &mg->slices[d];
+        size_t offset = (size_t)sl->offset * 3;
+        size_t bytes = sl->count * 3 * sizeof(Real);
+        cudaSetDevice(d);
+        cudaMemcpyAsync(positions + offset, sl->positions, bytes, cudaMemcpyDeviceToHost, sl->stream);
+        if (velocities) {
+            cudaMemcpyAsync(velocities + offset, sl->velocities, bytes, cudaMemcpyDeviceToHost, sl->stream);
+        }
+        if (accelerations) {
+            cudaMemcpyAsync(accelerations + offset, sl->accelerations, bytes, cudaMemcpyDeviceToHost, sl->stream);
+        }
+    }
+    for (int d = 0; d < mg->ngpus; d++) {
+        cudaSetDevice(d);
+        cudaStreamSynchronize(mg->slices[d].stream);
+    }
+    cudaSetDevice(0);
+}
+
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Масштабирование по числу устройств: SCALING_STEPS шагов из начального состояния на 1..max_gpus
+template <typename Real, typename Calc>
+static void multi_gpu_scaling(int max_gpus, int n, Integrator integrator, Real dt, const Real* masses,
+                              const Real* positions, const Real* velocities) {
+    printf("\nMulti-GPU scaling (%d bodies, %d steps):\n", n, SCALING_STEPS);
+    printf("%6s %14s %10s %12s\n", "GPUs", "ms/step", "speedup", "efficiency");
+
+    double base = 0.0;
+    for (int k = 1; k <= max_gpus; k++) {
+        MultiGpu<Real> mg;
+        multi_gpu_init(&mg, k, n, masses, positions, velocities, (const Real*)NULL);
+        multi_gpu_forces<Real, Calc>(&mg);
+        for (int d = 0; d < k; d++) {
+            cudaSetDevice(d);
+            cudaDeviceSynchronize();
+        }
+
+        double start = wall_time();
+        for (int s = 0; s < SCALING_STEPS; s++) {
+            multi_gpu_step<Real, Calc>(&mg, integrator, dt);
+        }
+        for (int d = 0; d < k; d++) {
+            cudaSetDevice(d);
+            cudaDeviceSynchronize();
+        }
+        double per_step = (wall_time() - start) / SCALING_STEPS;
+        if (k == 1) {
+            base = per_step;
+        }
+        printf("%6d %14.3f %10.2f %11.1f%%\n", k, per_step * 1e3, base / per_step, 100.0 * base / (per_step * k));
+        multi_gpu_free(&mg);
+    }
+}
+
+// Сценарии начальных условий: встроенная задача трёх тел, файл или генератор на устройстве
+enum Scenario { SCENARIO_THREE_BODY, SCENARIO_FILE, SCENARIO_PLUMMER, SCENARIO_CUBE, SCENARIO_DISK };
+
+static const char* scenario_names[] = { "three-body orbit", "input file", "Plummer sphere", "uniform cube", "disk" };
+
+// Случайное направление на сфере, умноженное на length
+__device__ __forceinline__ void random_direction(curandStatePhilox4_32_10_t* rng, float length,
+                                                 float* x, float* y, float* z) {
+    float cos_theta = 2.0f * curand_uniform(rng) - 1.0f;
+    float sin_theta = sqrtf(fmaxf(0.0f, 1.0f - cos_theta * cos_theta));
+    float phi = 2.0f * 3.1415926535f * curand_uniform(rng);
+    *x = length * sin_theta * cosf(phi);
+    *y = length * sin_theta * sinf(phi);
+    *z = length * cos_theta;
+}
+
+// Генерация тел прямо на устройстве: у каждого тела свой поток Philox (seed, idx),
+// поэтому результат не зависит от конфигурации запуска.
+//   Plummer: выборка Aarseth–Hénon–Wielen с масштабом GEN_RADIUS, обрезка на 10 масштабах
+//   cube:    равномерно в кубе [-GEN_RADIUS, GEN_RADIUS]^3, холодный старт
+//   disk:    тело 0 - центральная масса (половина полной), остальные на круговых орбитах
+//            тонкого диска с поверхностной плотностью ~ 1 / r
+template <typename Real>
+__global__ void generate_bodies(int scenario, int n, unsigned long long seed,
+                                Real* masses, Real* positions, Real* velocities) {
+    int idx = threadIdx.x + blockIdx.x * blockDim.x;
+
+    if (idx >= n) return;
+
+    curandStatePhilox4_32_10_t rng;
+    curand_init(seed, idx, 0, &rng);
+
+    float m = GEN_TOTAL_MASS / n;
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    float vx = 0.0f, vy = 0.0f, vz = 0.0f;
+
+    if (scenario == SCENARIO_PLUMMER) {
+        float a = GEN_RADIUS;
+        float r;
+        do {
+            r = a / sqrtf(powf(curand_uniform(&rng), -2.0f / 3.0f) - 1.0f);
+        } while (r > 10.0f * a);
+        random_direction(&rng, r, &x, &y, &z);
+
+        // Отношение q = v / v_esc по распределению q^2 (1 - q^2)^3.5 методом отбора
+        float q, g;
+        do {
+            q = curand_uniform(&rng);
+            g = 0.1f * curand_uniform(&rng);
+        } while (g > q * q * powf(1.0f - q * q, 3.5f));
+        float v_esc = sqrtf(2.0f * (float)G * GEN_TOTAL_MASS / a) * powf(1.0f + r * r / (a * a), -0.25f);
+        random_direction(&rng, q * v_esc, &vx, &vy, &vz);
+    } else if (scenario == SCENARIO_CUBE) {
+        x = GEN_RADIUS * (2.0f * curand_uniform(&rng) - 1.0f);
+        y = GEN_RADIUS * (2.0f * curand_uniform(&rng) - 1.0f);
+        z = GEN_RADIUS * (2.0f * curand_uniform(&rng) - 1.0f);
+    } else if (idx == 0) {
+        m = 0.5f * GEN_TOTAL_MASS;
+    } else {
+        float central = 0.5f * GEN_TOTAL_MASS;
+        float disk_mass = GEN_TOTAL_MASS - central;
+        float r_in = 0.1f * GEN_RADIUS;
+        m = n > 1 ? disk_mass / (n - 1) : 0.0f;
+
+        float r = r_in + (GEN_RADIUS - r_in) * curand_uniform(&rng);
+        float phi = 2.0f * 3.1415926535f * curand_uniform(&rng);
+        x = r * cosf(phi);
+        y = r * sinf(phi);
+        z = 0.01f * GEN_RADIUS * curand_normal(&rng);
+
+        float enclosed = central + disk_mass * (r - r_in) / (GEN_RADIUS - r_in);
+        float v = sqrtf(G * enclosed / r);
+        vx = -v * sinf(phi);
+        vy = v * cosf(phi);
+    }
+
+    masses[idx] = m;
+    positions[idx * 3] = x;
+    positions[idx * 3 + 1] = y;
+    positions[idx * 3 + 2] = z;
+    velocities[idx * 3] = vx;
+    velocities[idx * 3 + 1] = vy;
+    velocities[idx * 3 + 2] = vz;
+}
+
+// Закреплённые массивы хоста под n тел
+template <typename Real>
+static int host_bodies_alloc(int n, Real** masses, Real** positions, Real** velocities, Real** accelerations) {
+    size_t count = n > 0 ? (size_t)n : 1;
+    *masses = *positions = *velocities = *accelerations = NULL;
+    if (cudaHostAlloc(masses, count * sizeof(Real), cudaHostAllocDefault) != cudaSuccess ||
+        cudaHostAlloc(positions, count * 3 * sizeof(Real), cudaHostAllocDefault) != cudaSuccess ||
+        cudaHostAlloc(velocities, count * 3 * sizeof(Real), cudaHostAllocDefault) != cudaSuccess ||
+        cudaHostAlloc(accelerations, count * 3 * sizeof(Real), cudaHostAllocDefault) != cudaSuccess) {
+        return -1;
+    }
+    memset(*accelerations, 0, count * 3 * sizeof(Real));
+    return 0;
+}
+
+// Двоичный формат начальных условий: заголовок и семь массивов double по n элементов
+// в порядке m, x, y, z, vx, vy, vz (как SoA-хранение в openmp.c)
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t n;
+} BodiesFileHeader;
+
+template <typename Real>
+static int read_column(FILE* fin, double* buffer, int n, Real* out, int stride, int offset) {
+    if (fread(buffer, sizeof(double), n, fin) != (size_t)n) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        out[(size_t)i * stride + offset] = (Real)buffer[i];
+    }
+    return 0;
+}
+
+template <typename Real>
+static int load_bodies_binary(FILE* fin, int* pn, Real** masses, Real** positions, Real** velocities,
+                              Real** accelerations) {
+    BodiesFileHeader header;
+    if (fread(&header, sizeof(header), 1, fin) != 1 || header.version != BODIES_VERSION || header.n > 0x7fffffff) {
+        printf("Error: unsupported binary input header\n");
+        return -1;
+    }
+    if (header.n == 0) {
+        printf("Error: number of particles must be positive\n");
+        return -1;
+    }
+    int n = (int)header.n;
+    if (host_bodies_alloc(n, masses, positions, velocities, accelerations) != 0) {
+        printf("Error: cannot allocate memory for %d particles\n", n);
+        return -1;
+    }
+
+    double* buffer = (double*)malloc((n > 0 ? n : 1) * sizeof(double));
+    int rc = buffer ? 0 : -1;
+    rc = rc || read_column(fin, buffer, n, *masses, 1, 0);
+    for (int d = 0; d < 3 && rc == 0; d++) {
+        rc = read_column(fin, buffer, n, *positions, 3, d);
+    }
+    for (int d = 0; d < 3 && rc == 0; d++) {
+        rc = read_column(fin, buffer, n, *velocities, 3, d);
+    }
+    free(buffer);
+    if (rc != 0) {
+        printf("Error: binary input is truncated\n");
+        return -1;
+    }
+    *pn = n;
+    return 0;
+}
+
+// Текстовый формат как у openmp.c: n, затем по телу "m x y z vx vy vz"
+template <typename Real>
+static int load_bodies_text(FILE* fin, int* pn, Real** masses, Real** positions, Real** velocities,
+                            Real** accelerations) {
+    int n;
+    if (fscanf(fin, "%d", &n) != 1) {
+        printf("Error reading number of particles\n");
+        return -1;
+    }
+    // Пустая система дала бы запуск ядер с нулевой сеткой
+    if (n < 1) {
+        printf("Error: number of particles must be positive\n");
+        return -1;
+    }
+    if (host_bodies_alloc(n, masses, positions, velocities, accelerations) != 0) {
+        printf("Error: cannot allocate memory for %d particles\n", n);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        double m, x, y, z, vx, vy, vz;
+        if (fscanf(fin, "%lf %lf %lf %lf %lf %lf %lf", &m, &x, &y, &z, &vx, &vy, &vz) != 7) {
+            printf("Error reading particle %d\n", i + 1);
+            return -1;
+        }
+        (*masses)[i] = (Real)m;
+        (*positions)[i * 3] = (Real)x;
+        (*positions)[i * 3 + 1] = (Real)y;
+        (*positions)[i * 3 + 2] = (Real)z;
+        (*velocities)[i * 3] = (Real)vx;
+        (*velocities)[i * 3 + 1] = (Real)vy;
+        (*velocities)[i * 3 + 2] = (Real)vz;
+    }
+    *pn = n;
+    return 0;
+}
+
+// Загрузка начальных условий; формат определяется по сигнатуре BODIES_MAGIC
+template <typename Real>
+static int load_bodies(const char* file, int* pn, Real** masses, Real** positions, Real** velocities,
+                       Real** accelerations) {
+    FILE* fin = fopen(file, "rb");
+    if (!fin) {
+        printf("Error: cannot open input file %s\n", file);
+        return -1;
+    }
+    char magic[4] = { 0 };
+    int binary = fread(magic, 1, sizeof(magic), fin) == sizeof(magic) && memcmp(magic, BODIES_MAGIC, 4) == 0;
+    rewind(fin);
+
+    int rc = binary ? load_bodies_binary<Real>(fin, pn, masses, positions, velocities, accelerations)
+                    : load_bodies_text<Real>(fin, pn, masses, positions, velocities, accelerations);
+    fclose(fin);
+    return rc;
+}
+
+template <typename Real>
+static int write_column(FILE* fout, double* buffer, int n, const Real* in, int stride, int offset) {
+    for (int i = 0; i < n; i++) {
+        buffer[i] = in[(size_t)i * stride + offset];
+    }
+    return fwrite(buffer, sizeof(double), n, fout) == (size_t)n ? 0 : -1;
+}
+
+// Сохранение начальных условий в двоичном формате (например, сгенерированных)
+template <typename Real>
+static int save_bodies_binary(const char* file, int n, const Real* masses, const Real* positions,
+                              const Real* velocities) {
+    FILE* fout = fopen(file, "wb");
+    if (!fout) {
+        printf("Error: cannot open %s for writing\n", file);
+        return -1;
+    }
+    BodiesFileHeader header;
+    memcpy(header.magic, BODIES_MAGIC, 4);
+    header.version = BODIES_VERSION;
+    header.n = (uint64_t)n;
+
+    double* buffer = (double*)malloc((n > 0 ? n : 1) * sizeof(double));
+    int rc = buffer && fwrite(&header, sizeof(header), 1, fout) == 1 ? 0 : -1;
+    rc = rc || write_column(fout, buffer, n, masses, 1, 0);
+    for (int d = 0; d < 3 && rc == 0; d++) {
+        rc = write_column(fout, buffer, n, positions, 3, d);
+    }
+    for (int d = 0; d < 3 && rc == 0; d++) {
+        rc = write_column(fout, buffer, n, velocities, 3, d);
+    }
+    free(buffer);
+    if (fclose(fout) != 0 || rc != 0) {
+        printf("Error: cannot write %s\n", file);
+        return -1;
+    }
+    return 0;
+}
+
+// Состояние из контрольной точки; заголовок проверяет вызывающий
+template <typename Real>
+static int load_checkpoint(const char* file, Precision precision, CheckpointHeader* h, int* pn, Real** masses,
+                           Real** positions, Real** velocities, Real** accelerations) {
+    FILE* fin = fopen(file, "rb");
+    if (!fin) {
+        printf("Error: cannot open checkpoint %s\n", file);
+        return -1;
+    }
+    if (fread(h, sizeof(*h), 1, fin) != 1 || memcmp(h->magic, CHECKPOINT_MAGIC, 4) != 0 ||
+        h->version != CHECKPOINT_VERSION || h->n < 1) {
+        printf("Error: %s is not a checkpoint (or has an unsupported version)\n", file);
+        fclose(fin);
+        return -1;
+    }
+    if (h->precision != (int32_t)precision) {
+        printf("Error: checkpoint was written with --precision=%s\n",
+               h->precision == PRECISION_FP64 ? "fp64" : h->precision == PRECISION_MIXED ? "mixed" : "fp32");
+        fclose(fin);
+        return -1;
+    }
+    *pn = h->n;
+    if (host_bodies_alloc(h->n, masses, positions, velocities, accelerations) != 0) {
+        printf("Error: cannot allocate memory for %d particles\n", h->n);
+        fclose(fin);
+        return -1;
+    }
+    size_t count = (size_t)h->n * 3;
+    int rc = fread(*masses, sizeof(Real), h->n, fin) == (size_t)h->n &&
+             fread(*positions, sizeof(Real), count, fin) == count &&
+             fread(*velocities, sizeof(Real), count, fin) == count &&
+             fread(*accelerations, sizeof(Real), count, fin) == count ? 0 : -1;
+    fclose(fin);
+    if (rc != 0) {
+        printf("Error: checkpoint %s is truncated\n", file);
+    }
+    return rc;
+}
+
+// Параметры запуска из командной строки
+typedef struct {
+    Integrator integrator;
+    float dt;
+    int report_energy;
+    ForceKernel force_kernel;
+    LoopMode loop_mode;
+    Precision precision;
+    Scenario scenario;
+    const char* input_file;
+    const char* save_input;
+    int gen_n;
+    unsigned long long seed;
+    float t_end;
+    int gpus;           // число устройств для разбиения тел
+    int scaling;        // только замер масштабирования по 1..gpus устройствам
+    int output_csv;     // trajectories.csv вместо бинарного trajectories.bin
+    int traj_stride;
+    uint32_t traj_flags;
+    int checkpoint_every;           // шагов между контрольными точками, 0 - без них
+    const char* checkpoint_file;
+    const char* restart_file;       // продолжить расчёт с контрольной точки
+} SimOptions;
+
+// Весь расчёт для выбранной точности: Real - хранение состояния, Calc - взаимодействие пар
+template <typename Real, typename Calc>
+static int run_simulation(const SimOptions* opt, const cudaDeviceProp* prop_ptr) {
+    const cudaDeviceProp& prop = *prop_ptr;
+    Integrator integrator = opt->integrator;
+    float dt = opt->dt;
+    int report_energy = opt->report_energy;
+    ForceKernel force_kernel = opt->force_kernel;
+    LoopMode loop_mode = opt->loop_mode;
+    Scenario scenario = opt->scenario;
+    const char* input_file = opt->input_file;
+    const char* save_input = opt->save_input;
+    int gen_n = opt->gen_n;
+    unsigned long long seed = opt->seed;
+    float t_end = opt->t_end;
+    int ngpus = opt->gpus;
+
+    int n = 3;
+    Real *h_masses, *h_positions, *h_velocities, *h_accelerations;
+    CheckpointHeader checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    const char* restart_file = opt->restart_file;
+    if (restart_file) {
+        if (load_checkpoint(restart_file, opt->precision, &checkpoint, &n,
+                            &h_masses, &h_positions, &h_velocities, &h_accelerations) != 0) {
+            return 1;
+        }
+        // Рестарт продолжает тот же расчёт: схема, ядро сил, шаг и разбиение должны совпадать
+        if (checkpoint.integrator != (int32_t)integrator || checkpoint.force_kernel != (int32_t)force_kernel ||
+            checkpoint.dt != dt || checkpoint.gpus != ngpus) {
+            printf("Error: checkpoint was written with --integrator=%s --forces=%s --dt=%.9g --gpus=%d; pass the same options\n",
+                   checkpoint.integrator == INTEGRATOR_LEAPFROG ? "leapfrog" : checkpoint.integrator == INTEGRATOR_RK4 ? "rk4" : "euler",
+                   checkpoint.force_kernel == FORCES_NEWTON3 ? "newton3" : "tiled", checkpoint.dt, checkpoint.gpus);
+            return 1;
+        }
+    } else if (scenario == SCENARIO_FILE) {
+        if (load_bodies(input_file, &n, &h_masses, &h_positions, &h_velocities, &h_accelerations) != 0) {
+            return 1;
+        }
+    } else {
+        n = scenario == SCENARIO_THREE_BODY ? 3 : gen_n;
+        if (host_bodies_alloc(n, &h_masses, &h_positions, &h_velocities, &h_accelerations) != 0) {
+            printf("Error: cannot allocate memory for %d particles\n", n);
+            return 1;
+        }
+    }
+    if (report_energy && n > ENERGY_HOST_WARN_N) {
+        printf("Warning: --energy computes the O(n^2) energy on the host at every output; "
+               "with %d particles it will stall the time loop\n", n);
+    }
+    Real *d_masses, *d_positions, *d_velocities, *d_accelerations;
+    cudaMalloc(&d_masses, n * sizeof(Real));
+    cudaMalloc(&d_positions, n * 3 * sizeof(Real));
+    cudaMalloc(&d_velocities, n * 3 * sizeof(Real));
+    cudaMalloc(&d_accelerations, n * 3 * sizeof(Real));
 
     printf("Initial conditions:\n");
     printf("Particles: %d\n", n);
-    printf("Central mass: %.2e kg\n", h_masses[0]);
-    printf("Orbital radius: 5.0 m\n");
-    printf("Orbital velocity: %.6f m/s\n", v_orbit);
-    printf("Orbital period: %.2f s\n", 2.0f * 3.1415926535f * 5.0f / v_orbit);
+    if (restart_file) {
+        printf("Source: checkpoint %s (t = %.3f s, step %d)\n", restart_file, checkpoint.t, checkpoint.step);
+    } else {
+        printf("Source: %s\n", scenario_names[scenario]);
+    }
 
-    printf("\nParticle details:\n");
-    for (int i = 0; i < n; i++) {
-        printf("Particle %d: m=%.2e kg, r=(%.3f, %.3f, %.3f) m, v=(%.6f, %.6f, %.6f) m/s\n",
-               i, h_masses[i],
-               h_positions[i*3], h_positions[i*3+1], h_positions[i*3+2],
-               h_velocities[i*3], h_velocities[i*3+1], h_velocities[i*3+2]);
-    }
-    float *d_masses, *d_positions, *d_velocities, *d_accelerations;
-    cudaMalloc(&d_masses, n * sizeof(float));
-    cudaMalloc(&d_positions, n * 3 * sizeof(float));
-    cudaMalloc(&d_velocities, n * 3 * sizeof(float));
-    cudaMalloc(&d_accelerations, n * 3 * sizeof(float));
-    cudaMemcpy(d_masses, h_masses, n * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(d_positions, h_positions, n * 3 * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(d_velocities, h_velocities, n * 3 * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(d_accelerations, h_accelerations, n * 3 * sizeof(float), cudaMemcpyHostToDevice);
-
-    int block_size = 256;
+    // После рестарта состояние уже загружено целиком
+    if (!restart_file && scenario == SCENARIO_THREE_BODY) {
+        h_masses[0] = (Real)1.0e6;
+        h_masses[1] = (Real)1.0e3;
+        h_masses[2] = (Real)1.0e3;
+
+        h_positions[0] = 0; h_positions[1] = 0; h_positions[2] = 0;
+        h_positions[3] = 5; h_positions[4] = 0; h_positions[5] = 0;
+        h_positions[6] = 0; h_positions[7] = 5; h_positions[8] = 0;
+        Real v_orbit = (Real)sqrt(G * h_masses[0] / 5.0);
+
+        h_velocities[0] = 0; h_velocities[1] = 0; h_velocities[2] = 0;
+        h_velocities[3] = 0; h_velocities[4] = v_orbit; h_velocities[5] = 0;
+        h_velocities[6] = -v_orbit; h_velocities[7] = 0; h_velocities[8] = 0;
+
+        printf("Central mass: %.2e kg\n", (double)h_masses[0]);
+        printf("Orbital radius: 5.0 m\n");
+        printf("Orbital velocity: %.6f m/s\n", (double)v_orbit);
+        printf("Orbital period: %.2f s\n", 2.0 * 3.1415926535 * 5.0 / v_orbit);
+    } else if (!restart_file && scenario != SCENARIO_FILE) {
+        // Тела создаются на устройстве, на хост копируются для вывода и оценки энергии
+        generate_bodies<Real><<<(n + TILE_SIZE - 1) / TILE_SIZE, TILE_SIZE>>>(scenario, n, seed, d_masses, d_positions, d_velocities);
+        cudaMemcpy(h_masses, d_masses, n * sizeof(Real), cudaMemcpyDeviceToHost);
+        cudaMemcpy(h_positions, d_positions, n * 3 * sizeof(Real), cudaMemcpyDeviceToHost);
+        cudaMemcpy(h_velocities, d_velocities, n * 3 * sizeof(Real), cudaMemcpyDeviceToHost);
+        printf("Total mass: %.2e kg, scale: %.1f m, seed: %llu\n", GEN_TOTAL_MASS, GEN_RADIUS, seed);
+    }
+
+    if (n <= 10) {
+        printf("\nParticle details:\n");
+        for (int i = 0; i < n; i++) {
+            printf("Particle %d: m=%.2e kg, r=(%.3f, %.3f, %.3f) m, v=(%.6f, %.6f, %.6f) m/s\n",
+                   i, (double)h_masses[i],
+                   (double)h_positions[i*3], (double)h_positions[i*3+1], (double)h_positions[i*3+2],
+                   (double)h_velocities[i*3], (double)h_velocities[i*3+1], (double)h_velocities[i*3+2]);
+        }
+    }
+    if (save_input && save_bodies_binary(save_input, n, h_masses, h_positions, h_velocities) != 0) {
+        return 1;
+    }
+
+    cudaMemcpy(d_masses, h_masses, n * sizeof(Real), cudaMemcpyHostToDevice);
+    cudaMemcpy(d_positions, h_positions, n * 3 * sizeof(Real), cudaMemcpyHostToDevice);
+    cudaMemcpy(d_velocities, h_velocities, n * 3 * sizeof(Real), cudaMemcpyHostToDevice);
+    cudaMemcpy(d_accelerations, h_accelerations, n * 3 * sizeof(Real), cudaMemcpyHostToDevice);
+
+    // Буферы промежуточных стадий RK4
+    Real *d_stage_pos = NULL, *d_stage_vel = NULL, *d_stage_acc = NULL, *d_sum_pos = NULL, *d_sum_vel = NULL;
+    if (integrator == INTEGRATOR_RK4) {
+        cudaMalloc(&d_stage_pos, n * 3 * sizeof(Real));
+        cudaMalloc(&d_stage_vel, n * 3 * sizeof(Real));
+        cudaMalloc(&d_stage_acc, n * 3 * sizeof(Real));
+        cudaMalloc(&d_sum_pos, n * 3 * sizeof(Real));
+        cudaMalloc(&d_sum_vel, n * 3 * sizeof(Real));
+    }
+
+    int block_size = TILE_SIZE;
     int grid_size_forces = (n + block_size - 1) / block_size;
-    int total_pairs = n * (n - 1) / 2;
-    int grid_size_pairs = (total_pairs + block_size - 1) / block_size;
-    float t = 0.0f;
-    float t_end = 100.0f; 
-    int step = 0;
+    long long total_pairs = (long long)n * (n - 1) / 2;
+    long long pair_blocks = (total_pairs + block_size - 1) / block_size;
+    int grid_size_pairs = (int)(pair_blocks < PAIR_GRID_MAX ? (pair_blocks > 0 ? pair_blocks : 1) : PAIR_GRID_MAX);
+    int grid_size_components = (n * 3 + block_size - 1) / block_size;
+
+    DeviceState<Real> state = { d_masses, d_positions, d_velocities, d_accelerations,
+                          d_stage_pos, d_stage_vel, d_stage_acc, d_sum_pos, d_sum_vel };
+    LaunchConfig<Real> launch = { force_kernel, NULL, grid_size_forces, grid_size_pairs, grid_size_components, block_size, NULL };
+    cudaStreamCreate(&launch.stream);
+
+    // Персистентное ядро поддерживает Эйлер и leapfrog с плиточными силами на устройстве
+    // с кооперативным запуском; число блоков ограничено их одновременным размещением
+    int persistent_blocks = 0;
+    if (loop_mode == LOOP_PERSISTENT) {
+        int blocks_per_sm = 0;
+        cudaOccupancyMaxActiveBlocksPerMultiprocessor(&blocks_per_sm, persistent_time_loop<Real, Calc>, TILE_SIZE, 0);
+        persistent_blocks = blocks_per_sm * prop.multiProcessorCount;
+        if (persistent_blocks > grid_size_forces) {
+            persistent_blocks = grid_size_forces;
+        }
+        if (!prop.cooperativeLaunch || persistent_blocks == 0 || integrator == INTEGRATOR_RK4) {
+            printf("Persistent kernel is not available for this device or integrator, using CUDA Graph\n");
+            loop_mode = LOOP_GRAPH;
+        } else {
+            force_kernel = launch.kernel = FORCES_TILED;
+        }
+    }
+    if (force_kernel == FORCES_TILED) {
+        cudaMalloc(&launch.d_bodies, n * sizeof(typename Body4<Real>::type));
+    }
+
+    // Разбиение на несколько GPU поддерживает Эйлер и leapfrog с плиточным ядром
+    if (ngpus > 1 && integrator == INTEGRATOR_RK4) {
+        printf("Multi-GPU mode supports Euler and leapfrog only, using one device\n");
+        ngpus = 1;
+    }
+    if (opt->scaling) {
+        multi_gpu_scaling<Real, Calc>(ngpus, n, integrator, (Real)dt, h_masses, h_positions, h_velocities);
+        return 0;
+    }
+    MultiGpu<Real> mg;
+    if (ngpus > 1) {
+        multi_gpu_init(&mg, ngpus, n, h_masses, h_positions, h_velocities, h_accelerations);
+        force_kernel = FORCES_TILED;
+        loop_mode = LOOP_STREAM;
+    }
+
+    float t = restart_file ? checkpoint.t : 0.0f;
+    int step = restart_file ? checkpoint.step : 0;
 
     printf("\nSimulation parameters:\n");
-    printf("Time step (dt): %.3f s\n", DT);
+    printf("Time step (dt): %.3f s\n", dt);
     printf("Total simulation time: %.1f s\n", t_end);
-    printf("Number of steps: %.0f\n", t_end / DT);
+    printf("Number of steps: %.0f\n", t_end / dt);
     printf("Output every %d steps\n", OUTPUT_EVERY);
-    printf("Using Newton's 3rd Law: YES\n");
-    printf("Integration method: Explicit Euler\n");
-    FILE* fout = fopen("trajectories.csv", "w");
-    if (!fout) {
-        printf("Error: Cannot open trajectories.csv for writing\n");
+    printf("Force kernel: %s\n", force_kernel_names[force_kernel]);
+    printf("Precision: %s\n", precision_names[opt->precision]);
+    printf("Integration method: %s\n", integrator_names[integrator]);
+    printf("Time loop: %s\n", loop_mode_names[loop_mode]);
+    if (ngpus > 1) {
+        printf("GPUs: %d, peer access: %s\n", ngpus, mg.peer_access ? "yes" : "no (staged through host)");
+    }
+    if (!opt->output_csv) {
+        printf("Trajectory: trajectories.bin (%s, body stride %d%s)\n",
+               (opt->traj_flags & TRAJ_DOUBLE) ? "double" : "float", opt->traj_stride,
+               (opt->traj_flags & TRAJ_ZLIB) ? ", zlib" : "");
+    }
+    // Точки пишутся только вместе со снимками, поэтому интервал кратен OUTPUT_EVERY
+    int checkpoint_every = (opt->checkpoint_every + OUTPUT_EVERY - 1) / OUTPUT_EVERY * OUTPUT_EVERY;
+    if (checkpoint_every > 0) {
+        printf("Checkpoint every %d steps to %s\n", checkpoint_every, opt->checkpoint_file);
+    }
+    TrajectoryOutput output;
+    if (trajectory_open(&output, opt->output_csv, n, opt->traj_stride, opt->traj_flags, checkpoint.output_offset) != 0) {
+        trajectory_close(&output);
         return 1;
     }
-    fprintf(fout, "t");
-    for (int i = 0; i < n; i++) {
-        fprintf(fout, ",x%d,y%d,z%d", i+1, i+1, i+1);
+    if (!restart_file && trajectory_write(&output, t, h_positions) != 0) {
+        printf("Error: cannot write trajectory frame at t = %.3f to %s\n", t, output.path);
+        trajectory_close(&output);
+        return 1;
     }
-    fprintf(fout, "\n");
 
-    fprintf(fout, "%.6f", t);
-    for (int i = 0; i < n; i++) {
-        fprintf(fout, ",%.6f,%.6f,%.6f",
-                h_positions[i*3], h_positions[i*3+1], h_positions[i*3+2]);
-    }
-    fprintf(fout, "\n");
-
-    while (t < t_end) {
-        clear_accelerations<<<grid_size_forces, block_size>>>(d_accelerations, n);
-        cudaDeviceSynchronize();
-        if (total_pairs > 0) {
-            compute_forces_newton3<<<grid_size_pairs, block_size>>>(d_masses, d_positions, d_accelerations, n);
-        }
-        cudaDeviceSynchronize();
-        euler_integrate<<<grid_size_forces, block_size>>>(d_positions, d_velocities, d_accelerations, n, DT);
-        cudaDeviceSynchronize();
-
-        t += DT;
-        step++;
-        if (step % OUTPUT_EVERY == 0) {
-            cudaMemcpy(h_positions, d_positions, n * 3 * sizeof(float), cudaMemcpyDeviceToHost);
-            fprintf(fout, "%.6f", t);
-            for (int i = 0; i < n; i++) {
-                fprintf(fout, ",%.6f,%.6f,%.6f",
-                        h_positions[i*3], h_positions[i*3+1], h_positions[i*3+2]);
+    double energy0 = checkpoint.energy0, max_drift = checkpoint.max_drift;
+    if (report_energy && !restart_file) {
+        energy0 = total_energy(h_masses, h_positions, h_velocities, n);
+    }
+    CheckpointHeader checkpoint_base;
+    memset(&checkpoint_base, 0, sizeof(checkpoint_base));
+    memcpy(checkpoint_base.magic, CHECKPOINT_MAGIC, 4);
+    checkpoint_base.version = CHECKPOINT_VERSION;
+    checkpoint_base.n = n;
+    checkpoint_base.precision = opt->precision;
+    checkpoint_base.integrator = integrator;
+    checkpoint_base.force_kernel = opt->force_kernel;
+    checkpoint_base.gpus = opt->gpus;
+    checkpoint_base.dt = dt;
+    checkpoint_base.energy0 = energy0;
+
+    // Leapfrog переиспользует ускорения конца шага, поэтому начальные считаются один раз
+    // (после рестарта они уже загружены из точки)
+    if (integrator == INTEGRATOR_LEAPFROG && !restart_file && ngpus > 1) {
+        multi_gpu_forces<Real, Calc>(&mg);
+    } else if (integrator == INTEGRATOR_LEAPFROG && !restart_file) {
+        compute_accelerations<Real, Calc>(d_masses, d_positions, d_accelerations, n, &launch);
+    }
+
+    // Число шагов определяется тем же накоплением t += dt, что и в самом цикле
+    int total_steps = 0;
+    for (float tt = 0.0f; tt < t_end; tt += dt) {
+        total_steps++;
+    }
+
+    // Пакет из OUTPUT_EVERY шагов записывается в граф один раз и затем только перезапускается
+    cudaGraphExec_t batch_graph = NULL;
+    if (loop_mode == LOOP_GRAPH && ngpus == 1) {
+        cudaGraph_t graph;
+        cudaStreamBeginCapture(launch.stream, cudaStreamCaptureModeGlobal);
+        for (int s = 0; s < OUTPUT_EVERY; s++) {
+            enqueue_step<Real, Calc>(integrator, &state, n, (Real)dt, &launch);
+        }
+        cudaStreamEndCapture(launch.stream, &graph);
+        cudaGraphInstantiateWithFlags(&batch_graph, graph, 0);
+        cudaGraphDestroy(graph);
+    }
+
+    // Время цикла: по часам хоста и по событиям CUDA в потоке вычислений (без загрузки и подготовки)
+    cudaEvent_t loop_start, loop_stop;
+    cudaEventCreate(&loop_start);
+    cudaEventCreate(&loop_stop);
+    double loop_wall = wall_time();
+    cudaEventRecord(loop_start, launch.stream);
+
+    SnapshotWriter<Real> writer;
+    snapshot_writer_start(&writer, &output, h_masses, n, t_end, report_energy, energy0, max_drift,
+                          checkpoint_every > 0 ? opt->checkpoint_file : (const char*)NULL, &checkpoint_base);
+
+    // Хост ждёт устройство только если все слоты кольца снимков заняты;
+    // после ошибки записи траектории расчёт останавливается
+    while (step < total_steps && !snapshot_writer_failed(&writer)) {
+        int batch = OUTPUT_EVERY - step % OUTPUT_EVERY;
+        if (batch > total_steps - step) {
+            batch = total_steps - step;
+        }
+
+        if (ngpus > 1) {
+            for (int s = 0; s < batch; s++) {
+                multi_gpu_step<Real, Calc>(&mg, integrator, (Real)dt);
             }
-            fprintf(fout, "\n");
-            printf("%6.1f  (%7.3f,%7.3f)   (%7.3f,%7.3f)   %5.1f%%\n",
-                   t,
-                   h_positions[3], h_positions[4], 
-                   h_positions[6], h_positions[7],
-                   (t / t_end) * 100.0f);
+        } else if (loop_mode == LOOP_PERSISTENT) {
+            launch_persistent<Real, Calc>(&state, n, (Real)dt, batch, integrator, &launch, persistent_blocks);
+        } else if (loop_mode == LOOP_GRAPH && batch == OUTPUT_EVERY) {
+            cudaGraphLaunch(batch_graph, launch.stream);
+        } else {
+            for (int s = 0; s < batch; s++) {
+                enqueue_step<Real, Calc>(integrator, &state, n, (Real)dt, &launch);
+            }
+        }
 
-            fflush(fout);
+        for (int s = 0; s < batch; s++) {
+            t += dt;
+        }
+        step += batch;
+        int checkpoint_now = checkpoint_every > 0 && step % checkpoint_every == 0;
+        if (step % OUTPUT_EVERY == 0 && ngpus > 1) {
+            multi_gpu_gather(&mg, h_positions, report_energy || checkpoint_now ? h_velocities : NULL,
+                             checkpoint_now ? h_accelerations : (Real*)NULL);
+            snapshot_writer_push_host(&writer, h_positions, h_velocities, h_accelerations, t, step, checkpoint_now);
+        } else if (step % OUTPUT_EVERY == 0) {
+            snapshot_writer_push(&writer, launch.stream, d_positions, d_velocities, d_accelerations, t, step, checkpoint_now);
         }
     }
 
-    cudaMemcpy(h_positions, d_positions, n * 3 * sizeof(float), cudaMemcpyDeviceToHost);
-    cudaMemcpy(h_velocities, d_velocities, n * 3 * sizeof(float), cudaMemcpyDeviceToHost);
-    cudaMemcpy(h_accelerations, d_accelerations, n * 3 * sizeof(float), cudaMemcpyDeviceToHost);
+    snapshot_writer_finish(&writer);
+    int output_failed = writer.failed;
+    max_drift = writer.max_drift;
+    if (writer.checkpoint_errors > 0) {
+        printf("Warning: %d checkpoints were not written\n", writer.checkpoint_errors);
+    }
+    if (ngpus > 1) {
+        multi_gpu_gather(&mg, h_positions, h_velocities, h_accelerations);
+        multi_gpu_free(&mg);
+    } else {
+        cudaStreamSynchronize(launch.stream);
+        cudaMemcpy(h_positions, d_positions, n * 3 * sizeof(Real), cudaMemcpyDeviceToHost);
+        cudaMemcpy(h_velocities, d_velocities, n * 3 * sizeof(Real), cudaMemcpyDeviceToHost);
+        cudaMemcpy(h_accelerations, d_accelerations, n * 3 * sizeof(Real), cudaMemcpyDeviceToHost);
+    }
+    cudaEventRecord(loop_stop, launch.stream);
+    cudaEventSynchronize(loop_stop);
+    loop_wall = wall_time() - loop_wall;
+    float loop_device_ms = 0.0f;
+    cudaEventElapsedTime(&loop_device_ms, loop_start, loop_stop);
+    cudaEventDestroy(loop_start);
+    cudaEventDestroy(loop_stop);
 
-    fprintf(fout, "%.6f", t);
-    for (int i = 0; i < n; i++) {
-        fprintf(fout, ",%.6f,%.6f,%.6f",
-                h_positions[i*3], h_positions[i*3+1], h_positions[i*3+2]);
+    if (!output_failed && trajectory_write(&output, t, h_positions) != 0) {
+        printf("Error: cannot write trajectory frame at t = %.3f to %s\n", t, output.path);
+        output_failed = 1;
+    }
+    trajectory_close(&output);
+    if (output_failed) {
+        printf("Error: trajectory output failed at step %d, run stopped\n", step);
+        return 1;
+    }
+
+    if (report_energy) {
+        double drift = fabs((total_energy(h_masses, h_positions, h_velocities, n) - energy0) / energy0);
+        max_drift = drift > max_drift ? drift : max_drift;
+        printf("Initial energy: %.10e J\n", energy0);
+        printf("Final energy drift: %.3e, max drift at outputs: %.3e\n", drift, max_drift);
     }
-    fprintf(fout, "\n");
-    fclose(fout);
 
     printf("Total steps: %d\n", step);
     printf("Final time: %.3f s\n", t);
-    printf("Results saved to: trajectories.csv\n");
-    free(h_masses);
-    free(h_positions);
-    free(h_velocities);
-    free(h_accelerations);
+    // При нескольких GPU события стоят только в потоке первого устройства
+    printf("Elapsed time: %.4f seconds (device stream: %.4f seconds)\n", loop_wall, loop_device_ms / 1000.0);
+    printf("Results saved to: %s\n", output.path);
+    cudaFreeHost(h_masses);
+    cudaFreeHost(h_positions);
+    cudaFreeHost(h_velocities);
+    cudaFreeHost(h_accelerations);
 
     cudaFree(d_masses);
     cudaFree(d_positions);
     cudaFree(d_velocities);
     cudaFree(d_accelerations);
+    cudaFree(d_stage_pos);
+    cudaFree(d_stage_vel);
+    cudaFree(d_stage_acc);
+    cudaFree(d_sum_pos);
+    cudaFree(d_sum_vel);
+    cudaFree(launch.d_bodies);
+    if (batch_graph) {
+        cudaGraphExecDestroy(batch_graph);
+    }
+    cudaStreamDestroy(launch.stream);
     return 0;
+}
+
+int main(int argc, char* argv[]) {
+    Precision precision = PRECISION_FP32;
+    int gpus = 1;
+    int scaling = 0;
+    Integrator integrator = INTEGRATOR_EULER;
+    float dt = DT;
+    int report_energy = 0;
+    ForceKernel force_kernel = FORCES_TILED;
+    LoopMode loop_mode = LOOP_GRAPH;
+    Scenario scenario = SCENARIO_THREE_BODY;
+    const char* input_file = NULL;
+    const char* save_input = NULL;
+    int gen_n = GEN_DEFAULT_N;
+    unsigned long long seed = 42;
+    float t_end = 100.0f;
+    int output_csv = 0;
+    int traj_stride = 1;
+    uint32_t traj_flags = 0;
+    int checkpoint_every = 0;
+    const char* checkpoint_file = "checkpoint.bin";
+    const char* restart_file = NULL;
+    int restart = 0;
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--integrator=euler") == 0) {
+            integrator = INTEGRATOR_EULER;
+        } else if (strcmp(argv[a], "--integrator=leapfrog") == 0) {
+            integrator = INTEGRATOR_LEAPFROG;
+        } else if (strcmp(argv[a], "--integrator=rk4") == 0) {
+            integrator = INTEGRATOR_RK4;
+        } else if (strncmp(argv[a], "--dt=", 5) == 0) {
+            dt = (float)atof(argv[a] + 5);
+        } else if (strcmp(argv[a], "--energy") == 0) {
+            report_energy = 1;
+        } else if (strcmp(argv[a], "--forces=tiled") == 0) {
+            force_kernel = FORCES_TILED;
+        } else if (strcmp(argv[a], "--forces=newton3") == 0) {
+            force_kernel = FORCES_NEWTON3;
+        } else if (strcmp(argv[a], "--loop=graph") == 0) {
+            loop_mode = LOOP_GRAPH;
+        } else if (strcmp(argv[a], "--loop=stream") == 0) {
+            loop_mode = LOOP_STREAM;
+        } else if (strcmp(argv[a], "--loop=persistent") == 0) {
+            loop_mode = LOOP_PERSISTENT;
+        } else if (strncmp(argv[a], "--gpus=", 7) == 0) {
+            gpus = atoi(argv[a] + 7);
+        } else if (strcmp(argv[a], "--scaling") == 0) {
+            scaling = 1;
+        } else if (strcmp(argv[a], "--precision=fp32") == 0) {
+            precision = PRECISION_FP32;
+        } else if (strcmp(argv[a], "--precision=fp64") == 0) {
+            precision = PRECISION_FP64;
+        } else if (strcmp(argv[a], "--precision=mixed") == 0) {
+            precision = PRECISION_MIXED;
+        } else if (strncmp(argv[a], "--input=", 8) == 0) {
+            scenario = SCENARIO_FILE;
+            input_file = argv[a] + 8;
+        } else if (strcmp(argv[a], "--generate=plummer") == 0) {
+            scenario = SCENARIO_PLUMMER;
+        } else if (strcmp(argv[a], "--generate=cube") == 0) {
+            scenario = SCENARIO_CUBE;
+        } else if (strcmp(argv[a], "--generate=disk") == 0) {
+            scenario = SCENARIO_DISK;
+        } else if (strncmp(argv[a], "--n=", 4) == 0) {
+            gen_n = atoi(argv[a] + 4);
+        } else if (strncmp(argv[a], "--seed=", 7) == 0) {
+            seed = strtoull(argv[a] + 7, NULL, 10);
+        } else if (strncmp(argv[a], "--t-end=", 8) == 0) {
+            t_end = (float)atof(argv[a] + 8);
+        } else if (strncmp(argv[a], "--save-input=", 13) == 0) {
+            save_input = argv[a] + 13;
+        } else if (strcmp(argv[a], "--output=bin") == 0) {
+            output_csv = 0;
+        } else if (strcmp(argv[a], "--output=csv") == 0) {
+            output_csv = 1;
+        } else if (strcmp(argv[a], "--traj-precision=float") == 0) {
+            traj_flags &= ~TRAJ_DOUBLE;
+        } else if (strcmp(argv[a], "--traj-precision=double") == 0) {
+            traj_flags |= TRAJ_DOUBLE;
+        } else if (strncmp(argv[a], "--traj-stride=", 14) == 0) {
+            traj_stride = atoi(argv[a] + 14);
+        } else if (strcmp(argv[a], "--traj-zlib") == 0) {
+            traj_flags |= TRAJ_ZLIB;
+        } else if (strncmp(argv[a], "--checkpoint-every=", 19) == 0) {
+            checkpoint_every = atoi(argv[a] + 19);
+        } else if (strncmp(argv[a], "--checkpoint=", 13) == 0) {
+            checkpoint_file = argv[a] + 13;
+        } else if (strcmp(argv[a], "--restart") == 0) {
+            restart = 1;
+        } else if (strncmp(argv[a], "--restart=", 10) == 0) {
+            restart_file = argv[a] + 10;
+        } else {
+            printf("Usage: %s [--integrator=euler|leapfrog|rk4] [--dt=X] [--energy] [--forces=tiled|newton3]\n"
+                   "       [--loop=graph|stream|persistent] [--precision=fp32|fp64|mixed]\n"
+                   "       [--t-end=X] [--save-input=FILE] [--gpus=N|0 for all] [--scaling]\n"
+                   "       [--input=FILE | --generate=plummer|cube|disk [--n=N] [--seed=N]]\n"
+                   "       [--output=bin|csv] [--traj-precision=float|double] [--traj-stride=K] [--traj-zlib]\n"
+                   "       [--checkpoint-every=STEPS] [--checkpoint=FILE] [--restart[=FILE]]\n", argv[0]);
+            return 1;
+        }
+    }
+    // --restart без имени читает файл, заданный --checkpoint (в любом порядке опций)
+    if (restart && !restart_file) {
+        restart_file = checkpoint_file;
+    }
+    if (dt <= 0.0f) {
+        printf("Error: time step must be positive\n");
+        return 1;
+    }
+    if (checkpoint_every < 0) {
+        printf("Error: checkpoint interval must be non-negative\n");
+        return 1;
+    }
+    if (traj_stride < 1) {
+        printf("Error: trajectory stride must be positive\n");
+        return 1;
+    }
+    if (gen_n < 1) {
+        printf("Error: number of generated bodies must be positive\n");
+        return 1;
+    }
+
+    int deviceCount;
+    cudaGetDeviceCount(&deviceCount);
+    cudaDeviceProp prop;
+    cudaGetDeviceProperties(&prop, 0);
+
+    // --gpus=0 - все видимые устройства
+    if (gpus <= 0 || gpus > deviceCount) {
+        gpus = deviceCount;
+    }
+    if (gpus > MAX_GPUS) {
+        gpus = MAX_GPUS;
+    }
+    if (gpus < 1) {
+        printf("Error: no CUDA devices found\n");
+        return 1;
+    }
+
+    SimOptions opt = { integrator, dt, report_energy, force_kernel, loop_mode, precision,
+                       scenario, input_file, save_input, gen_n, seed, t_end, gpus, scaling,
+                       output_csv, traj_stride, traj_flags, checkpoint_every, checkpoint_file, restart_file };
+    switch (precision) {
+    case PRECISION_FP64:
+        return run_simulation<double, double>(&opt, &prop);
+    case PRECISION_MIXED:
+        return run_simulation<double, float>(&opt, &prop);
+    default:
+        return run_simulation<float, float>(&opt, &prop);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "barnes_hut.h"
+
+#define MORTON_BITS 21          // бит на координату, 3 * 21 = 63 бита кода
+#define LEAF_SIZE 16            // максимум тел в листе
+#define TASK_CUTOFF 4096        // поддеревья меньше этого строятся без новых задач
+#define TRAVERSAL_GRAIN 64      // тел на одну задачу обхода
+#define STACK_SIZE (8 * 3 * MORTON_BITS + 8)
+
+typedef struct {
+    double mass;
+    double cx, cy, cz;          // центр масс
+    double size;                // сторона ячейки
+    int first, count;           // диапазон тел в отсортированном порядке
+    int child_first;            // дети занимают nchildren узлов подряд
+    int nchildren;              // 0 - лист
+} BHNode;
+
+struct BHTree {
+    int capacity;
+    int node_count;
+    BHNode* nodes;
+    uint64_t* codes;
+    uint64_t* codes_tmp;
+    int* order;                 // order[k] - исходный номер k-го тела после сортировки
+    int* order_tmp;
+    double* sm;                 // массы и координаты в отсортированном порядке
+    double* sx;
+    double* sy;
+    double* sz;
+    size_t* histogram;          // 256 счётчиков на поток для поразрядной сортировки
+    int histogram_threads;
+};
+
+BHTree* bh_create(int n) {
+    BHTree* tree = (BHTree*)calloc(1, sizeof(BHTree));
+    if (!tree) {
+        return NULL;
+    }
+    int cap = n > 0 ? n : 1;
+    tree->capacity = cap;
+    tree->nodes = (BHNode*)malloc((size_t)(2 * cap + 1) * sizeof(BHNode));
+    tree->codes = (uint64_t*)malloc(cap * sizeof(uint64_t));
+    tree->codes_tmp = (uint64_t*)malloc(cap * sizeof(uint64_t));
+    tree->order = (int*)malloc(cap * sizeof(int));
+    tree->order_tmp = (int*)malloc(cap * sizeof(int));
+    tree->sm = (double*)malloc(cap * sizeof(double));
+    tree->sx = (double*)malloc(cap * sizeof(double));
+    tree->sy = (double*)malloc(cap * sizeof(double));
+    tree->sz = (double*)malloc(cap * sizeof(double));
+    tree->histogram_threads = omp_get_max_threads();
+    tree->histogram = (size_t*)malloc((size_t)tree->histogram_threads * 256 * sizeof(size_t));
+    if (!tree->nodes || !tree->codes || !tree->codes_tmp || !tree->order || !tree->order_tmp ||
+        !tree->sm || !tree->sx || !tree->sy || !tree->sz || !tree->histogram) {
+        bh_destroy(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+void bh_destroy(BHTree* tree) {
+    if (!tree) {
+        return;
+    }
+    free(tree->nodes);
+    free(tree->codes);
+    free(tree->codes_tmp);
+    free(tree->order);
+    free(tree->order_tmp);
+    free(tree->sm);
+    free(tree->sx);
+    free(tree->sy);
+    free(tree->sz);
+    free(tree->histogram);
+    free(tree);
+}
+
+// Раздвигает 21 младший бит так, чтобы между ними было по два нулевых бита
+static inline uint64_t spread_bits(uint64_t v) {
+    v &= 0x1FFFFF;
+    v = (v | (v << 32)) & 0x1F00000000FFFFULL;
+    v = (v | (v << 16)) & 0x1F0000FF0000FFULL;
+    v = (v | (v << 8)) & 0x100F00F00F00F00FULL;
+    v = (v | (v << 4)) & 0x10C30C30C30C30C3ULL;
+    v = (v | (v << 2)) & 0x1249249249249249ULL;
+    return v;
+}
+
+// Устойчивая параллельная LSD-сортировка пар (код, номер) по 8 бит за проход
+static void radix_sort(BHTree* tree, int n) {
+    uint64_t* keys = tree->codes;
+    uint64_t* keys_tmp = tree->codes_tmp;
+    int* idx = tree->order;
+    int* idx_tmp = tree->order_tmp;
+
+    for (int shift = 0; shift < 3 * MORTON_BITS; shift += 8) {
+        #pragma omp parallel num_threads(tree->histogram_threads)
+        {
+            int tid = omp_get_thread_num();
+            int nthreads = omp_get_num_threads();
+            int lo = (int)((long)n * tid / nthreads);
+            int hi = (int)((long)n * (tid + 1) / nthreads);
+            size_t* hist = tree->histogram + 256 * tid;
+
+            memset(hist, 0, 256 * sizeof(size_t));
+            for (int k = lo; k < hi; k++) {
+                hist[(keys[k] >> shift) & 0xFF]++;
+            }
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                // Смещения: сначала по цифре, внутри цифры - по номеру потока
+                size_t offset = 0;
+                for (int digit = 0; digit < 256; digit++) {
+                    for (int t = 0; t < nthreads; t++) {
+                        size_t c = tree->histogram[256 * t + digit];
+                        tree->histogram[256 * t + digit] = offset;
+                        offset += c;
+                    }
+                }
+            }
+
+            for (int k = lo; k < hi; k++) {
+                size_t pos = hist[(keys[k] >> shift) & 0xFF]++;
+                keys_tmp[pos] = keys[k];
+                idx_tmp[pos] = idx[k];
+            }
+        }
+
+        uint64_t* kt = keys; keys = keys_tmp; keys_tmp = kt;
+        int* it = idx; idx = idx_tmp; idx_tmp = it;
+    }
+
+    tree->codes = keys;
+    tree->codes_tmp = keys_tmp;
+    tree->order = idx;
+    tree->order_tmp = idx_tmp;
+}
+
+static int alloc_nodes(BHTree* tree, int count) {
+    int first;
+    #pragma omp atomic capture
+    { first = tree->node_count; tree->node_count += count; }
+    return first;
+}
+
+static void make_leaf(BHTree* tree, BHNode* node) {
+    double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    for (int k = node->first; k < node->first + node->count; k++) {
+        mass += tree->sm[k];
+        cx += tree->sm[k] * tree->sx[k];
+        cy += tree->sm[k] * tree->sy[k];
+        cz += tree->sm[k] * tree->sz[k];
+    }
+    node->nchildren = 0;
+    node->mass = mass;
+    if (mass > 0.0) {
+        node->cx = cx / mass;
+        node->cy = cy / mass;
+        node->cz = cz / mass;
+    } else {
+        node->cx = tree->sx[node->first];
+        node->cy = tree->sy[node->first];
+        node->cz = tree->sz[node->first];
+    }
+}
+
+// Строит узел для тел [first, first + count), все их коды уже отсортированы.
+// Уровни, на которых диапазон не делится, пропускаются: ячейкой узла становится
+// наименьшая ячейка, содержащая все его тела, поэтому у внутреннего узла
+// не меньше двух детей и всего узлов меньше 2n.
+static void build_node(BHTree* tree, int index, double root_size) {
+    BHNode* node = &tree->nodes[index];
+    int first = node->first;
+    int last = first + node->count - 1;
+    uint64_t diff = tree->codes[first] ^ tree->codes[last];
+
+    if (diff == 0) {
+        // Все тела в одной ячейке наименьшего размера
+        node->size = 0.0;
+        make_leaf(tree, node);
+        return;
+    }
+
+    // Уровень, на котором тела расходятся по разным октантам
+    int level = (3 * MORTON_BITS - 1 - (63 - __builtin_clzll(diff))) / 3;
+    node->size = ldexp(root_size, -level);
+
+    if (node->count <= LEAF_SIZE) {
+        make_leaf(tree, node);
+        return;
+    }
+
+    // Границы детей: тела отсортированы, поэтому октанты идут подряд
+    int shift = 3 * (MORTON_BITS - 1 - level);
+    int nchildren = 0;
+    int starts[8], counts[8];
+    for (int digit = 0, k = first; digit < 8; digit++) {
+        int lo = k, hi = last + 1;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if ((int)((tree->codes[mid] >> shift) & 7) <= digit) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo > k) {
+            starts[nchildren] = k;
+            counts[nchildren] = lo - k;
+            nchildren++;
+        }
+        k = lo;
+    }
+
+    int child_first = alloc_nodes(tree, nchildren);
+    node->child_first = child_first;
+    node->nchildren = nchildren;
+
+    for (int c = 0; c < nchildren; c++) {
+        BHNode* child = &tree->nodes[child_first + c];
+        child->first = starts[c];
+        child->count = counts[c];
+        if (counts[c] > TASK_CUTOFF) {
+            #pragma omp task firstprivate(c)
+            build_node(tree, child_first + c, root_size);
+        } else {
+            build_node(tree, child_first + c, root_size);
+        }
+    }
+    #pragma omp taskwait
+
+    // Моменты узла снизу вверх по уже готовым детям
+    double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    for (int c = 0; c < nchildren; c++) {
+        const BHNode* child = &tree->nodes[child_first + c];
+        mass += child->mass;
+        cx += child->mass * child->cx;
+        cy += child->mass * child->cy;
+        cz += child->mass * child->cz;
+    }
+    node->mass = mass;
+    node->cx = mass > 0.0 ? cx / mass : tree->nodes[child_first].cx;
+    node->cy = mass > 0.0 ? cy / mass : tree->nodes[child_first].cy;
+    node->cz = mass > 0.0 ? cz / mass : tree->nodes[child_first].cz;
+}
+
+static void build_tree(BHTree* tree, int n, const double* m, const double* x, const double* y, const double* z,
+                       double* root_size) {
+    double xmin = x[0], xmax = x[0], ymin = y[0], ymax = y[0], zmin = z[0], zmax = z[0];
+
+    #pragma omp parallel for reduction(min: xmin, ymin, zmin) reduction(max: xmax, ymax, zmax)
+    for (int i = 0; i < n; i++) {
+        xmin = fmin(xmin, x[i]); xmax = fmax(xmax, x[i]);
+        ymin = fmin(ymin, y[i]); ymax = fmax(ymax, y[i]);
+        zmin = fmin(zmin, z[i]); zmax = fmax(zmax, z[i]);
+    }
+
+    double size = fmax(xmax - xmin, fmax(ymax - ymin, zmax - zmin));
+    if (size <= 0.0) {
+        size = 1.0;
+    }
+    *root_size = size;
+    double scale = (double)((1 << MORTON_BITS) - 1) / size;
+
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        uint64_t ix = (uint64_t)((x[i] - xmin) * scale);
+        uint64_t iy = (uint64_t)((y[i] - ymin) * scale);
+        uint64_t iz = (uint64_t)((z[i] - zmin) * scale);
+        tree->codes[i] = (spread_bits(ix) << 2) | (spread_bits(iy) << 1) | spread_bits(iz);
+        tree->order[i] = i;
+    }
+
+    radix_sort(tree, n);
+
+    #pragma omp parallel for
+    for (int k = 0; k < n; k++) {
+        int i = tree->order[k];
+        tree->sm[k] = m[i];
+        tree->sx[k] = x[i];
+        tree->sy[k] = y[i];
+        tree->sz[k] = z[i];
+    }
+
+    tree->node_count = 1;
+    tree->nodes[0].first = 0;
+    tree->nodes[0].count = n;
+
+    #pragma omp parallel
+    #pragma omp single
+    build_node(tree, 0, size);
+}
+
+void bh_compute_accelerations(BHTree* tree, int n, double G, double softening, double theta,
+                              const double* m, const double* x, const double* y, const double* z,
+                              double* ax, double* ay, double* az) {
+    if (n == 0) {
+        return;
+    }
+
+    double root_size;
+    build_tree(tree, n, m, x, y, z, &root_size);
+    double theta2 = theta * theta;
+    const BHNode* nodes = tree->nodes;
+
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskloop grainsize(TRAVERSAL_GRAIN)
+    for (int k = 0; k < n; k++) {
+        double xi = tree->sx[k], yi = tree->sy[k], zi = tree->sz[k];
+        double axi = 0.0, ayi = 0.0, azi = 0.0;
+        int stack[STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const BHNode* node = &nodes[stack[--top]];
+            int contains_self = k >= node->first && k < node->first + node->count;
+
+            double dx = node->cx - xi;
+            double dy = node->cy - yi;
+            double dz = node->cz - zi;
+            double r2 = dx*dx + dy*dy + dz*dz;
+
+            if (!contains_self && node->size * node->size < theta2 * r2) {
+                // Узел достаточно далеко: вся масса в центре масс
+                double r = sqrt(r2);
+                double f = G * node->mass / (r * r * r + softening);
+                axi += f * dx;
+                ayi += f * dy;
+                azi += f * dz;
+            } else if (node->nchildren == 0) {
+                for (int j = node->first; j < node->first + node->count; j++) {
+                    double ddx = tree->sx[j] - xi;
+                    double ddy = tree->sy[j] - yi;
+                    double ddz = tree->sz[j] - zi;
+                    double rr = sqrt(ddx*ddx + ddy*ddy + ddz*ddz);
+                    double f = G * tree->sm[j] / (rr * rr * rr + softening);
+                    axi += f * ddx;
+                    ayi += f * ddy;
+                    azi += f * ddz;
+                }
+            } else {
+                for (int c = 0; c < node->nchildren; c++) {
+                    stack[top++] = node->child_first + c;
+                }
+            }
+        }
+
+        int i = tree->order[k];
+        ax[i] = axi;
+        ay[i] = ayi;
+        az[i] = azi;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef BARNES_HUT_H
+#define BARNES_HUT_H
+
+/*
+ * Barnes–Hut: приближённое вычисление гравитационных ускорений за O(N log N).
+ *
+ * На каждом шаге дерево строится заново:
+ *   1. ограничивающий куб и 63-битные коды Мортона тел (параллельно);
+ *   2. параллельная поразрядная сортировка тел по кодам;
+ *   3. построение октодерева по отсортированным кодам (задачи OpenMP),
+ *      массы и центры масс узлов вычисляются снизу вверх;
+ *   4. обход дерева для каждого тела (taskloop): узел размера s на расстоянии d
+ *      заменяется точечной массой, если s / d < theta.
+ */
+
+typedef struct BHTree BHTree;
+
+BHTree* bh_create(int n);
+void bh_destroy(BHTree* tree);
+
+/*
+ * Ускорения всех тел: a_i = sum_j G m_j (r_j - r_i) / (|r_j - r_i|^3 + softening).
+ * theta = 0 даёт точную (прямую) сумму.
+ */
+void bh_compute_accelerations(BHTree* tree, int n, double G, double softening, double theta,
+                              const double* m, const double* x, const double* y, const double* z,
+                              double* ax, double* ay, double* az);
+
+#endif
@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# bench_forces.sh - Сравнение стратегий вычисления сил (atomic / private / full / bh)
+#
+# Для каждого числа частиц генерирует случайные начальные условия в формате
+# input.txt, запускает ./openmp со всеми стратегиями на разном числе потоков
+# и сводит медианное время в таблицу results/forces_benchmark.txt.
+#
+# Использование: ./bench_forces.sh [путь к ./openmp]
+
+BIN=${1:-./openmp}
+BODY_COUNTS="1000 4000"
+THREAD_COUNTS="1 2 4 8"
+STRATEGIES="atomic private full bh"
+T_END=0.1
+NUM_RUNS=3
+
+if [ ! -x "$BIN" ]; then
+    echo "Build the solver first: gcc -fopenmp -O3 -o openmp openmp.c barnes_hut.c trajectory.c checkpoint.c input_parser.c -lm"
+    exit 1
+fi
+BIN=$(cd "$(dirname "$BIN")" && pwd)/$(basename "$BIN")
+
+WORK_DIR=$(mktemp -d)
+mkdir -p results
+SUMMARY=results/forces_benchmark.txt
+
+{
+    echo "FORCE STRATEGY BENCHMARK"
+    echo "========================"
+    echo ""
+    echo "t_end: $T_END (dt = 0.01), runs per config: $NUM_RUNS (median)"
+    echo ""
+    printf "%-8s | %-8s | %-12s | %-12s | %-12s | %-12s\n" "Bodies" "Threads" "atomic(s)" "private(s)" "full(s)" "bh(s)"
+    echo "---------|----------|--------------|--------------|--------------|-------------"
+} > "$SUMMARY"
+
+for n in $BODY_COUNTS; do
+    # Случайные тела в кубе со стороной 200 м, массы 1e6..1e8 кг
+    awk -v n="$n" 'BEGIN {
+        srand(1);
+        print n;
+        for (i = 0; i < n; i++)
+            printf "%.6f %.6f %.6f %.6f %.6f %.6f %.6f\n", 1e6 + rand() * 1e8,
+                   rand() * 200 - 100, rand() * 200 - 100, rand() * 200 - 100,
+                   rand() * 0.02 - 0.01, rand() * 0.02 - 0.01, rand() * 0.02 - 0.01;
+    }' > "$WORK_DIR/input_$n.txt"
+
+    for threads in $THREAD_COUNTS; do
+        line=$(printf "%-8s | %-8s" "$n" "$threads")
+        for strategy in $STRATEGIES; do
+            > "$WORK_DIR/times.txt"
+            for run in $(seq 1 $NUM_RUNS); do
+                (cd "$WORK_DIR" && OMP_NUM_THREADS=$threads "$BIN" $T_END "input_$n.txt" --forces=$strategy) \
+                    | grep "Total simulation time" | sed 's/.*: \(.*\) seconds/\1/' >> "$WORK_DIR/times.txt"
+            done
+            median=$(sort -g "$WORK_DIR/times.txt" | awk '{ v[NR] = $1 } END { if (NR > 0) print v[int((NR + 1) / 2)]; else print "N/A" }')
+            line="$line | $(printf "%-12s" "$median")"
+        done
+        echo "$line"
+        echo "$line" >> "$SUMMARY"
+    done
+done
+
+rm -rf "$WORK_DIR"
+echo ""
+echo "Results saved to $SUMMARY"
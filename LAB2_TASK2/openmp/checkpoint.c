@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+struct CheckpointWriter {
+    char* path;
+    char* tmp_path;
+    void* buffers[2];
+    size_t capacity[2];
+    size_t bytes[2];
+    int filling;            // буфер, который сейчас заполняет расчёт
+    int queued[2];          // очередь на запись: queued[0] пишется потоком
+    int nqueued;
+    int done;
+    int errors;
+    int threaded;           // 0 - поток не создался, точки пишутся синхронно в checkpoint_submit
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+};
+
+static int write_file(const char* tmp_path, const char* path, const void* data, size_t bytes) {
+    FILE* fout = fopen(tmp_path, "wb");
+    if (!fout) {
+        return -1;
+    }
+    int rc = fwrite(data, 1, bytes, fout) == bytes ? 0 : -1;
+    if (fflush(fout) != 0 || fsync(fileno(fout)) != 0) {
+        rc = -1;
+    }
+    if (fclose(fout) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+static void* checkpoint_writer_main(void* arg) {
+    CheckpointWriter* w = (CheckpointWriter*)arg;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->nqueued == 0 && !w->done) {
+            pthread_cond_wait(&w->changed, &w->lock);
+        }
+        if (w->nqueued == 0) {
+            break;
+        }
+        int b = w->queued[0];
+        pthread_mutex_unlock(&w->lock);
+
+        int rc = write_file(w->tmp_path, w->path, w->buffers[b], w->bytes[b]);
+        if (rc != 0) {
+            fprintf(stderr, "Cant write checkpoint: %s\n", w->path);
+        }
+
+        pthread_mutex_lock(&w->lock);
+        if (rc != 0) {
+            w->errors++;
+        }
+        w->queued[0] = w->queued[1];
+        w->nqueued--;
+        pthread_cond_broadcast(&w->changed);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+CheckpointWriter* checkpoint_writer_create(const char* path) {
+    CheckpointWriter* w = (CheckpointWriter*)calloc(1, sizeof(CheckpointWriter));
+    if (!w) {
+        return NULL;
+    }
+    size_t len = strlen(path);
+    w->path = (char*)malloc(len + 1);
+    w->tmp_path = (char*)malloc(len + 5);
+    if (!w->path || !w->tmp_path) {
+        free(w->path);
+        free(w->tmp_path);
+        free(w);
+        return NULL;
+    }
+    memcpy(w->path, path, len + 1);
+    memcpy(w->tmp_path, path, len);
+    memcpy(w->tmp_path + len, ".tmp", 5);
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->changed, NULL);
+    w->threaded = pthread_create(&w->thread, NULL, checkpoint_writer_main, w) == 0;
+    if (!w->threaded) {
+        fprintf(stderr, "Cant start checkpoint writer thread, checkpoints will be written synchronously\n");
+    }
+    return w;
+}
+
+int checkpoint_writer_destroy(CheckpointWriter* w) {
+    if (!w) {
+        return 0;
+    }
+    pthread_mutex_lock(&w->lock);
+    w->done = 1;
+    pthread_cond_broadcast(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+    if (w->threaded) {
+        pthread_join(w->thread, NULL);
+    }
+
+    int rc = w->errors ? -1 : 0;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->changed);
+    free(w->buffers[0]);
+    free(w->buffers[1]);
+    free(w->path);
+    free(w->tmp_path);
+    free(w);
+    return rc;
+}
+
+void* checkpoint_buffer(CheckpointWriter* w, size_t bytes) {
+    pthread_mutex_lock(&w->lock);
+    // Оба буфера заняты: один пишется, второй ждёт очереди
+    while (w->nqueued == 2) {
+        pthread_cond_wait(&w->changed, &w->lock);
+    }
+    int b = w->nqueued == 1 ? 1 - w->queued[0] : 0;
+    pthread_mutex_unlock(&w->lock);
+
+    w->filling = b;
+    if (w->capacity[b] < bytes) {
+        void* grown = realloc(w->buffers[b], bytes);
+        if (!grown) {
+            return NULL;
+        }
+        w->buffers[b] = grown;
+        w->capacity[b] = bytes;
+    }
+    return w->buffers[b];
+}
+
+void checkpoint_submit(CheckpointWriter* w, size_t bytes) {
+    if (!w->threaded) {
+        if (write_file(w->tmp_path, w->path, w->buffers[w->filling], bytes) != 0) {
+            fprintf(stderr, "Cant write checkpoint: %s\n", w->path);
+            w->errors++;
+        }
+        return;
+    }
+    pthread_mutex_lock(&w->lock);
+    w->bytes[w->filling] = bytes;
+    w->queued[w->nqueued++] = w->filling;
+    pthread_cond_broadcast(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+}
+
+void* checkpoint_read(const char* path, size_t* bytes) {
+    FILE* fin = fopen(path, "rb");
+    if (!fin) {
+        fprintf(stderr, "Cant open checkpoint: %s\n", path);
+        return NULL;
+    }
+    void* data = NULL;
+    long size = -1;
+    if (fseek(fin, 0, SEEK_END) == 0) {
+        size = ftell(fin);
+    }
+    if (size > 0 && fseek(fin, 0, SEEK_SET) == 0) {
+        data = malloc((size_t)size);
+        if (data && fread(data, 1, (size_t)size, fin) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(fin);
+    if (!data) {
+        fprintf(stderr, "Cant read checkpoint: %s\n", path);
+        return NULL;
+    }
+    *bytes = (size_t)size;
+    return data;
+}
@@ -0,0 +1,30 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+
+/*
+ * Асинхронная запись контрольных точек.
+ *
+ * Расчёт копирует своё состояние в один из двух буферов писателя и сразу продолжает
+ * работу, а отдельный поток записывает буфер во временный файл, сбрасывает его на диск
+ * (fsync) и атомарно переименовывает поверх прежней точки. Поэтому на диске всегда
+ * лежит целый последний снимок, даже если процесс упал посреди записи. Ждать приходится,
+ * только если предыдущая точка ещё не записана, а следующая уже готова.
+ */
+
+typedef struct CheckpointWriter CheckpointWriter;
+
+CheckpointWriter* checkpoint_writer_create(const char* path);
+/* Дожидается записи всех точек; возвращает -1, если хотя бы одна не записалась */
+int checkpoint_writer_destroy(CheckpointWriter* w);
+
+/* Свободный буфер не меньше bytes байт для следующей точки */
+void* checkpoint_buffer(CheckpointWriter* w, size_t bytes);
+/* Передать заполненный буфер потоку записи */
+void checkpoint_submit(CheckpointWriter* w, size_t bytes);
+
+/* Прочитать файл точки целиком; буфер освобождается free() */
+void* checkpoint_read(const char* path, size_t* bytes);
+
+#endif
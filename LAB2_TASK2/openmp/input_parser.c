@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include "input_parser.h"
+
+#define CHUNKS_PER_THREAD 4     // куски меньше потока выравнивают неравные строки
+#define BINARY_HEADER_BYTES 16
+#define MAX_TOKEN 128
+
+struct InputFile {
+    int fd;
+    const char* data;
+    size_t size;
+    int binary;
+    int n;
+    size_t body_offset;         // начало данных тел
+};
+
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Число из [p, end) без завершающего нуля; 0 - успех
+static int parse_double(const char* p, const char* end, double* out) {
+    const char* s = p;
+    int negative = 0;
+    if (s < end && (*s == '+' || *s == '-')) {
+        negative = *s == '-';
+        s++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0, any = 0, truncated = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; s++) {
+        any = 1;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*s - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+            truncated |= *s != '0';
+        }
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++) {
+            any = 1;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*s - '0');
+                digits += mantissa != 0;
+                exponent--;
+            } else {
+                truncated |= *s != '0';
+            }
+        }
+    }
+    if (any && s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s + 1;
+        int exp_negative = 0, exp_value = 0, exp_any = 0;
+        if (e < end && (*e == '+' || *e == '-')) {
+            exp_negative = *e == '-';
+            e++;
+        }
+        for (; e < end && *e >= '0' && *e <= '9'; e++) {
+            exp_any = 1;
+            if (exp_value < 100000) {
+                exp_value = exp_value * 10 + (*e - '0');
+            }
+        }
+        if (exp_any) {
+            exponent += exp_negative ? -exp_value : exp_value;
+            s = e;
+        }
+    }
+
+    // Быстрый путь Клингера: обе величины точно представимы, одно округление
+    if (any && s == end && !truncated && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+        *out = negative ? -value : value;
+        return 0;
+    }
+
+    // Длинные мантиссы, большие порядки, inf/nan, шестнадцатеричная запись
+    size_t length = (size_t)(end - p);
+    char buffer[MAX_TOKEN];
+    if (length >= sizeof(buffer)) {
+        return -1;
+    }
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+    char* stop;
+    *out = strtod(buffer, &stop);
+    return stop == buffer + length && length > 0 ? 0 : -1;
+}
+
+InputFile* input_open(const char* path, int* n) {
+    InputFile* in = (InputFile*)calloc(1, sizeof(InputFile));
+    if (!in) {
+        return NULL;
+    }
+    in->fd = open(path, O_RDONLY);
+    if (in->fd < 0) {
+        fprintf(stderr, "Cant open input file: %s\n", path);
+        free(in);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(in->fd, &st) == 0 && st.st_size > 0) {
+        in->size = (size_t)st.st_size;
+        void* data = mmap(NULL, in->size, PROT_READ, MAP_PRIVATE, in->fd, 0);
+        in->data = data == MAP_FAILED ? NULL : (const char*)data;
+    }
+    if (!in->data) {
+        fprintf(stderr, "Error reading number of particles\n");
+        input_close(in);
+        return NULL;
+    }
+    madvise((void*)in->data, in->size, MADV_WILLNEED);
+
+    if (in->size >= BINARY_HEADER_BYTES && memcmp(in->data, INPUT_MAGIC, 4) == 0) {
+        uint32_t version;
+        uint64_t count;
+        memcpy(&version, in->data + 4, sizeof(version));
+        memcpy(&count, in->data + 8, sizeof(count));
+        if (version != INPUT_VERSION || count > INT_MAX ||
+            in->size < BINARY_HEADER_BYTES + INPUT_COLUMNS * count * sizeof(double)) {
+            fprintf(stderr, "Unsupported or truncated binary input: %s\n", path);
+            input_close(in);
+            return NULL;
+        }
+        in->binary = 1;
+        in->n = (int)count;
+        in->body_offset = BINARY_HEADER_BYTES;
+        *n = in->n;
+        return in;
+    }
+
+    // Первое число файла - количество тел
+    size_t pos = 0;
+    while (pos < in->size && is_space(in->data[pos])) {
+        pos++;
+    }
+    size_t start = pos;
+    while (pos < in->size && !is_space(in->data[pos])) {
+        pos++;
+    }
+    char* stop;
+    char buffer[32];
+    long count = -1;
+    if (pos > start && pos - start < sizeof(buffer)) {
+        memcpy(buffer, in->data + start, pos - start);
+        buffer[pos - start] = '\0';
+        count = strtol(buffer, &stop, 10);
+        if (*stop != '\0') {
+            count = -1;
+        }
+    }
+    if (count < 0 || count > INT_MAX) {
+        fprintf(stderr, "Error reading number of particles\n");
+        input_close(in);
+        return NULL;
+    }
+    in->n = (int)count;
+    in->body_offset = pos;
+    *n = in->n;
+    return in;
+}
+
+int input_is_binary(const InputFile* in) {
+    return in->binary;
+}
+
+static int read_binary(InputFile* in, double* const columns[INPUT_COLUMNS]) {
+    const char* base = in->data + in->body_offset;
+    size_t n = (size_t)in->n;
+    int chunks = omp_get_max_threads() * CHUNKS_PER_THREAD;
+
+    #pragma omp parallel for schedule(static)
+    for (int task = 0; task < INPUT_COLUMNS * chunks; task++) {
+        int c = task / chunks, k = task % chunks;
+        size_t first = n * k / chunks, last = n * (k + 1) / chunks;
+        memcpy(columns[c] + first, base + (c * n + first) * sizeof(double), (last - first) * sizeof(double));
+    }
+    return 0;
+}
+
+static int read_text(InputFile* in, double* const columns[INPUT_COLUMNS]) {
+    const char* data = in->data;
+    size_t size = in->size;
+    size_t body = in->body_offset;
+    int chunks = omp_get_max_threads() * CHUNKS_PER_THREAD;
+    size_t* bounds = (size_t*)malloc((chunks + 1) * sizeof(size_t));
+    size_t* first_value = (size_t*)malloc((chunks + 1) * sizeof(size_t));
+    if (!bounds || !first_value) {
+        free(bounds);
+        free(first_value);
+        return -1;
+    }
+
+    // Границы кусков сдвигаются на начало следующей строки, так что числа не разрываются
+    bounds[0] = body;
+    for (int k = 1; k < chunks; k++) {
+        size_t pos = body + (size - body) * k / chunks;
+        if (pos < bounds[k - 1]) {
+            pos = bounds[k - 1];
+        }
+        while (pos < size && data[pos - 1] != '\n') {
+            pos++;
+        }
+        bounds[k] = pos;
+    }
+    bounds[chunks] = size;
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < chunks; k++) {
+        size_t count = 0;
+        int in_token = 0;
+        for (size_t pos = bounds[k]; pos < bounds[k + 1]; pos++) {
+            int token = !is_space(data[pos]);
+            count += token && !in_token;
+            in_token = token;
+        }
+        first_value[k + 1] = count;
+    }
+    first_value[0] = 0;
+    for (int k = 0; k < chunks; k++) {
+        first_value[k + 1] += first_value[k];
+    }
+
+    size_t needed = (size_t)in->n * INPUT_COLUMNS;
+    size_t first_error = first_value[chunks] < needed ? first_value[chunks] : SIZE_MAX;
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < chunks; k++) {
+        size_t index = first_value[k];
+        size_t pos = bounds[k], end = bounds[k + 1];
+        while (index < needed) {
+            while (pos < end && is_space(data[pos])) {
+                pos++;
+            }
+            if (pos == end) {
+                break;
+            }
+            size_t start = pos;
+            while (pos < end && !is_space(data[pos])) {
+                pos++;
+            }
+            double value;
+            if (parse_double(data + start, data + pos, &value) != 0) {
+                #pragma omp critical(input_error)
+                if (index < first_error) {
+                    first_error = index;
+                }
+                break;
+            }
+            columns[index % INPUT_COLUMNS][index / INPUT_COLUMNS] = value;
+            index++;
+        }
+    }
+
+    free(bounds);
+    free(first_value);
+    if (first_error != SIZE_MAX) {
+        static const char* what[] = { "mass", "position", "position", "position", "velocity", "velocity", "velocity" };
+        fprintf(stderr, "Error reading %s for particle %zu\n", what[first_error % INPUT_COLUMNS], first_error / INPUT_COLUMNS + 1);
+        return -1;
+    }
+    return 0;
+}
+
+int input_read(InputFile* in, double* const columns[INPUT_COLUMNS]) {
+    return in->binary ? read_binary(in, columns) : read_text(in, columns);
+}
+
+void input_close(InputFile* in) {
+    if (!in) {
+        return;
+    }
+    if (in->data) {
+        munmap((void*)in->data, in->size);
+    }
+    if (in->fd >= 0) {
+        close(in->fd);
+    }
+    free(in);
+}
+
+int input_save_binary(const char* path, int n, const double* const columns[INPUT_COLUMNS]) {
+    FILE* fout = fopen(path, "wb");
+    if (!fout) {
+        fprintf(stderr, "Cant create binary input file: %s\n", path);
+        return -1;
+    }
+    uint32_t version = INPUT_VERSION;
+    uint64_t count = (uint64_t)n;
+    int rc = fwrite(INPUT_MAGIC, 1, 4, fout) == 4 &&
+             fwrite(&version, sizeof(version), 1, fout) == 1 &&
+             fwrite(&count, sizeof(count), 1, fout) == 1 ? 0 : -1;
+    for (int c = 0; c < INPUT_COLUMNS && rc == 0; c++) {
+        rc = fwrite(columns[c], sizeof(double), (size_t)n, fout) == (size_t)n ? 0 : -1;
+    }
+    if (fclose(fout) != 0 || rc != 0) {
+        fprintf(stderr, "Cant write binary input file: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
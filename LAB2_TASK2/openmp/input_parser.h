@@ -0,0 +1,36 @@
+#ifndef INPUT_PARSER_H
+#define INPUT_PARSER_H
+
+/*
+ * Загрузка начальных условий через mmap.
+ *
+ * Текстовый формат (input.txt): число тел n, затем по 7 чисел на тело m x y z vx vy vz,
+ * разделённых любыми пробельными символами. Файл режется на куски по границам строк;
+ * первым проходом потоки считают числа в своих кусках, префиксная сумма даёт номер
+ * первого числа куска, вторым проходом куски разбираются параллельно прямо в массивы.
+ * Числа читаются быстрым путём Клингера (не более 19 значащих цифр, мантисса до 2^53
+ * и |порядок| <= 22 - результат точен), остальные - через strtod, поэтому значения
+ * совпадают с fscanf("%lf") бит в бит.
+ *
+ * Двоичный формат (как --save-input у nbody_newton.cu): заголовок
+ * { char magic[4] = "NBIN"; uint32_t version = 1; uint64_t n; } и семь массивов double
+ * по n элементов в порядке m, x, y, z, vx, vy, vz - копируются без разбора.
+ */
+
+#define INPUT_COLUMNS 7
+#define INPUT_MAGIC "NBIN"
+#define INPUT_VERSION 1
+
+typedef struct InputFile InputFile;
+
+/* Открывает файл и читает n; формат определяется по сигнатуре */
+InputFile* input_open(const char* path, int* n);
+int input_is_binary(const InputFile* in);
+/* columns - m, x, y, z, vx, vy, vz по n элементов */
+int input_read(InputFile* in, double* const columns[INPUT_COLUMNS]);
+void input_close(InputFile* in);
+
+/* Сохранение в двоичном формате для следующих запусков */
+int input_save_binary(const char* path, int n, const double* const columns[INPUT_COLUMNS]);
+
+#endif
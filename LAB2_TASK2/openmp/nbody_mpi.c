@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "nbody_mpi.h"
+
+#define RING_TAG 17
+
+struct RingComm {
+    MPI_Comm comm;
+    int rank;
+    int size;
+    int n;
+    int* counts;                // тел в блоке каждого ранга
+    int* offsets;
+    int max_count;
+    double* blocks[2];          // текущий и принимаемый блок: m, x, y, z по max_count
+};
+
+RingComm* ring_create(MPI_Comm comm, int n) {
+    RingComm* ring = (RingComm*)calloc(1, sizeof(RingComm));
+    if (!ring) {
+        return NULL;
+    }
+    ring->comm = comm;
+    ring->n = n;
+    MPI_Comm_rank(comm, &ring->rank);
+    MPI_Comm_size(comm, &ring->size);
+
+    ring->counts = (int*)malloc(ring->size * sizeof(int));
+    ring->offsets = (int*)malloc(ring->size * sizeof(int));
+    if (!ring->counts || !ring->offsets) {
+        ring_destroy(ring);
+        return NULL;
+    }
+    for (int r = 0; r < ring->size; r++) {
+        ring->offsets[r] = (int)((long long)n * r / ring->size);
+        ring->counts[r] = (int)((long long)n * (r + 1) / ring->size) - ring->offsets[r];
+        if (ring->counts[r] > ring->max_count) {
+            ring->max_count = ring->counts[r];
+        }
+    }
+
+    size_t block = 4 * (size_t)(ring->max_count > 0 ? ring->max_count : 1);
+    ring->blocks[0] = (double*)malloc(block * sizeof(double));
+    ring->blocks[1] = (double*)malloc(block * sizeof(double));
+    if (!ring->blocks[0] || !ring->blocks[1]) {
+        ring_destroy(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+void ring_destroy(RingComm* ring) {
+    if (!ring) {
+        return;
+    }
+    free(ring->counts);
+    free(ring->offsets);
+    free(ring->blocks[0]);
+    free(ring->blocks[1]);
+    free(ring);
+}
+
+int ring_local_count(const RingComm* ring) {
+    return ring->counts[ring->rank];
+}
+
+int ring_local_offset(const RingComm* ring) {
+    return ring->offsets[ring->rank];
+}
+
+void ring_scatter(RingComm* ring, const double* all, double* local) {
+    MPI_Scatterv(all, ring->counts, ring->offsets, MPI_DOUBLE,
+                 local, ring->counts[ring->rank], MPI_DOUBLE, 0, ring->comm);
+}
+
+void ring_gather(RingComm* ring, const double* local, double* all) {
+    MPI_Gatherv(local, ring->counts[ring->rank], MPI_DOUBLE,
+                all, ring->counts, ring->offsets, MPI_DOUBLE, 0, ring->comm);
+}
+
+// Вклад блока source (count тел) в ускорения своих тел
+static void block_interactions(int nlocal, const double* m, const double* x, const double* y, const double* z,
+                               const double* source, int count, int stride, double G, double softening,
+                               double* ax, double* ay, double* az) {
+    const double* restrict sm = source;
+    const double* restrict sx = source + stride;
+    const double* restrict sy = source + 2 * stride;
+    const double* restrict sz = source + 3 * stride;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < nlocal; i++) {
+        double xi = x[i], yi = y[i], zi = z[i], mi = m[i];
+        double axi = 0.0, ayi = 0.0, azi = 0.0;
+
+        // Своё тело в своём блоке даёт dx = dy = dz = 0 и нулевой вклад
+        #pragma omp simd reduction(+: axi, ayi, azi)
+        for (int j = 0; j < count; j++) {
+            double dx = sx[j] - xi;
+            double dy = sy[j] - yi;
+            double dz = sz[j] - zi;
+
+            double r2 = dx*dx + dy*dy + dz*dz;
+            double r = sqrt(r2);
+            double r3 = r * r * r;
+            double F = G * mi * sm[j] / (r3 + softening);
+
+            axi += F * dx / mi;
+            ayi += F * dy / mi;
+            azi += F * dz / mi;
+        }
+
+        ax[i] += axi;
+        ay[i] += ayi;
+        az[i] += azi;
+    }
+}
+
+void ring_compute_accelerations(RingComm* ring, double G, double softening,
+                                const double* m, const double* x, const double* y, const double* z,
+                                double* ax, double* ay, double* az) {
+    int nlocal = ring->counts[ring->rank];
+    int stride = ring->max_count;
+    int right = (ring->rank + 1) % ring->size;
+    int left = (ring->rank + ring->size - 1) % ring->size;
+
+    double* current = ring->blocks[0];
+    double* next = ring->blocks[1];
+    memcpy(current, m, nlocal * sizeof(double));
+    memcpy(current + stride, x, nlocal * sizeof(double));
+    memcpy(current + 2 * stride, y, nlocal * sizeof(double));
+    memcpy(current + 3 * stride, z, nlocal * sizeof(double));
+    memset(ax, 0, nlocal * sizeof(double));
+    memset(ay, 0, nlocal * sizeof(double));
+    memset(az, 0, nlocal * sizeof(double));
+
+    // На шаге s у ранга блок ранга (rank - s) mod P; блок пересылается целиком
+    // (4 * stride чисел), поэтому размер сообщения не зависит от владельца
+    for (int s = 0; s < ring->size; s++) {
+        int owner = (ring->rank - s + ring->size) % ring->size;
+        MPI_Request requests[2];
+        int pending = s + 1 < ring->size;
+        if (pending) {
+            MPI_Irecv(next, 4 * stride, MPI_DOUBLE, left, RING_TAG, ring->comm, &requests[0]);
+            MPI_Isend(current, 4 * stride, MPI_DOUBLE, right, RING_TAG, ring->comm, &requests[1]);
+        }
+
+        block_interactions(nlocal, m, x, y, z, current, ring->counts[owner], stride, G, softening, ax, ay, az);
+
+        if (pending) {
+            MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+            double* tmp = current;
+            current = next;
+            next = tmp;
+        }
+    }
+}
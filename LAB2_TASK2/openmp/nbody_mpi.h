@@ -0,0 +1,36 @@
+#ifndef NBODY_MPI_H
+#define NBODY_MPI_H
+
+#include <mpi.h>
+
+/*
+ * Кольцевой (систолический) алгоритм всех пар для MPI+OpenMP.
+ *
+ * Тела разбиты на непрерывные блоки по рангам, каждый ранг хранит и интегрирует только свой.
+ * При вычислении сил блок (m, x, y, z) обходит кольцо из P рангов за P - 1 пересылок:
+ * пока текущий блок отправляется соседу справа, а следующий принимается от соседа слева
+ * (MPI_Isend / MPI_Irecv), ранг считает взаимодействия своих тел с текущим блоком потоками
+ * OpenMP. Первым считается собственный блок, так что первая пересылка тоже перекрыта.
+ */
+
+typedef struct RingComm RingComm;
+
+RingComm* ring_create(MPI_Comm comm, int n);
+void ring_destroy(RingComm* ring);
+
+int ring_local_count(const RingComm* ring);
+int ring_local_offset(const RingComm* ring);
+
+/* Раздача массива all длины n с ранга 0 по блокам и обратный сбор на ранг 0 */
+void ring_scatter(RingComm* ring, const double* all, double* local);
+void ring_gather(RingComm* ring, const double* local, double* all);
+
+/*
+ * Ускорения тел своего блока от всех n тел:
+ * a_i = sum_j G m_j (r_j - r_i) / (|r_j - r_i|^3 + softening), как в forces_full.
+ */
+void ring_compute_accelerations(RingComm* ring, double G, double softening,
+                                const double* m, const double* x, const double* y, const double* z,
+                                double* ax, double* ay, double* az);
+
+#endif
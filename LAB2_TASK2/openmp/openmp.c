@@ -2,189 +2,1510 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <unistd.h>
 #include <omp.h>
 
+#include "barnes_hut.h"
+#include "trajectory.h"
+#include "checkpoint.h"
+#include "input_parser.h"
+#ifdef USE_MPI
+#include "nbody_mpi.h"
+#endif
+
 #define G 6.67430e-11
-#define DIM 3
 #define OUTPUT_EVERY 1000
+// Смягчение добавляется к r^3: F = G m_i m_j / (r^3 + SOFTENING). В nbody_newton.cu закон другой -
+// Пламмер (r^2 + 1e-5)^(3/2), поэтому при тесных сближениях результаты версий не совпадают
+#define SOFTENING 1e-10
+
+#define ALIGNMENT 64
 
+// Structure-of-arrays: каждая компонента хранится в отдельном выровненном массиве,
+// поэтому внутренний цикл по j читает только x, y, z, m с единичным шагом
 typedef struct {
-    double m;
-    double r[DIM];
-    double v[DIM];
-    double a[DIM];
-} Particle;
+    int n;
+    double* m;
+    double* x;
+    double* y;
+    double* z;
+    double* vx;
+    double* vy;
+    double* vz;
+    double* ax;
+    double* ay;
+    double* az;
+} Particles;
 
-void calculate_forces(Particle* particles, int n) {
-    #pragma omp parallel for
+static double* alloc_array(int n) {
+    size_t bytes = (size_t)(n > 0 ? n : 1) * sizeof(double);
+    bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    double* p = (double*)aligned_alloc(ALIGNMENT, bytes);
+    if (p) {
+        memset(p, 0, bytes);
+    }
+    return p;
+}
+
+void particles_free(Particles* p) {
+    free(p->m);
+    free(p->x);
+    free(p->y);
+    free(p->z);
+    free(p->vx);
+    free(p->vy);
+    free(p->vz);
+    free(p->ax);
+    free(p->ay);
+    free(p->az);
+}
+
+int particles_alloc(Particles* p, int n) {
+    p->n = n;
+    p->m = alloc_array(n);
+    p->x = alloc_array(n);
+    p->y = alloc_array(n);
+    p->z = alloc_array(n);
+    p->vx = alloc_array(n);
+    p->vy = alloc_array(n);
+    p->vz = alloc_array(n);
+    p->ax = alloc_array(n);
+    p->ay = alloc_array(n);
+    p->az = alloc_array(n);
+    if (!p->m || !p->x || !p->y || !p->z || !p->vx || !p->vy || !p->vz || !p->ax || !p->ay || !p->az) {
+        particles_free(p);
+        return -1;
+    }
+    return 0;
+}
+
+// Стратегии вычисления сил:
+//   FORCES_ATOMIC  - треугольный цикл с 3-м законом Ньютона, ускорения j обновляются атомарно
+//   FORCES_PRIVATE - треугольный цикл, каждый поток копит ускорения в своих массивах,
+//                    которые затем сворачиваются деревом (без атомарных операций)
+//   FORCES_FULL    - полный цикл N^2 без симметрии: строку i считает ровно один поток,
+//                    общих записей нет совсем, но пар вдвое больше
+//   FORCES_BH      - приближённый расчёт Barnes–Hut за O(N log N) с параметром theta
+//   FORCES_RING    - сборка с -DUSE_MPI: полный цикл N^2 по своему блоку тел,
+//                    блоки остальных рангов приходят по кольцу (nbody_mpi.h)
+typedef enum {
+    FORCES_ATOMIC,
+    FORCES_PRIVATE,
+    FORCES_FULL,
+    FORCES_BH,
+    FORCES_RING
+} ForceMode;
+
+static const char* force_mode_names[] = { "atomic", "private", "full", "bh", "ring" };
+
+// Строк треугольного цикла на одну порцию schedule(dynamic): длина строки i равна n-i-1,
+// поэтому статическое разбиение отдало бы первому потоку почти всю работу
+#define TRIANGLE_CHUNK 16
+
+// Рабочие массивы, выделяемые один раз на весь расчёт
+typedef struct {
+    ForceMode mode;
+    int nthreads;
+    int stride;        // длина строки на поток (n, округлённое до строки кэша)
+    double* scratch;   // FORCES_ATOMIC: силы текущей строки, 3 * stride на поток
+    double* acc;       // FORCES_PRIVATE: частные ускорения, 3 * stride на поток
+    BHTree* tree;      // FORCES_BH: октодерево, перестраиваемое на каждом шаге
+    double theta;      // FORCES_BH: угол раскрытия узлов
+#ifdef USE_MPI
+    RingComm* ring;    // FORCES_RING: разбиение тел по рангам и буферы кольца
+#endif
+} ForceWorkspace;
+
+int workspace_init(ForceWorkspace* ws, ForceMode mode, int n, double theta) {
+    ws->mode = mode;
+    ws->theta = theta;
+    ws->tree = NULL;
+#ifdef USE_MPI
+    ws->ring = NULL;
+#endif
+    ws->nthreads = omp_get_max_threads();
+    ws->stride = (n + ALIGNMENT / (int)sizeof(double) - 1) / (ALIGNMENT / (int)sizeof(double)) * (ALIGNMENT / (int)sizeof(double));
+    ws->scratch = NULL;
+    ws->acc = NULL;
+
+    if (mode == FORCES_ATOMIC) {
+        ws->scratch = alloc_array(3 * ws->stride * ws->nthreads);
+        return ws->scratch ? 0 : -1;
+    }
+    if (mode == FORCES_PRIVATE) {
+        ws->acc = alloc_array(3 * ws->stride * ws->nthreads);
+        return ws->acc ? 0 : -1;
+    }
+    if (mode == FORCES_BH) {
+        ws->tree = bh_create(n);
+        return ws->tree ? 0 : -1;
+    }
+    return 0;
+}
+
+void workspace_free(ForceWorkspace* ws) {
+    free(ws->scratch);
+    free(ws->acc);
+    bh_destroy(ws->tree);
+}
+
+static void forces_atomic(Particles* p, ForceWorkspace* ws) {
+    int n = p->n;
+    const double* restrict m = p->m;
+    const double* restrict x = p->x;
+    const double* restrict y = p->y;
+    const double* restrict z = p->z;
+    double* restrict ax = p->ax;
+    double* restrict ay = p->ay;
+    double* restrict az = p->az;
+
+    #pragma omp parallel for simd
     for (int i = 0; i < n; i++) {
-        for (int d = 0; d < DIM; d++) {
-            particles[i].a[d] = 0.0;
+        ax[i] = 0.0;
+        ay[i] = 0.0;
+        az[i] = 0.0;
+    }
+
+    #pragma omp parallel
+    {
+        // Силы строки i сначала считаются векторным циклом во временные массивы,
+        // а атомарные обновления ускорений частиц j выполняются отдельным скалярным циклом
+        double* fx = ws->scratch + 3 * ws->stride * omp_get_thread_num();
+        double* fy = fx + ws->stride;
+        double* fz = fy + ws->stride;
+
+        #pragma omp for schedule(dynamic, TRIANGLE_CHUNK)
+        for (int i = 0; i < n; i++) {
+            double xi = x[i], yi = y[i], zi = z[i], mi = m[i];
+            double axi = 0.0, ayi = 0.0, azi = 0.0;
+
+            #pragma omp simd reduction(+: axi, ayi, azi)
+            for (int j = i + 1; j < n; j++) {
+                double dx = x[j] - xi;
+                double dy = y[j] - yi;
+                double dz = z[j] - zi;
+
+                double r2 = dx*dx + dy*dy + dz*dz;
+                double r = sqrt(r2);
+                double r3 = r * r * r;
+                double F = G * mi * m[j] / (r3 + SOFTENING);
+
+                fx[j] = F * dx;
+                fy[j] = F * dy;
+                fz[j] = F * dz;
+
+                // Ускорения (a = F/m)
+                axi += fx[j] / mi;
+                ayi += fy[j] / mi;
+                azi += fz[j] / mi;
+            }
+
+            // Противоположная сила на j от i (3-й закон Ньютона)
+            for (int j = i + 1; j < n; j++) {
+                #pragma omp atomic
+                ax[j] -= fx[j] / m[j];
+                #pragma omp atomic
+                ay[j] -= fy[j] / m[j];
+                #pragma omp atomic
+                az[j] -= fz[j] / m[j];
+            }
+
+            #pragma omp atomic
+            ax[i] += axi;
+            #pragma omp atomic
+            ay[i] += ayi;
+            #pragma omp atomic
+            az[i] += azi;
         }
     }
+}
 
-    #pragma omp parallel for
+static void forces_private(Particles* p, ForceWorkspace* ws) {
+    int n = p->n;
+    int stride = ws->stride;
+    const double* restrict m = p->m;
+    const double* restrict x = p->x;
+    const double* restrict y = p->y;
+    const double* restrict z = p->z;
+
+    #pragma omp parallel num_threads(ws->nthreads)
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        double* restrict pax = ws->acc + 3 * stride * tid;
+        double* restrict pay = pax + stride;
+        double* restrict paz = pay + stride;
+
+        #pragma omp simd
+        for (int i = 0; i < n; i++) {
+            pax[i] = 0.0;
+            pay[i] = 0.0;
+            paz[i] = 0.0;
+        }
+
+        #pragma omp for schedule(dynamic, TRIANGLE_CHUNK)
+        for (int i = 0; i < n; i++) {
+            double xi = x[i], yi = y[i], zi = z[i], mi = m[i];
+            double axi = 0.0, ayi = 0.0, azi = 0.0;
+
+            #pragma omp simd reduction(+: axi, ayi, azi)
+            for (int j = i + 1; j < n; j++) {
+                double dx = x[j] - xi;
+                double dy = y[j] - yi;
+                double dz = z[j] - zi;
+
+                double r2 = dx*dx + dy*dy + dz*dz;
+                double r = sqrt(r2);
+                double r3 = r * r * r;
+                double F = G * mi * m[j] / (r3 + SOFTENING);
+
+                double Fx = F * dx;
+                double Fy = F * dy;
+                double Fz = F * dz;
+
+                axi += Fx / mi;
+                ayi += Fy / mi;
+                azi += Fz / mi;
+
+                pax[j] -= Fx / m[j];
+                pay[j] -= Fy / m[j];
+                paz[j] -= Fz / m[j];
+            }
+
+            pax[i] += axi;
+            pay[i] += ayi;
+            paz[i] += azi;
+        }
+
+        // Древовидная свёртка: на шаге s поток-массив t прибавляет к себе массив t+s,
+        // каждый шаг распараллелен по частицам; неявный барьер omp for разделяет шаги
+        for (int s = 1; s < nthreads; s *= 2) {
+            #pragma omp for
+            for (int i = 0; i < 3 * stride; i++) {
+                for (int t = 0; t + s < nthreads; t += 2 * s) {
+                    ws->acc[3 * stride * t + i] += ws->acc[3 * stride * (t + s) + i];
+                }
+            }
+        }
+
+        #pragma omp for simd
+        for (int i = 0; i < n; i++) {
+            p->ax[i] = ws->acc[i];
+            p->ay[i] = ws->acc[stride + i];
+            p->az[i] = ws->acc[2 * stride + i];
+        }
+    }
+}
+
+static void forces_full(Particles* p) {
+    int n = p->n;
+    const double* restrict m = p->m;
+    const double* restrict x = p->x;
+    const double* restrict y = p->y;
+    const double* restrict z = p->z;
+
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < n; i++) {
-        for (int j = i + 1; j < n; j++) {
-            double dx = particles[j].r[0] - particles[i].r[0];
-            double dy = particles[j].r[1] - particles[i].r[1];
-            double dz = particles[j].r[2] - particles[i].r[2];
-            
+        double xi = x[i], yi = y[i], zi = z[i], mi = m[i];
+        double axi = 0.0, ayi = 0.0, azi = 0.0;
+
+        // j == i даёт dx = dy = dz = 0 и нулевой вклад, поэтому цикл идёт без ветвлений
+        #pragma omp simd reduction(+: axi, ayi, azi)
+        for (int j = 0; j < n; j++) {
+            double dx = x[j] - xi;
+            double dy = y[j] - yi;
+            double dz = z[j] - zi;
+
             double r2 = dx*dx + dy*dy + dz*dz;
             double r = sqrt(r2);
             double r3 = r * r * r;
-            double F = G * particles[i].m * particles[j].m / (r3 + 1e-10);
+            double F = G * mi * m[j] / (r3 + SOFTENING);
 
-            double Fx = F * dx;
-            double Fy = F * dy;
-            double Fz = F * dz;
-            
-            // Ускорения (a = F/m)
-            #pragma omp atomic
-            particles[i].a[0] += Fx / particles[i].m;
-            #pragma omp atomic
-            particles[i].a[1] += Fy / particles[i].m;
-            #pragma omp atomic
-            particles[i].a[2] += Fz / particles[i].m;
-            
-            // Противоположная сила на j от i (3-й закон Ньютона)
-            #pragma omp atomic
-            particles[j].a[0] -= Fx / particles[j].m;
-            #pragma omp atomic
-            particles[j].a[1] -= Fy / particles[j].m;
-            #pragma omp atomic
-            particles[j].a[2] -= Fz / particles[j].m;
+            axi += F * dx / mi;
+            ayi += F * dy / mi;
+            azi += F * dz / mi;
         }
+
+        p->ax[i] = axi;
+        p->ay[i] = ayi;
+        p->az[i] = azi;
     }
 }
 
-void euler_step(Particle* particles, int n, double dt) {
-    #pragma omp parallel for
+void calculate_forces(Particles* p, ForceWorkspace* ws) {
+    switch (ws->mode) {
+    case FORCES_PRIVATE:
+        forces_private(p, ws);
+        break;
+    case FORCES_FULL:
+        forces_full(p);
+        break;
+    case FORCES_BH:
+        bh_compute_accelerations(ws->tree, p->n, G, SOFTENING, ws->theta,
+                                 p->m, p->x, p->y, p->z, p->ax, p->ay, p->az);
+        break;
+#ifdef USE_MPI
+    case FORCES_RING:
+        ring_compute_accelerations(ws->ring, G, SOFTENING,
+                                   p->m, p->x, p->y, p->z, p->ax, p->ay, p->az);
+        break;
+#endif
+    default:
+        forces_atomic(p, ws);
+        break;
+    }
+}
+
+void euler_step(Particles* p, double dt) {
+    int n = p->n;
+
+    #pragma omp parallel for simd
     for (int i = 0; i < n; i++) {
-        double vx_old = particles[i].v[0];
-        double vy_old = particles[i].v[1];
-        double vz_old = particles[i].v[2];
+        double vx_old = p->vx[i];
+        double vy_old = p->vy[i];
+        double vz_old = p->vz[i];
 
-        particles[i].v[0] += particles[i].a[0] * dt;
-        particles[i].v[1] += particles[i].a[1] * dt;
-        particles[i].v[2] += particles[i].a[2] * dt;
+        p->vx[i] += p->ax[i] * dt;
+        p->vy[i] += p->ay[i] * dt;
+        p->vz[i] += p->az[i] * dt;
 
-        particles[i].r[0] += vx_old * dt;
-        particles[i].r[1] += vy_old * dt;
-        particles[i].r[2] += vz_old * dt;
+        p->x[i] += vx_old * dt;
+        p->y[i] += vy_old * dt;
+        p->z[i] += vz_old * dt;
     }
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <t_end> <input_file>\n", argv[0]);
-        return 1;
+// Интеграторы:
+//   INTEGRATOR_EULER    - явный Эйлер (одно вычисление сил на шаг, первый порядок)
+//   INTEGRATOR_LEAPFROG - симплектическая схема kick-drift-kick (Velocity Verlet):
+//                         ускорения конца шага переиспользуются в начале следующего,
+//                         поэтому тоже одно вычисление сил на шаг, но второй порядок
+//   INTEGRATOR_RK4      - классический Рунге–Кутта 4-го порядка (четыре вычисления сил)
+//   INTEGRATOR_BLOCK    - leapfrog с индивидуальными блочными шагами dt / 2^k
+typedef enum {
+    INTEGRATOR_EULER,
+    INTEGRATOR_LEAPFROG,
+    INTEGRATOR_RK4,
+    INTEGRATOR_BLOCK
+} IntegratorKind;
+
+static const char* integrator_names[] = { "euler", "leapfrog", "rk4", "block" };
+
+#define MAX_BLOCK_LEVELS 30
+
+typedef struct {
+    IntegratorKind kind;
+    int have_accel;     // leapfrog: в p->a уже лежат ускорения текущего момента
+    Particles stage;    // rk4: положения и скорости промежуточной стадии
+    double* sum_x;      // rk4: накопленные k1 + 2 k2 + 2 k3 для положений
+    double* sum_y;
+    double* sum_z;
+    double* sum_vx;     // и для скоростей
+    double* sum_vy;
+    double* sum_vz;
+    double eta;             // block: точность критерия шага
+    int max_level;          // block: самый мелкий шаг dt / 2^max_level
+    int* level;             // block: уровень шага каждого тела
+    int* active;            // block: номера тел, завершающих шаг в текущий момент
+    double* step_estimate;  // block: оценка допустимого шага по критерию
+    long level_count[MAX_BLOCK_LEVELS + 1];
+    int finest_used;        // block: самый мелкий использованный уровень
+    long force_evals;       // block: число вычислений ускорения одного тела
+    long blocks;            // block: число пройденных блоков dt
+} Integrator;
+
+void integrator_free(Integrator* in) {
+    if (in->kind == INTEGRATOR_RK4) {
+        particles_free(&in->stage);
     }
-    double start_time, end_time;
-    double t_end = atof(argv[1]);
-    char* input_file = argv[2];
-    
-    FILE* fin = fopen(input_file, "r");
-    if (!fin) {
-        fprintf(stderr, "Cant open input file: %s\n", input_file);
-        return 1;
+    free(in->sum_x);
+    free(in->sum_y);
+    free(in->sum_z);
+    free(in->sum_vx);
+    free(in->sum_vy);
+    free(in->sum_vz);
+    free(in->level);
+    free(in->active);
+    free(in->step_estimate);
+}
+
+int integrator_init(Integrator* in, IntegratorKind kind, const Particles* p, double eta, int max_level) {
+    memset(in, 0, sizeof(*in));
+    in->kind = kind;
+    if (kind == INTEGRATOR_BLOCK) {
+        in->eta = eta;
+        in->max_level = max_level;
+        in->level = (int*)malloc((p->n > 0 ? p->n : 1) * sizeof(int));
+        in->active = (int*)malloc((p->n > 0 ? p->n : 1) * sizeof(int));
+        in->step_estimate = alloc_array(p->n);
+        if (!in->level || !in->active || !in->step_estimate) {
+            integrator_free(in);
+            return -1;
+        }
+        return 0;
     }
-    
-    int n;
-    if (fscanf(fin, "%d", &n) != 1) {
-        fprintf(stderr, "Error reading number of particles\n");
-        fclose(fin);
-        return 1;
+    if (kind != INTEGRATOR_RK4) {
+        return 0;
     }
-    
-    Particle* particles = (Particle*)malloc(n * sizeof(Particle));
-    
+
+    int n = p->n;
+    if (particles_alloc(&in->stage, n) != 0) {
+        return -1;
+    }
+    memcpy(in->stage.m, p->m, n * sizeof(double));
+
+    in->sum_x = alloc_array(n);
+    in->sum_y = alloc_array(n);
+    in->sum_z = alloc_array(n);
+    in->sum_vx = alloc_array(n);
+    in->sum_vy = alloc_array(n);
+    in->sum_vz = alloc_array(n);
+    if (!in->sum_x || !in->sum_y || !in->sum_z || !in->sum_vx || !in->sum_vy || !in->sum_vz) {
+        integrator_free(in);
+        return -1;
+    }
+    return 0;
+}
+
+// Leapfrog: полшага скорости и полный шаг положения одним проходом,
+// затем силы в новых положениях и второй полшаг скорости
+static void leapfrog_step(Particles* p, Integrator* in, ForceWorkspace* ws, double dt) {
+    int n = p->n;
+    double half_dt = 0.5 * dt;
+
+    if (!in->have_accel) {
+        calculate_forces(p, ws);
+        in->have_accel = 1;
+    }
+
+    #pragma omp parallel for simd
     for (int i = 0; i < n; i++) {
-        if (fscanf(fin, "%lf", &particles[i].m) != 1) {
-            fprintf(stderr, "Error reading mass for particle %d\n", i+1);
-            fclose(fin);
-            free(particles);
-            return 1;
+        p->vx[i] += p->ax[i] * half_dt;
+        p->vy[i] += p->ay[i] * half_dt;
+        p->vz[i] += p->az[i] * half_dt;
+
+        p->x[i] += p->vx[i] * dt;
+        p->y[i] += p->vy[i] * dt;
+        p->z[i] += p->vz[i] * dt;
+    }
+
+    calculate_forces(p, ws);
+
+    #pragma omp parallel for simd
+    for (int i = 0; i < n; i++) {
+        p->vx[i] += p->ax[i] * half_dt;
+        p->vy[i] += p->ay[i] * half_dt;
+        p->vz[i] += p->az[i] * half_dt;
+    }
+}
+
+// RK4: накопление суммы стадий и подготовка следующей стадии делаются одним проходом
+// по частицам; w - вес стадии в сумме, c - доля шага до следующей стадии
+static void rk4_accumulate(Particles* p, Integrator* in, const Particles* k, double w, double c, int first) {
+    int n = p->n;
+    Particles* s = &in->stage;
+
+    #pragma omp parallel for simd
+    for (int i = 0; i < n; i++) {
+        double vx = k->vx[i], vy = k->vy[i], vz = k->vz[i];
+        double ax = k->ax[i], ay = k->ay[i], az = k->az[i];
+
+        if (first) {
+            in->sum_x[i] = vx;
+            in->sum_y[i] = vy;
+            in->sum_z[i] = vz;
+            in->sum_vx[i] = ax;
+            in->sum_vy[i] = ay;
+            in->sum_vz[i] = az;
+        } else {
+            in->sum_x[i] += w * vx;
+            in->sum_y[i] += w * vy;
+            in->sum_z[i] += w * vz;
+            in->sum_vx[i] += w * ax;
+            in->sum_vy[i] += w * ay;
+            in->sum_vz[i] += w * az;
         }
-        
-        for (int d = 0; d < DIM; d++) {
-            if (fscanf(fin, "%lf", &particles[i].r[d]) != 1) {
-                fprintf(stderr, "Error reading position for particle %d\n", i+1);
-                fclose(fin);
-                free(particles);
-                return 1;
+
+        s->x[i] = p->x[i] + c * vx;
+        s->y[i] = p->y[i] + c * vy;
+        s->z[i] = p->z[i] + c * vz;
+        s->vx[i] = p->vx[i] + c * ax;
+        s->vy[i] = p->vy[i] + c * ay;
+        s->vz[i] = p->vz[i] + c * az;
+    }
+}
+
+static void rk4_step(Particles* p, Integrator* in, ForceWorkspace* ws, double dt) {
+    int n = p->n;
+    Particles* s = &in->stage;
+
+    calculate_forces(p, ws);
+    rk4_accumulate(p, in, p, 1.0, 0.5 * dt, 1);
+
+    calculate_forces(s, ws);
+    rk4_accumulate(p, in, s, 2.0, 0.5 * dt, 0);
+
+    calculate_forces(s, ws);
+    rk4_accumulate(p, in, s, 2.0, dt, 0);
+
+    calculate_forces(s, ws);
+
+    double w = dt / 6.0;
+    #pragma omp parallel for simd
+    for (int i = 0; i < n; i++) {
+        p->x[i] += w * (in->sum_x[i] + s->vx[i]);
+        p->y[i] += w * (in->sum_y[i] + s->vy[i]);
+        p->z[i] += w * (in->sum_z[i] + s->vz[i]);
+        p->vx[i] += w * (in->sum_vx[i] + s->ax[i]);
+        p->vy[i] += w * (in->sum_vy[i] + s->ay[i]);
+        p->vz[i] += w * (in->sum_vz[i] + s->az[i]);
+    }
+}
+
+// Индивидуальные блочные шаги (INTEGRATOR_BLOCK): тело уровня L движется с шагом dt / 2^L,
+// уровень выбирается по критерию dt_i = eta * sqrt(|a| / |da/dt|). Время внутри блока dt
+// отсчитывается в тиках dt / 2^max_level. Схема kick-drift-kick: в момент своего шага тело
+// получает закрывающий полшаг скорости со старым шагом и открывающий с новым, в промежутках
+// все тела только дрейфуют, а силы (вместе с производной ускорения) считаются только
+// для активных тел. Укрупнять шаг можно лишь в момент, кратный новому шагу,
+// поэтому в конце каждого блока все тела синхронизированы.
+static void block_forces(Particles* p, Integrator* in, int nactive) {
+    int n = p->n;
+    const double* restrict m = p->m;
+    const double* restrict x = p->x;
+    const double* restrict y = p->y;
+    const double* restrict z = p->z;
+    const double* restrict vx = p->vx;
+    const double* restrict vy = p->vy;
+    const double* restrict vz = p->vz;
+
+    #pragma omp parallel for schedule(dynamic, TRIANGLE_CHUNK)
+    for (int k = 0; k < nactive; k++) {
+        int i = in->active[k];
+        double xi = x[i], yi = y[i], zi = z[i], mi = m[i];
+        double vxi = vx[i], vyi = vy[i], vzi = vz[i];
+        double axi = 0.0, ayi = 0.0, azi = 0.0;
+        double jxi = 0.0, jyi = 0.0, jzi = 0.0;
+
+        #pragma omp simd reduction(+: axi, ayi, azi, jxi, jyi, jzi)
+        for (int j = 0; j < n; j++) {
+            double dx = x[j] - xi;
+            double dy = y[j] - yi;
+            double dz = z[j] - zi;
+            double dvx = vx[j] - vxi;
+            double dvy = vy[j] - vyi;
+            double dvz = vz[j] - vzi;
+
+            double r2 = dx*dx + dy*dy + dz*dz;
+            double r = sqrt(r2);
+            double r3 = r * r * r;
+            double F = G * mi * m[j] / (r3 + SOFTENING) / mi;
+            double rv = r2 > 0.0 ? 3.0 * (dx*dvx + dy*dvy + dz*dvz) / r2 : 0.0;
+
+            axi += F * dx;
+            ayi += F * dy;
+            azi += F * dz;
+            jxi += F * (dvx - rv * dx);
+            jyi += F * (dvy - rv * dy);
+            jzi += F * (dvz - rv * dz);
+        }
+
+        p->ax[i] = axi;
+        p->ay[i] = ayi;
+        p->az[i] = azi;
+
+        double a = sqrt(axi*axi + ayi*ayi + azi*azi);
+        double jerk = sqrt(jxi*jxi + jyi*jyi + jzi*jzi);
+        in->step_estimate[i] = jerk > 0.0 ? in->eta * a / jerk : HUGE_VAL;
+    }
+}
+
+// Уровень по оценке шага; крупнее текущего можно стать, только если tick кратен новому шагу
+static int block_choose_level(const Integrator* in, double dt, double estimate, int old_level, long tick) {
+    int level = 0;
+    while (level < in->max_level && dt / (double)(1L << level) > estimate) {
+        level++;
+    }
+    while (level < old_level && tick % (1L << (in->max_level - level)) != 0) {
+        level++;
+    }
+    return level;
+}
+
+static void block_kick(Particles* p, int i, double dt) {
+    p->vx[i] += p->ax[i] * dt;
+    p->vy[i] += p->ay[i] * dt;
+    p->vz[i] += p->az[i] * dt;
+}
+
+static void block_step(Particles* p, Integrator* in, double dt) {
+    int n = p->n;
+    long ticks_per_block = 1L << in->max_level;
+    double dtick = dt / (double)ticks_per_block;
+
+    if (!in->have_accel) {
+        for (int i = 0; i < n; i++) {
+            in->active[i] = i;
+        }
+        block_forces(p, in, n);
+        in->force_evals += n;
+        memset(in->level_count, 0, sizeof(in->level_count));
+        for (int i = 0; i < n; i++) {
+            in->level[i] = block_choose_level(in, dt, in->step_estimate[i], in->max_level, 0);
+            in->level_count[in->level[i]]++;
+            block_kick(p, i, 0.5 * dt / (double)(1L << in->level[i]));
+        }
+        in->have_accel = 1;
+    }
+
+    long tick = 0;
+    while (tick < ticks_per_block) {
+        // Следующий момент, когда хотя бы одно тело завершает шаг
+        int finest = 0;
+        for (int level = 0; level <= in->max_level; level++) {
+            if (in->level_count[level] > 0) {
+                finest = level;
             }
         }
-        
-        for (int d = 0; d < DIM; d++) {
-            if (fscanf(fin, "%lf", &particles[i].v[d]) != 1) {
-                fprintf(stderr, "Error reading velocity for particle %d\n", i+1);
-                fclose(fin);
-                free(particles);
-                return 1;
+        long step_ticks = 1L << (in->max_level - finest);
+        long next = (tick / step_ticks + 1) * step_ticks;
+        double drift = (double)(next - tick) * dtick;
+        tick = next;
+
+        if (finest > in->finest_used) {
+            in->finest_used = finest;
+        }
+
+        #pragma omp parallel for simd
+        for (int i = 0; i < n; i++) {
+            p->x[i] += p->vx[i] * drift;
+            p->y[i] += p->vy[i] * drift;
+            p->z[i] += p->vz[i] * drift;
+        }
+
+        int nactive = 0;
+        for (int i = 0; i < n; i++) {
+            if (tick % (1L << (in->max_level - in->level[i])) == 0) {
+                in->active[nactive++] = i;
             }
         }
+
+        block_forces(p, in, nactive);
+        in->force_evals += nactive;
+
+        for (int k = 0; k < nactive; k++) {
+            int i = in->active[k];
+            int old_level = in->level[i];
+            int new_level = block_choose_level(in, dt, in->step_estimate[i], old_level, tick);
+
+            block_kick(p, i, 0.5 * dt / (double)(1L << old_level));
+            block_kick(p, i, 0.5 * dt / (double)(1L << new_level));
+
+            in->level_count[old_level]--;
+            in->level_count[new_level]++;
+            in->level[i] = new_level;
+        }
     }
-    fclose(fin);
-    
-    double dt = 0.01;
-    printf("N-body simulation with OpenMP\n");
-    printf("Number of particles: %d\n", n);
-    printf("Simulation time: 0 to %.2f\n", t_end);
-    printf("Time step: %.6f\n", dt);
-    printf("Number of steps: %.0f\n", t_end/dt);
-    
-    FILE* fout = fopen("trajectories.csv", "w");
-    if (!fout) {
-        fprintf(stderr, "Cant create output file\n");
-        free(particles);
-        return 1;
+
+    in->blocks++;
+}
+
+void integrate_step(Particles* p, Integrator* in, ForceWorkspace* ws, double dt) {
+    switch (in->kind) {
+    case INTEGRATOR_LEAPFROG:
+        leapfrog_step(p, in, ws, dt);
+        break;
+    case INTEGRATOR_RK4:
+        rk4_step(p, in, ws, dt);
+        break;
+    case INTEGRATOR_BLOCK:
+        block_step(p, in, dt);
+        break;
+    default:
+        calculate_forces(p, ws);
+        euler_step(p, dt);
+        break;
     }
-    
+}
+
+// Полная энергия системы: кинетическая плюс потенциальная -G m_i m_j / r_ij по всем парам
+double total_energy(const Particles* p) {
+    int n = p->n;
+    double kinetic = 0.0, potential = 0.0;
+
+    #pragma omp parallel for schedule(dynamic, TRIANGLE_CHUNK) reduction(+: kinetic, potential)
+    for (int i = 0; i < n; i++) {
+        kinetic += 0.5 * p->m[i] * (p->vx[i]*p->vx[i] + p->vy[i]*p->vy[i] + p->vz[i]*p->vz[i]);
+
+        double row = 0.0;
+        #pragma omp simd reduction(+: row)
+        for (int j = i + 1; j < n; j++) {
+            double dx = p->x[j] - p->x[i];
+            double dy = p->y[j] - p->y[i];
+            double dz = p->z[j] - p->z[i];
+            row += p->m[j] / sqrt(dx*dx + dy*dy + dz*dz);
+        }
+        potential -= G * p->m[i] * row;
+    }
+
+    return kinetic + potential;
+}
+
+// Энергия с учётом схемы интегрирования: при блочных шагах скорости опережают
+// положения на полшага своего уровня, поэтому для оценки они синхронизируются
+double integrator_energy(const Particles* p, const Integrator* in, double dt) {
+    if (in->kind != INTEGRATOR_BLOCK || !in->have_accel) {
+        return total_energy(p);
+    }
+
+    Particles synced = *p;
+    synced.vx = alloc_array(p->n);
+    synced.vy = alloc_array(p->n);
+    synced.vz = alloc_array(p->n);
+    if (!synced.vx || !synced.vy || !synced.vz) {
+        free(synced.vx);
+        free(synced.vy);
+        free(synced.vz);
+        return total_energy(p);
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < p->n; i++) {
+        double half = 0.5 * dt / (double)(1L << in->level[i]);
+        synced.vx[i] = p->vx[i] - p->ax[i] * half;
+        synced.vy[i] = p->vy[i] - p->ay[i] * half;
+        synced.vz[i] = p->vz[i] - p->az[i] * half;
+    }
+
+    double energy = total_energy(&synced);
+    free(synced.vx);
+    free(synced.vy);
+    free(synced.vz);
+    return energy;
+}
+
+// Проверка точности Barnes–Hut: ускорения при разных theta сравниваются с прямым
+// расчётом N^2 (FORCES_FULL) по относительной ошибке |a_bh - a| / |a| каждого тела
+int bh_accuracy_check(Particles* p) {
+    static const double thetas[] = { 0.1, 0.2, 0.3, 0.5, 0.7, 1.0 };
+    int n = p->n;
+    double* ref_x = alloc_array(n);
+    double* ref_y = alloc_array(n);
+    double* ref_z = alloc_array(n);
+    BHTree* tree = bh_create(n);
+    if (!ref_x || !ref_y || !ref_z || !tree) {
+        fprintf(stderr, "Cant allocate memory for accuracy check\n");
+        free(ref_x);
+        free(ref_y);
+        free(ref_z);
+        bh_destroy(tree);
+        return -1;
+    }
+
+    double start = omp_get_wtime();
+    forces_full(p);
+    double direct_time = omp_get_wtime() - start;
+    memcpy(ref_x, p->ax, n * sizeof(double));
+    memcpy(ref_y, p->ay, n * sizeof(double));
+    memcpy(ref_z, p->az, n * sizeof(double));
+
+    printf("Barnes-Hut accuracy check, %d bodies, direct N^2: %.4f s\n", n, direct_time);
+    printf("%-8s | %-10s | %-14s | %-14s\n", "theta", "time(s)", "rms rel err", "max rel err");
+    printf("---------|------------|----------------|---------------\n");
+
+    for (size_t k = 0; k < sizeof(thetas) / sizeof(thetas[0]); k++) {
+        start = omp_get_wtime();
+        bh_compute_accelerations(tree, n, G, SOFTENING, thetas[k], p->m, p->x, p->y, p->z, p->ax, p->ay, p->az);
+        double bh_time = omp_get_wtime() - start;
+
+        double sum_sq = 0.0, max_err = 0.0;
+        #pragma omp parallel for reduction(+: sum_sq) reduction(max: max_err)
+        for (int i = 0; i < n; i++) {
+            double ex = p->ax[i] - ref_x[i];
+            double ey = p->ay[i] - ref_y[i];
+            double ez = p->az[i] - ref_z[i];
+            double norm = sqrt(ref_x[i]*ref_x[i] + ref_y[i]*ref_y[i] + ref_z[i]*ref_z[i]);
+            double err = norm > 0.0 ? sqrt(ex*ex + ey*ey + ez*ez) / norm : 0.0;
+            sum_sq += err * err;
+            max_err = fmax(max_err, err);
+        }
+
+        printf("%-8.2f | %-10.4f | %-14.3e | %-14.3e\n", thetas[k], bh_time, sqrt(sum_sq / (n > 0 ? n : 1)), max_err);
+    }
+
+    free(ref_x);
+    free(ref_y);
+    free(ref_z);
+    bh_destroy(tree);
+    return 0;
+}
+
+// Текстовый input.txt разбирается параллельно через mmap, двоичный (--save-input) копируется как есть
+int load_particles(const char* input_file, Particles* p, const char* save_input) {
+    int n;
+    InputFile* in = input_open(input_file, &n);
+    if (!in) {
+        return -1;
+    }
+
+    if (particles_alloc(p, n) != 0) {
+        fprintf(stderr, "Cant allocate memory for %d particles\n", n);
+        input_close(in);
+        return -1;
+    }
+
+    double* const columns[INPUT_COLUMNS] = { p->m, p->x, p->y, p->z, p->vx, p->vy, p->vz };
+    int rc = input_read(in, columns);
+    input_close(in);
+    if (rc != 0) {
+        particles_free(p);
+        return -1;
+    }
+
+    if (save_input && input_save_binary(save_input, n, (const double* const*)columns) != 0) {
+        particles_free(p);
+        return -1;
+    }
+    return 0;
+}
+
+void write_header(FILE* fout, int n) {
     fprintf(fout, "t");
     for (int i = 0; i < n; i++) {
         fprintf(fout, ",x%d,y%d,z%d", i+1, i+1, i+1);
     }
     fprintf(fout, "\n");
-    fprintf(fout, "0.000000");
-    for (int i = 0; i < n; i++) {
-        fprintf(fout, ",%.6f,%.6f,%.6f", particles[i].r[0], particles[i].r[1],particles[i].r[2]);
+}
+
+void write_snapshot(FILE* fout, double t, const Particles* p) {
+    fprintf(fout, "%.6f", t);
+    for (int i = 0; i < p->n; i++) {
+        fprintf(fout, ",%.6f,%.6f,%.6f", p->x[i], p->y[i], p->z[i]);
     }
     fprintf(fout, "\n");
+}
+
+// Вывод траекторий: по умолчанию бинарные кадры trajectories.bin (trajectory.h, в CSV
+// переводит traj2csv), текстовый trajectories.csv включается --output=csv для небольших N
+typedef struct {
+    FILE* csv;
+    TrajWriter* bin;
+    const char* path;
+} TrajectoryOutput;
+
+// offset > 0 - продолжение после рестарта: файл обрезается до длины на момент контрольной точки
+int output_open(TrajectoryOutput* out, int csv, int n, int stride, uint32_t flags, uint64_t offset) {
+    memset(out, 0, sizeof(*out));
+    if (csv) {
+        out->path = "trajectories.csv";
+        out->csv = fopen(out->path, offset > 0 ? "r+" : "w");
+        if (!out->csv) {
+            return -1;
+        }
+        if (offset == 0) {
+            write_header(out->csv, n);
+            return 0;
+        }
+        // Длина проверяется до ftruncate: короткий файл он дополнил бы нулями
+        if (fseek(out->csv, 0, SEEK_END) != 0 || (uint64_t)ftell(out->csv) < offset ||
+            ftruncate(fileno(out->csv), (off_t)offset) != 0 || fseek(out->csv, 0, SEEK_END) != 0) {
+            fprintf(stderr, "Trajectory file %s is shorter than the checkpoint expects\n", out->path);
+            fclose(out->csv);
+            out->csv = NULL;
+            return -1;
+        }
+        return 0;
+    }
+    out->path = "trajectories.bin";
+    out->bin = offset > 0 ? traj_reopen(out->path, n, stride, flags, offset)
+                          : traj_create(out->path, n, stride, flags);
+    return out->bin ? 0 : -1;
+}
+
+// Длина уже записанной части траектории
+uint64_t output_offset(TrajectoryOutput* out) {
+    if (out->csv) {
+        fflush(out->csv);
+        return (uint64_t)ftell(out->csv);
+    }
+    return traj_offset(out->bin);
+}
+
+void output_snapshot(TrajectoryOutput* out, double t, const Particles* p) {
+    if (out->csv) {
+        write_snapshot(out->csv, t, p);
+    } else if (traj_write_frame(out->bin, t, p->x, p->y, p->z) != 0) {
+        fprintf(stderr, "Cant write trajectory frame at t = %.6f\n", t);
+    }
+}
+
+void output_close(TrajectoryOutput* out) {
+    if (out->csv) {
+        fclose(out->csv);
+    }
+    traj_close(out->bin);
+}
+
+// Контрольная точка: заголовок и полное состояние - m, r, v, a всех тел, а для блочных
+// шагов ещё уровни тел. Вместе с ней запоминается длина файла траекторий, поэтому
+// после --restart расчёт и вывод продолжаются бит в бит, как будто остановки не было
+#define CHECKPOINT_MAGIC "NCHK"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_ARRAYS 10
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t n;
+    int32_t integrator;
+    int32_t force_mode;
+    int32_t max_level;
+    int32_t have_accel;
+    int32_t finest_used;
+    int64_t step;
+    int64_t force_evals;
+    int64_t blocks;
+    uint64_t output_offset;
+    double t;
+    double dt;
+    double energy0;
+    double max_drift;
+    double theta;       // FORCES_BH: угол раскрытия узлов
+    double eta;         // INTEGRATOR_BLOCK: точность критерия шага
+    int64_t level_count[MAX_BLOCK_LEVELS + 1];
+} CheckpointHeader;
+
+static size_t checkpoint_size(int n, int integrator) {
+    size_t bytes = sizeof(CheckpointHeader) + CHECKPOINT_ARRAYS * (size_t)n * sizeof(double);
+    if (integrator == INTEGRATOR_BLOCK) {
+        bytes += (size_t)n * sizeof(int32_t);
+    }
+    return bytes;
+}
+
+// Копирует состояние в буфер писателя; на диск его выводит поток писателя
+int save_checkpoint(CheckpointWriter* w, CheckpointHeader* h, const Particles* p, const Integrator* in) {
+    memcpy(h->magic, CHECKPOINT_MAGIC, 4);
+    h->version = CHECKPOINT_VERSION;
+    h->n = p->n;
+    h->integrator = in->kind;
+    h->max_level = in->max_level;
+    h->eta = in->eta;
+    h->have_accel = in->have_accel;
+    h->finest_used = in->finest_used;
+    h->force_evals = in->force_evals;
+    h->blocks = in->blocks;
+    for (int level = 0; level <= MAX_BLOCK_LEVELS; level++) {
+        h->level_count[level] = in->level_count[level];
+    }
+
+    size_t bytes = checkpoint_size(p->n, in->kind);
+    char* buffer = (char*)checkpoint_buffer(w, bytes);
+    if (!buffer) {
+        return -1;
+    }
+    memcpy(buffer, h, sizeof(*h));
+    const double* arrays[CHECKPOINT_ARRAYS] = { p->m, p->x, p->y, p->z, p->vx, p->vy, p->vz, p->ax, p->ay, p->az };
+    size_t array_bytes = (size_t)p->n * sizeof(double);
+    char* pos = buffer + sizeof(*h);
+    for (int a = 0; a < CHECKPOINT_ARRAYS; a++) {
+        memcpy(pos, arrays[a], array_bytes);
+        pos += array_bytes;
+    }
+    if (in->kind == INTEGRATOR_BLOCK) {
+        memcpy(pos, in->level, (size_t)p->n * sizeof(int32_t));
+    }
+    checkpoint_submit(w, bytes);
+    return 0;
+}
+
+// Состояние тел из точки; уровни блочных шагов возвращаются отдельным массивом,
+// так как интегратор создаётся позже
+int load_checkpoint(const char* path, CheckpointHeader* h, Particles* p, int** levels) {
+    size_t bytes;
+    char* buffer = (char*)checkpoint_read(path, &bytes);
+    if (!buffer) {
+        return -1;
+    }
+    if (bytes >= sizeof(*h)) {
+        memcpy(h, buffer, sizeof(*h));
+    }
+    // Номера схемы и стратегии потом индексируют таблицы имён, поэтому проверяются здесь
+    if (bytes < sizeof(*h) || memcmp(h->magic, CHECKPOINT_MAGIC, 4) != 0 || h->version != CHECKPOINT_VERSION ||
+        h->n < 0 || h->integrator < INTEGRATOR_EULER || h->integrator > INTEGRATOR_BLOCK ||
+        h->force_mode < FORCES_ATOMIC || h->force_mode > FORCES_RING ||
+        h->max_level < 0 || h->max_level > MAX_BLOCK_LEVELS || bytes != checkpoint_size(h->n, h->integrator)) {
+        fprintf(stderr, "Not a checkpoint (or unsupported version): %s\n", path);
+        free(buffer);
+        return -1;
+    }
+    if (particles_alloc(p, h->n) != 0) {
+        fprintf(stderr, "Cant allocate memory for %d particles\n", h->n);
+        free(buffer);
+        return -1;
+    }
+
+    double* arrays[CHECKPOINT_ARRAYS] = { p->m, p->x, p->y, p->z, p->vx, p->vy, p->vz, p->ax, p->ay, p->az };
+    size_t array_bytes = (size_t)h->n * sizeof(double);
+    const char* pos = buffer + sizeof(*h);
+    for (int a = 0; a < CHECKPOINT_ARRAYS; a++) {
+        memcpy(arrays[a], pos, array_bytes);
+        pos += array_bytes;
+    }
+    *levels = NULL;
+    if (h->integrator == INTEGRATOR_BLOCK) {
+        *levels = (int*)malloc((h->n > 0 ? h->n : 1) * sizeof(int));
+        if (!*levels) {
+            particles_free(p);
+            free(buffer);
+            return -1;
+        }
+        memcpy(*levels, pos, (size_t)h->n * sizeof(int32_t));
+    }
+    free(buffer);
+    return 0;
+}
+
+void restore_integrator(Integrator* in, const CheckpointHeader* h, const int* levels) {
+    in->have_accel = h->have_accel;
+    in->finest_used = h->finest_used;
+    in->force_evals = h->force_evals;
+    in->blocks = h->blocks;
+    for (int level = 0; level <= MAX_BLOCK_LEVELS; level++) {
+        in->level_count[level] = h->level_count[level];
+    }
+    if (in->kind == INTEGRATOR_BLOCK && levels) {
+        memcpy(in->level, levels, (size_t)h->n * sizeof(int));
+    }
+}
+
+#ifdef USE_MPI
+// Распределённый режим: ранг 0 читает входной файл и пишет траектории,
+// каждый ранг хранит и интегрирует только свой непрерывный блок тел
+static int scatter_particles(RingComm* ring, const Particles* global, Particles* local) {
+    if (particles_alloc(local, ring_local_count(ring)) != 0) {
+        return -1;
+    }
+    ring_scatter(ring, global->m, local->m);
+    ring_scatter(ring, global->x, local->x);
+    ring_scatter(ring, global->y, local->y);
+    ring_scatter(ring, global->z, local->z);
+    ring_scatter(ring, global->vx, local->vx);
+    ring_scatter(ring, global->vy, local->vy);
+    ring_scatter(ring, global->vz, local->vz);
+    ring_scatter(ring, global->ax, local->ax);
+    ring_scatter(ring, global->ay, local->ay);
+    ring_scatter(ring, global->az, local->az);
+    return 0;
+}
+
+// Сбор положений на ранг 0 перед выводом; скорости нужны для энергии,
+// скорости и ускорения - для контрольной точки
+static void gather_particles(RingComm* ring, const Particles* local, Particles* global,
+                             int with_velocities, int with_accelerations) {
+    ring_gather(ring, local->x, global->x);
+    ring_gather(ring, local->y, global->y);
+    ring_gather(ring, local->z, global->z);
+    if (with_velocities || with_accelerations) {
+        ring_gather(ring, local->vx, global->vx);
+        ring_gather(ring, local->vy, global->vy);
+        ring_gather(ring, local->vz, global->vz);
+    }
+    if (with_accelerations) {
+        ring_gather(ring, local->ax, global->ax);
+        ring_gather(ring, local->ay, global->ay);
+        ring_gather(ring, local->az, global->az);
+    }
+}
+#endif
+
+static int run(int argc, char* argv[], int rank, int nranks) {
+    if (argc < 3) {
+        if (rank == 0) {
+            fprintf(stderr, "Usage: %s <t_end> <input_file> [--forces=atomic|private|full|bh] [--theta=X] [--bh-check]\n"
+                            "       [--integrator=euler|leapfrog|rk4|block] [--dt=X] [--energy] [--eta=X] [--levels=N]\n"
+                            "       [--output=bin|csv] [--traj-precision=float|double] [--traj-stride=K] [--traj-zlib]\n"
+                            "       [--checkpoint-every=STEPS] [--checkpoint=FILE] [--restart[=FILE]] [--save-input=FILE]\n", argv[0]);
+        }
+        return 1;
+    }
+    double start_time, end_time;
+    double t_end = atof(argv[1]);
+    char* input_file = argv[2];
+#ifdef USE_MPI
+    ForceMode force_mode = FORCES_RING;
+#else
+    ForceMode force_mode = FORCES_ATOMIC;
+#endif
+    double theta = 0.5;
+    int bh_check = 0;
+    IntegratorKind integrator_kind = INTEGRATOR_EULER;
+    double dt = 0.01;
+    int report_energy = 0;
+    double eta = 0.02;
+    int max_level = 10;
+    int output_csv = 0;
+    int traj_stride = 1;
+    uint32_t traj_flags = 0;
+    long checkpoint_every = 0;
+    const char* checkpoint_file = "checkpoint.bin";
+    const char* restart_file = NULL;
+    int restart = 0;
+    const char* save_input = NULL;
+
+    for (int a = 3; a < argc; a++) {
+        if (strcmp(argv[a], "--forces=atomic") == 0) {
+            force_mode = FORCES_ATOMIC;
+        } else if (strcmp(argv[a], "--forces=private") == 0) {
+            force_mode = FORCES_PRIVATE;
+        } else if (strcmp(argv[a], "--forces=full") == 0) {
+            force_mode = FORCES_FULL;
+        } else if (strcmp(argv[a], "--forces=bh") == 0) {
+            force_mode = FORCES_BH;
+#ifdef USE_MPI
+        } else if (strcmp(argv[a], "--forces=ring") == 0) {
+            force_mode = FORCES_RING;
+#endif
+        } else if (strncmp(argv[a], "--theta=", 8) == 0) {
+            theta = atof(argv[a] + 8);
+            if (theta < 0.0) {
+                fprintf(stderr, "Opening angle theta must be non-negative\n");
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bh-check") == 0) {
+            bh_check = 1;
+        } else if (strcmp(argv[a], "--integrator=euler") == 0) {
+            integrator_kind = INTEGRATOR_EULER;
+        } else if (strcmp(argv[a], "--integrator=leapfrog") == 0) {
+            integrator_kind = INTEGRATOR_LEAPFROG;
+        } else if (strcmp(argv[a], "--integrator=rk4") == 0) {
+            integrator_kind = INTEGRATOR_RK4;
+        } else if (strcmp(argv[a], "--integrator=block") == 0) {
+            integrator_kind = INTEGRATOR_BLOCK;
+        } else if (strncmp(argv[a], "--eta=", 6) == 0) {
+            eta = atof(argv[a] + 6);
+            if (eta <= 0.0) {
+                fprintf(stderr, "Timestep accuracy eta must be positive\n");
+                return 1;
+            }
+        } else if (strncmp(argv[a], "--levels=", 9) == 0) {
+            max_level = atoi(argv[a] + 9);
+            if (max_level < 0 || max_level > MAX_BLOCK_LEVELS) {
+                fprintf(stderr, "Number of levels must be between 0 and %d\n", MAX_BLOCK_LEVELS);
+                return 1;
+            }
+        } else if (strncmp(argv[a], "--dt=", 5) == 0) {
+            dt = atof(argv[a] + 5);
+            if (dt <= 0.0) {
+                fprintf(stderr, "Time step must be positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--energy") == 0) {
+            report_energy = 1;
+        } else if (strcmp(argv[a], "--output=bin") == 0) {
+            output_csv = 0;
+        } else if (strcmp(argv[a], "--output=csv") == 0) {
+            output_csv = 1;
+        } else if (strcmp(argv[a], "--traj-precision=float") == 0) {
+            traj_flags &= ~TRAJ_DOUBLE;
+        } else if (strcmp(argv[a], "--traj-precision=double") == 0) {
+            traj_flags |= TRAJ_DOUBLE;
+        } else if (strncmp(argv[a], "--traj-stride=", 14) == 0) {
+            traj_stride = atoi(argv[a] + 14);
+            if (traj_stride < 1) {
+                fprintf(stderr, "Trajectory stride must be positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--traj-zlib") == 0) {
+            traj_flags |= TRAJ_ZLIB;
+        } else if (strncmp(argv[a], "--checkpoint-every=", 19) == 0) {
+            checkpoint_every = atol(argv[a] + 19);
+            if (checkpoint_every < 0) {
+                fprintf(stderr, "Checkpoint interval must be non-negative\n");
+                return 1;
+            }
+        } else if (strncmp(argv[a], "--checkpoint=", 13) == 0) {
+            checkpoint_file = argv[a] + 13;
+        } else if (strcmp(argv[a], "--restart") == 0) {
+            restart = 1;
+        } else if (strncmp(argv[a], "--restart=", 10) == 0) {
+            restart_file = argv[a] + 10;
+        } else if (strncmp(argv[a], "--save-input=", 13) == 0) {
+            save_input = argv[a] + 13;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[a]);
+            return 1;
+        }
+    }
+    // --restart без имени читает файл, заданный --checkpoint (в любом порядке опций)
+    if (restart && !restart_file) {
+        restart_file = checkpoint_file;
+    }
+
+#ifdef USE_MPI
+    // Блочные шаги считают силы только для активных тел, а проверка BH - на одном ранге
+    if (force_mode != FORCES_RING || integrator_kind == INTEGRATOR_BLOCK || bh_check) {
+        if (rank == 0) {
+            fprintf(stderr, "MPI build supports only --forces=ring with euler, leapfrog or rk4\n");
+        }
+        return 1;
+    }
+
+    Particles global;
+    memset(&global, 0, sizeof(global));
+    CheckpointHeader checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    int* levels = NULL;
+    int n = -1;
+    if (rank == 0 && restart_file) {
+        if (load_checkpoint(restart_file, &checkpoint, &global, &levels) == 0) {
+            n = global.n;
+        }
+    } else if (rank == 0 && load_particles(input_file, &global, save_input) == 0) {
+        n = global.n;
+    }
+    MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (n < 0) {
+        return 1;
+    }
+    MPI_Bcast(&checkpoint, sizeof(checkpoint), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    RingComm* ring = ring_create(MPI_COMM_WORLD, n);
+    Particles particles;
+    if (!ring || scatter_particles(ring, &global, &particles) != 0) {
+        fprintf(stderr, "Rank %d: cant allocate memory for its block of particles\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    // Ранг 0 выводит собранное состояние, остальные только отдают свои блоки
+    Particles* output = &global;
+#else
+    // Блочные шаги всегда считают прямую сумму для активных тел, стратегии --forces к ним не относятся
+    if (integrator_kind == INTEGRATOR_BLOCK && force_mode != FORCES_ATOMIC) {
+        fprintf(stderr, "--integrator=block uses direct forces and does not support --forces=%s\n",
+                force_mode_names[force_mode]);
+        return 1;
+    }
+
+    Particles particles;
+    CheckpointHeader checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    int* levels = NULL;
+    if (restart_file ? load_checkpoint(restart_file, &checkpoint, &particles, &levels) != 0
+                     : load_particles(input_file, &particles, save_input) != 0) {
+        return 1;
+    }
+    int n = particles.n;
+    Particles* output = &particles;
+
+    if (bh_check) {
+        int rc = bh_accuracy_check(&particles);
+        particles_free(&particles);
+        return rc == 0 ? 0 : 1;
+    }
+#endif
+
+    // Рестарт продолжает тот же расчёт: схема, силы, шаг и их параметры должны совпадать с исходными
+    if (restart_file && (checkpoint.integrator != (int32_t)integrator_kind || checkpoint.force_mode != (int32_t)force_mode ||
+                         checkpoint.dt != dt || (force_mode == FORCES_BH && checkpoint.theta != theta) ||
+                         (integrator_kind == INTEGRATOR_BLOCK && (checkpoint.max_level != max_level || checkpoint.eta != eta)))) {
+        if (rank == 0) {
+            fprintf(stderr, "Checkpoint was written with --forces=%s --integrator=%s --dt=%.17g",
+                    force_mode_names[checkpoint.force_mode], integrator_names[checkpoint.integrator], checkpoint.dt);
+            if (checkpoint.force_mode == FORCES_BH) {
+                fprintf(stderr, " --theta=%.17g", checkpoint.theta);
+            }
+            if (checkpoint.integrator == INTEGRATOR_BLOCK) {
+                fprintf(stderr, " --levels=%d --eta=%.17g", checkpoint.max_level, checkpoint.eta);
+            }
+            fprintf(stderr, "; pass the same options\n");
+        }
+        free(levels);
+        particles_free(&particles);
+        return 1;
+    }
+
+    ForceWorkspace workspace;
+    Integrator integrator;
+    if (workspace_init(&workspace, force_mode, n, theta) != 0 ||
+        integrator_init(&integrator, integrator_kind, &particles, eta, max_level) != 0) {
+        fprintf(stderr, "Cant allocate force workspace\n");
+        workspace_free(&workspace);
+        particles_free(&particles);
+#ifdef USE_MPI
+        MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+        return 1;
+    }
+#ifdef USE_MPI
+    workspace.ring = ring;
+#endif
     double t = 0.0;
     long step = 0;
+    if (restart_file) {
+        restore_integrator(&integrator, &checkpoint, levels);
+        t = checkpoint.t;
+        step = checkpoint.step;
+    }
+    free(levels);
+
+    TrajectoryOutput output_file;
+    CheckpointWriter* checkpoint_writer = NULL;
+    if (rank == 0) {
+        printf("N-body simulation with OpenMP\n");
+        if (nranks > 1 || force_mode == FORCES_RING) {
+            printf("MPI ranks: %d, OpenMP threads per rank: %d\n", nranks, omp_get_max_threads());
+        }
+        printf("Number of particles: %d\n", n);
+        printf("Simulation time: 0 to %.2f\n", t_end);
+        if (restart_file) {
+            printf("Restarted from %s at t = %.6f (step %ld)\n", restart_file, t, step);
+        }
+        printf("Time step: %.6f\n", dt);
+        printf("Number of steps: %.0f\n", t_end/dt);
+        if (integrator_kind != INTEGRATOR_BLOCK) {
+            printf("Force strategy: %s\n", force_mode_names[force_mode]);
+        }
+        if (force_mode == FORCES_BH) {
+            printf("Opening angle theta: %.3f\n", theta);
+        }
+        printf("Integrator: %s\n", integrator_names[integrator_kind]);
+        if (integrator_kind == INTEGRATOR_BLOCK) {
+            printf("Block timesteps: %d levels (smallest step %.3e), eta = %.4f, direct forces\n",
+                   max_level, dt / (double)(1L << max_level), eta);
+        }
+
+        if (!output_csv) {
+            printf("Trajectory: trajectories.bin (%s, body stride %d%s)\n",
+                   (traj_flags & TRAJ_DOUBLE) ? "double" : "float", traj_stride,
+                   (traj_flags & TRAJ_ZLIB) ? ", zlib" : "");
+        }
+
+        if (checkpoint_every > 0) {
+            printf("Checkpoint every %ld steps to %s\n", checkpoint_every, checkpoint_file);
+            checkpoint_writer = checkpoint_writer_create(checkpoint_file);
+        }
+
+        if (output_open(&output_file, output_csv, n, traj_stride, traj_flags, checkpoint.output_offset) != 0 ||
+            (checkpoint_every > 0 && !checkpoint_writer)) {
+            fprintf(stderr, "Cant create output file\n");
+#ifdef USE_MPI
+            MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+            integrator_free(&integrator);
+            workspace_free(&workspace);
+            particles_free(&particles);
+            return 1;
+        }
+        if (!restart_file) {
+            output_snapshot(&output_file, 0.0, output);
+        }
+    }
+
+    // Дрейф энергии |E(t) - E(0)| / |E(0)| проверяется в моменты вывода:
+    // по нему выбирается наибольший устойчивый шаг для интегратора
+    double energy0 = checkpoint.energy0, max_drift = checkpoint.max_drift;
+    if (report_energy && rank == 0 && !restart_file) {
+        energy0 = integrator_energy(output, &integrator, dt);
+    }
+
+#ifdef USE_MPI
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
     start_time = omp_get_wtime();
 
     while (t < t_end) {
-        calculate_forces(particles, n);
-        euler_step(particles, n, dt);
+        integrate_step(&particles, &integrator, &workspace, dt);
         
         t += dt;
         step++;
         
         if (step % OUTPUT_EVERY == 0) {
-            fprintf(fout, "%.6f", t);
-            for (int i = 0; i < n; i++) {
-                fprintf(fout, ",%.6f,%.6f,%.6f", particles[i].r[0], particles[i].r[1], particles[i].r[2]);
+#ifdef USE_MPI
+            gather_particles(ring, &particles, &global, report_energy, 0);
+#endif
+            if (rank == 0) {
+                output_snapshot(&output_file, t, output);
+                if (report_energy) {
+                    max_drift = fmax(max_drift, fabs((integrator_energy(output, &integrator, dt) - energy0) / energy0));
+                }
+            }
+        }
+
+        // Состояние копируется в буфер писателя, запись на диск идёт параллельно со следующими шагами
+        if (checkpoint_every > 0 && step % checkpoint_every == 0) {
+#ifdef USE_MPI
+            gather_particles(ring, &particles, &global, 1, 1);
+#endif
+            if (rank == 0) {
+                checkpoint.force_mode = force_mode;
+                checkpoint.theta = theta;
+                checkpoint.step = step;
+                checkpoint.t = t;
+                checkpoint.dt = dt;
+                checkpoint.energy0 = energy0;
+                checkpoint.max_drift = max_drift;
+                checkpoint.output_offset = output_offset(&output_file);
+                if (save_checkpoint(checkpoint_writer, &checkpoint, output, &integrator) != 0) {
+                    fprintf(stderr, "Cant allocate checkpoint buffer at step %ld\n", step);
+                }
             }
-            fprintf(fout, "\n");
         }
     }
     
+#ifdef USE_MPI
+    MPI_Barrier(MPI_COMM_WORLD);
+    gather_particles(ring, &particles, &global, report_energy, 0);
+#endif
     end_time = omp_get_wtime();
-    printf("Total simulation time: %.2f seconds\n", end_time - start_time);
-    if ((step-1) % OUTPUT_EVERY != 0) {
-        fprintf(fout, "%.6f", t);
-        for (int i = 0; i < n; i++) {
-            fprintf(fout, ",%.6f,%.6f,%.6f", particles[i].r[0], particles[i].r[1],particles[i].r[2]);
+    if (rank == 0) {
+        printf("Total simulation time: %.4f seconds\n", end_time - start_time);
+        if (report_energy) {
+            double drift = fabs((integrator_energy(output, &integrator, dt) - energy0) / energy0);
+            max_drift = fmax(max_drift, drift);
+            printf("Initial energy: %.10e J\n", energy0);
+            printf("Final energy drift: %.3e, max drift at outputs: %.3e\n", drift, max_drift);
+        }
+        if ((step-1) % OUTPUT_EVERY != 0) {
+            output_snapshot(&output_file, t, output);
+        }
+        output_close(&output_file);
+        if (checkpoint_writer_destroy(checkpoint_writer) != 0) {
+            fprintf(stderr, "Some checkpoints were not written\n");
         }
-        fprintf(fout, "\n");
     }
     
-    fclose(fout);
-    free(particles);
+    integrator_free(&integrator);
+    workspace_free(&workspace);
+    particles_free(&particles);
+#ifdef USE_MPI
+    ring_destroy(ring);
+    particles_free(&global);
+#endif
     
-    printf("Simulation completed. Results saved to trajectories.csv\n");
-    printf("Total steps: %ld\n", step);
+    if (rank == 0) {
+        printf("Simulation completed. Results saved to %s\n", output_file.path);
+        printf("Total steps: %ld\n", step);
+        if (integrator_kind == INTEGRATOR_BLOCK && integrator.blocks > 0) {
+            // Для сравнения: общий для всех шаг, равный самому мелкому использованному
+            double shared = (double)n * integrator.blocks * (double)(1L << integrator.finest_used);
+            printf("Force evaluations: %ld (%.1f%% of a shared step dt / 2^%d)\n",
+                   integrator.force_evals, 100.0 * integrator.force_evals / shared, integrator.finest_used);
+        }
+    }
     return 0;
+}
+
+int main(int argc, char* argv[]) {
+#ifdef USE_MPI
+    // Вызовы MPI делает только главный поток, вне параллельных областей OpenMP
+    int provided, rank, nranks;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+    int rc = run(argc, argv, rank, nranks);
+    MPI_Finalize();
+    return rc;
+#else
+    return run(argc, argv, 0, 1);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trajectory.h"
+
+// Преобразование trajectories.bin обратно в CSV того же вида, что пишет --output=csv:
+// столбцы называются по исходным номерам тел, поэтому прореживание видно в заголовке
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trajectories.bin> [output.csv] [--info]\n", argv[0]);
+        return 1;
+    }
+    const char* input_file = argv[1];
+    const char* output_file = NULL;
+    int info = 0;
+    for (int a = 2; a < argc; a++) {
+        if (strcmp(argv[a], "--info") == 0) {
+            info = 1;
+        } else if (argv[a][0] == '-' && argv[a][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[a]);
+            return 1;
+        } else {
+            output_file = argv[a];
+        }
+    }
+
+    TrajReader* r = traj_open(input_file);
+    if (!r) {
+        return 1;
+    }
+    const TrajHeader* h = traj_header(r);
+    size_t stored = (size_t)h->stored;
+    double* xyz = (double*)malloc((stored ? stored : 1) * 3 * sizeof(double));
+    if (!xyz) {
+        fprintf(stderr, "Cant allocate memory for %zu bodies\n", stored);
+        traj_close_reader(r);
+        return 1;
+    }
+
+    double t;
+    int rc;
+    if (info) {
+        long frames = 0;
+        double first = 0.0, last = 0.0;
+        while ((rc = traj_read_frame(r, &t, xyz)) == 1) {
+            if (frames == 0) {
+                first = t;
+            }
+            last = t;
+            frames++;
+        }
+        printf("Bodies: %llu, stored: %llu (every %u)\n",
+               (unsigned long long)h->n, (unsigned long long)h->stored, h->stride);
+        printf("Precision: %s, compression: %s\n",
+               (h->flags & TRAJ_DOUBLE) ? "double" : "float", (h->flags & TRAJ_ZLIB) ? "zlib" : "none");
+        printf("Frames: %ld, t = %.6f .. %.6f\n", frames, first, last);
+    } else {
+        FILE* fout = output_file ? fopen(output_file, "w") : stdout;
+        if (!fout) {
+            fprintf(stderr, "Cant create output file: %s\n", output_file);
+            free(xyz);
+            traj_close_reader(r);
+            return 1;
+        }
+        fprintf(fout, "t");
+        for (size_t k = 0; k < stored; k++) {
+            size_t i = k * h->stride + 1;
+            fprintf(fout, ",x%zu,y%zu,z%zu", i, i, i);
+        }
+        fprintf(fout, "\n");
+        while ((rc = traj_read_frame(r, &t, xyz)) == 1) {
+            fprintf(fout, "%.6f", t);
+            for (size_t k = 0; k < stored; k++) {
+                fprintf(fout, ",%.6f,%.6f,%.6f", xyz[3*k], xyz[3*k+1], xyz[3*k+2]);
+            }
+            fprintf(fout, "\n");
+        }
+        if (fout != stdout) {
+            fclose(fout);
+        }
+    }
+    if (rc < 0) {
+        fprintf(stderr, "Corrupted frame in %s\n", input_file);
+    }
+
+    free(xyz);
+    traj_close_reader(r);
+    return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "trajectory.h"
+
+struct TrajWriter {
+    FILE* fout;
+    TrajHeader h;
+    size_t raw_bytes;           // данные кадра до сжатия
+    unsigned char* raw;
+    unsigned char* packed;      // перемешанные и сжатые данные (TRAJ_ZLIB)
+    size_t packed_capacity;
+};
+
+struct TrajReader {
+    FILE* fin;
+    TrajHeader h;
+    size_t raw_bytes;
+    unsigned char* raw;
+    unsigned char* packed;
+    size_t packed_capacity;
+};
+
+static size_t value_size(uint32_t flags) {
+    return (flags & TRAJ_DOUBLE) ? sizeof(double) : sizeof(float);
+}
+
+#ifdef USE_ZLIB
+// Перемешивание по разрядам: сначала первые байты всех чисел, затем вторые и т.д.
+// Старшие байты соседних координат почти совпадают и сжимаются гораздо лучше
+static void shuffle_bytes(const unsigned char* in, unsigned char* out, size_t count, size_t size) {
+    for (size_t b = 0; b < size; b++) {
+        for (size_t i = 0; i < count; i++) {
+            out[b * count + i] = in[i * size + b];
+        }
+    }
+}
+
+static void unshuffle_bytes(const unsigned char* in, unsigned char* out, size_t count, size_t size) {
+    for (size_t b = 0; b < size; b++) {
+        for (size_t i = 0; i < count; i++) {
+            out[i * size + b] = in[b * count + i];
+        }
+    }
+}
+#endif
+
+static TrajWriter* traj_alloc(int n, int stride, uint32_t flags) {
+#ifndef USE_ZLIB
+    if (flags & TRAJ_ZLIB) {
+        fprintf(stderr, "Trajectory compression requires a build with -DUSE_ZLIB -lz\n");
+        return NULL;
+    }
+#endif
+    if (stride < 1) {
+        stride = 1;
+    }
+    TrajWriter* w = (TrajWriter*)calloc(1, sizeof(TrajWriter));
+    if (!w) {
+        return NULL;
+    }
+    w->h.flags = flags;
+    w->h.stride = (uint32_t)stride;
+    w->h.n = (uint64_t)n;
+    w->h.stored = ((uint64_t)n + stride - 1) / stride;
+    w->raw_bytes = (size_t)w->h.stored * 3 * value_size(flags);
+    w->raw = (unsigned char*)malloc(w->raw_bytes ? w->raw_bytes : 1);
+#ifdef USE_ZLIB
+    if (flags & TRAJ_ZLIB) {
+        w->packed_capacity = compressBound(w->raw_bytes);
+        w->packed = (unsigned char*)malloc(w->packed_capacity + w->raw_bytes + 1);
+    }
+#endif
+    if (!w->raw || ((flags & TRAJ_ZLIB) && !w->packed)) {
+        traj_close(w);
+        return NULL;
+    }
+    return w;
+}
+
+// Заголовок в том виде, в каком он лежит в файле
+static void header_bytes(const TrajHeader* h, unsigned char* out) {
+    uint32_t version = TRAJ_VERSION;
+    memcpy(out, TRAJ_MAGIC, 4);
+    memcpy(out + 4, &version, 4);
+    memcpy(out + 8, &h->flags, 4);
+    memcpy(out + 12, &h->stride, 4);
+    memcpy(out + 16, &h->n, 8);
+    memcpy(out + 24, &h->stored, 8);
+}
+
+TrajWriter* traj_create(const char* path, int n, int stride, uint32_t flags) {
+    TrajWriter* w = traj_alloc(n, stride, flags);
+    if (!w) {
+        return NULL;
+    }
+    w->fout = fopen(path, "wb");
+    if (!w->fout) {
+        fprintf(stderr, "Cant create trajectory file: %s\n", path);
+        traj_close(w);
+        return NULL;
+    }
+
+    unsigned char header[TRAJ_HEADER_BYTES];
+    header_bytes(&w->h, header);
+    if (fwrite(header, 1, sizeof(header), w->fout) != sizeof(header) || fflush(w->fout) != 0) {
+        fprintf(stderr, "Cant write trajectory header: %s\n", path);
+        traj_close(w);
+        return NULL;
+    }
+    return w;
+}
+
+TrajWriter* traj_reopen(const char* path, int n, int stride, uint32_t flags, uint64_t offset) {
+    TrajWriter* w = traj_alloc(n, stride, flags);
+    if (!w) {
+        return NULL;
+    }
+    w->fout = fopen(path, "r+b");
+    if (!w->fout) {
+        fprintf(stderr, "Cant open trajectory file for appending: %s\n", path);
+        traj_close(w);
+        return NULL;
+    }
+
+    unsigned char expected[TRAJ_HEADER_BYTES], header[TRAJ_HEADER_BYTES];
+    header_bytes(&w->h, expected);
+    if (fread(header, 1, sizeof(header), w->fout) != sizeof(header) ||
+        memcmp(header, expected, sizeof(header)) != 0 || offset < sizeof(header)) {
+        fprintf(stderr, "Trajectory file %s does not match the restarted run\n", path);
+        traj_close(w);
+        return NULL;
+    }
+    // Кадры, записанные после контрольной точки, будут посчитаны заново
+    fflush(w->fout);
+    // Длина проверяется до ftruncate: короткий файл он дополнил бы нулями
+    if (fseek(w->fout, 0, SEEK_END) != 0 || (uint64_t)ftell(w->fout) < offset ||
+        ftruncate(fileno(w->fout), (off_t)offset) != 0 || fseek(w->fout, 0, SEEK_END) != 0) {
+        fprintf(stderr, "Trajectory file %s is shorter than the checkpoint expects\n", path);
+        traj_close(w);
+        return NULL;
+    }
+    return w;
+}
+
+uint64_t traj_offset(const TrajWriter* w) {
+    return (uint64_t)ftell(w->fout);
+}
+
+int traj_write_frame(TrajWriter* w, double t, const double* x, const double* y, const double* z) {
+    size_t stored = (size_t)w->h.stored;
+    size_t stride = w->h.stride;
+
+    if (w->h.flags & TRAJ_DOUBLE) {
+        double* out = (double*)w->raw;
+        for (size_t k = 0; k < stored; k++) {
+            out[3*k] = x[k * stride];
+            out[3*k+1] = y[k * stride];
+            out[3*k+2] = z[k * stride];
+        }
+    } else {
+        float* out = (float*)w->raw;
+        for (size_t k = 0; k < stored; k++) {
+            out[3*k] = (float)x[k * stride];
+            out[3*k+1] = (float)y[k * stride];
+            out[3*k+2] = (float)z[k * stride];
+        }
+    }
+
+    const unsigned char* data = w->raw;
+    uint64_t bytes = w->raw_bytes;
+#ifdef USE_ZLIB
+    if (w->h.flags & TRAJ_ZLIB) {
+        unsigned char* shuffled = w->packed + w->packed_capacity;
+        shuffle_bytes(w->raw, shuffled, 3 * stored, value_size(w->h.flags));
+        uLongf packed_bytes = w->packed_capacity;
+        if (compress2(w->packed, &packed_bytes, shuffled, w->raw_bytes, Z_BEST_SPEED) != Z_OK) {
+            return -1;
+        }
+        data = w->packed;
+        bytes = packed_bytes;
+    }
+#endif
+
+    if (fwrite(&t, sizeof(t), 1, w->fout) != 1 ||
+        fwrite(&bytes, sizeof(bytes), 1, w->fout) != 1 ||
+        fwrite(data, 1, bytes, w->fout) != bytes) {
+        return -1;
+    }
+    // Кадр целиком в файле: читатель может идти следом за расчётом
+    return fflush(w->fout) == 0 ? 0 : -1;
+}
+
+int traj_close(TrajWriter* w) {
+    if (!w) {
+        return 0;
+    }
+    int rc = 0;
+    if (w->fout && fclose(w->fout) != 0) {
+        rc = -1;
+    }
+    free(w->raw);
+    free(w->packed);
+    free(w);
+    return rc;
+}
+
+TrajReader* traj_open(const char* path) {
+    TrajReader* r = (TrajReader*)calloc(1, sizeof(TrajReader));
+    if (!r) {
+        return NULL;
+    }
+    r->fin = fopen(path, "rb");
+    if (!r->fin) {
+        fprintf(stderr, "Cant open trajectory file: %s\n", path);
+        traj_close_reader(r);
+        return NULL;
+    }
+
+    char magic[4];
+    uint32_t version;
+    if (fread(magic, 1, 4, r->fin) != 4 || memcmp(magic, TRAJ_MAGIC, 4) != 0 ||
+        fread(&version, sizeof(version), 1, r->fin) != 1 || version != TRAJ_VERSION ||
+        fread(&r->h.flags, sizeof(r->h.flags), 1, r->fin) != 1 ||
+        fread(&r->h.stride, sizeof(r->h.stride), 1, r->fin) != 1 ||
+        fread(&r->h.n, sizeof(r->h.n), 1, r->fin) != 1 ||
+        fread(&r->h.stored, sizeof(r->h.stored), 1, r->fin) != 1 ||
+        r->h.stride < 1 || r->h.stored != (r->h.n + r->h.stride - 1) / r->h.stride) {
+        fprintf(stderr, "Not a trajectory file (or unsupported version): %s\n", path);
+        traj_close_reader(r);
+        return NULL;
+    }
+#ifndef USE_ZLIB
+    if (r->h.flags & TRAJ_ZLIB) {
+        fprintf(stderr, "Compressed trajectory requires a build with -DUSE_ZLIB -lz: %s\n", path);
+        traj_close_reader(r);
+        return NULL;
+    }
+#endif
+
+    r->raw_bytes = (size_t)r->h.stored * 3 * value_size(r->h.flags);
+    r->raw = (unsigned char*)malloc(r->raw_bytes ? r->raw_bytes : 1);
+    if (!r->raw) {
+        traj_close_reader(r);
+        return NULL;
+    }
+    return r;
+}
+
+const TrajHeader* traj_header(const TrajReader* r) {
+    return &r->h;
+}
+
+int traj_read_frame(TrajReader* r, double* t, double* xyz) {
+    uint64_t bytes;
+    if (fread(t, sizeof(*t), 1, r->fin) != 1 || fread(&bytes, sizeof(bytes), 1, r->fin) != 1) {
+        return 0;
+    }
+
+    unsigned char* data = r->raw;
+    if (r->h.flags & TRAJ_ZLIB) {
+        if (bytes > r->packed_capacity) {
+            unsigned char* grown = (unsigned char*)realloc(r->packed, bytes + r->raw_bytes);
+            if (!grown) {
+                return -1;
+            }
+            r->packed = grown;
+            r->packed_capacity = bytes;
+        }
+        data = r->packed;
+    } else if (bytes != r->raw_bytes) {
+        return -1;
+    }
+    // Оборванный кадр в конце файла - запись ещё идёт или расчёт был прерван
+    if (fread(data, 1, bytes, r->fin) != bytes) {
+        return 0;
+    }
+
+#ifdef USE_ZLIB
+    if (r->h.flags & TRAJ_ZLIB) {
+        unsigned char* shuffled = r->packed + r->packed_capacity;
+        uLongf raw_bytes = r->raw_bytes;
+        if (uncompress(shuffled, &raw_bytes, r->packed, bytes) != Z_OK || raw_bytes != r->raw_bytes) {
+            return -1;
+        }
+        unshuffle_bytes(shuffled, r->raw, 3 * (size_t)r->h.stored, value_size(r->h.flags));
+    }
+#endif
+
+    size_t count = 3 * (size_t)r->h.stored;
+    if (r->h.flags & TRAJ_DOUBLE) {
+        memcpy(xyz, r->raw, count * sizeof(double));
+    } else {
+        const float* in = (const float*)r->raw;
+        for (size_t k = 0; k < count; k++) {
+            xyz[k] = in[k];
+        }
+    }
+    return 1;
+}
+
+void traj_close_reader(TrajReader* r) {
+    if (!r) {
+        return;
+    }
+    if (r->fin) {
+        fclose(r->fin);
+    }
+    free(r->raw);
+    free(r->packed);
+    free(r);
+}
@@ -0,0 +1,69 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdint.h>
+
+/*
+ * Бинарный формат траекторий (trajectories.bin), общий для openmp.c и nbody_newton.cu.
+ *
+ * Файл - заголовок и последовательность независимых кадров. Числа записываются в порядке
+ * байтов машины, где шёл расчёт (little-endian на x86 и ARM), без перестановки (в отличие
+ * от writeBinary в firstTask.c): читать файл нужно на машине с тем же порядком байтов,
+ * на другой traj_open отвергнет файл по полю version. Структура:
+ *
+ *   заголовок (32 байта)
+ *     char     magic[4]   "NTRJ"
+ *     uint32_t version    TRAJ_VERSION
+ *     uint32_t flags      TRAJ_DOUBLE - координаты double, иначе float;
+ *                         TRAJ_ZLIB - данные кадра сжаты (байты предварительно перемешаны
+ *                         по разрядам, как фильтр shuffle в HDF5)
+ *     uint32_t stride     сохраняется каждое stride-е тело: 0, stride, 2 stride, ...
+ *     uint64_t n          тел в расчёте
+ *     uint64_t stored     тел в кадре, (n + stride - 1) / stride
+ *
+ *   кадр
+ *     double   t
+ *     uint64_t bytes      длина данных кадра в файле
+ *     данные              x, y, z каждого сохранённого тела подряд (порядок как в CSV)
+ *
+ * Числа кадров в заголовке нет: кадры только дописываются в конец и сбрасываются на диск,
+ * поэтому файл можно читать во время расчёта, а оборванный последний кадр просто
+ * не считается. Сжатие доступно при сборке с -DUSE_ZLIB (и -lz).
+ */
+
+#define TRAJ_MAGIC "NTRJ"
+#define TRAJ_VERSION 1
+#define TRAJ_HEADER_BYTES 32
+
+#define TRAJ_DOUBLE 1u
+#define TRAJ_ZLIB 2u
+
+typedef struct {
+    uint32_t flags;
+    uint32_t stride;
+    uint64_t n;
+    uint64_t stored;
+} TrajHeader;
+
+typedef struct TrajWriter TrajWriter;
+typedef struct TrajReader TrajReader;
+
+/* Возвращает NULL, если файл не создаётся или сжатие недоступно в этой сборке */
+TrajWriter* traj_create(const char* path, int n, int stride, uint32_t flags);
+/*
+ * Продолжение файла после рестарта: заголовок должен совпадать, всё после offset
+ * (кадры, записанные уже после контрольной точки) отбрасывается.
+ */
+TrajWriter* traj_reopen(const char* path, int n, int stride, uint32_t flags, uint64_t offset);
+/* Длина файла с учётом всех записанных кадров - для контрольной точки */
+uint64_t traj_offset(const TrajWriter* w);
+int traj_write_frame(TrajWriter* w, double t, const double* x, const double* y, const double* z);
+int traj_close(TrajWriter* w);
+
+TrajReader* traj_open(const char* path);
+const TrajHeader* traj_header(const TrajReader* r);
+/* Кадр в массив xyz длины 3 * stored: 1 - прочитан, 0 - конец файла, -1 - ошибка */
+int traj_read_frame(TrajReader* r, double* t, double* xyz);
+void traj_close_reader(TrajReader* r);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _EPOCH_H_
+#define _EPOCH_H_
+
+/*
+ * Эпохальное освобождение памяти (epoch-based reclamation) для lock-free структур
+ *
+ * Поток выполняет операцию между epoch_enter() и epoch_exit(). Узел, исключённый
+ * из структуры, передаётся в epoch_retire(): он освобождается, только когда
+ * глобальная эпоха продвинется на 2 - к этому моменту все потоки, которые могли
+ * видеть узел, уже вышли из своих операций.
+ *
+ * Каждый поток регистрируется при первом вызове и держит свои отложенные узлы
+ * в трёх корзинах по номеру эпохи, поэтому retire не требует синхронизации.
+ */
+
+typedef struct epoch_entry_s {
+    struct epoch_entry_s* retired_next;      /* Связь в корзине отложенных узлов */
+    void (*free_fn)(struct epoch_entry_s*);  /* Освобождение узла */
+} epoch_entry_t;
+
+void epoch_enter(void);
+void epoch_exit(void);
+
+/* Узел уже недоступен из структуры; вызывать между epoch_enter и epoch_exit */
+void epoch_retire(epoch_entry_t* entry, void (*free_fn)(epoch_entry_t*));
+
+/* Освобождает все отложенные узлы; вызывать, когда потоки завершены */
+void epoch_drain(void);
+
+#endif /* _EPOCH_H_ */
@@ -0,0 +1,84 @@
+#ifndef _LIST_ENGINE_H_
+#define _LIST_ENGINE_H_
+
+#include "rwlock_impl.h"
+
+/*
+ * Интерфейс реализаций множества для теста связного списка
+ *
+ * Все реализации хранят множество ключей и дают операции
+ * Insert/Member/Delete исходного теста связного списка:
+ * 1 - ключ вставлен/найден/удалён, 0 - нет.
+ *
+ * coarse_lock = 1: реализация не синхронизирована сама, Thread_work
+ * оборачивает каждую операцию в общий rwlock (rdlock для member,
+ * wrlock для insert/delete). Иначе операции потокобезопасны сами по себе.
+ *
+ * create получает выбранную реализацию rwlock: её используют структуры
+ * с собственными блокировками (полосы hash, fc), остальные её игнорируют.
+ *
+ * Пакетные операции insert_many/member_many/delete_many выполняют count
+ * операций одного вида, results[i] - результат для keys[i] (results может
+ * быть NULL). При coarse_lock = 1 весь пакет идёт под одним захватом общего
+ * rwlock. NULL - пакетов нет, Thread_work выполняет операции по одной.
+ */
+typedef struct {
+    const char* name;                         /* Имя для командной строки */
+    int   coarse_lock;                        /* Нужен общий rwlock */
+    void* (*create)(const rwlock_impl_t* lock);
+    void  (*destroy)(void* list);
+    int   (*insert)(void* list, int value);
+    int   (*member)(void* list, int value);
+    int   (*delete)(void* list, int value);
+    void  (*insert_many)(void* list, const int* keys, int count, int* results);
+    void  (*member_many)(void* list, const int* keys, int count, int* results);
+    void  (*delete_many)(void* list, const int* keys, int count, int* results);
+} list_engine_t;
+
+/*
+ * Операция пакета для прохода по исходному списку (list_coarse.c)
+ *
+ * coarse_list_apply выполняет операции, упорядоченные list_ops_sort по ключу,
+ * за один проход по списку; результат записывается в result.
+ * Операции с одинаковым ключом выполняются в порядке их адресов.
+ */
+#define LIST_OP_MEMBER  0
+#define LIST_OP_INSERT  1
+#define LIST_OP_DELETE  2
+
+#define LIST_BATCH_MAX  64   /* Операций в одном проходе пакетных функций */
+
+typedef struct {
+    int key;
+    int op;       /* LIST_OP_MEMBER, LIST_OP_INSERT или LIST_OP_DELETE */
+    int result;
+} list_op_t;
+
+void list_ops_sort(list_op_t** ops, int count);
+void coarse_list_apply(void* list, list_op_t* const* ops, int count);
+
+/* Исходный отсортированный список под общим rwlock */
+extern const list_engine_t coarse_list_engine;
+
+/* Список с блокировкой на каждом узле (hand-over-hand) */
+extern const list_engine_t hoh_list_engine;
+
+/* Lock-free список Harris-Michael с эпохальным освобождением узлов */
+extern const list_engine_t harris_list_engine;
+
+/* Список с пропусками, O(log n); под общим rwlock */
+extern const list_engine_t skiplist_engine;
+
+/* Хеш-множество с полосами my_rwlock_t, O(1) */
+extern const list_engine_t hash_set_engine;
+
+/* Исходный список с flat combining: вставки и удаления применяет один поток */
+extern const list_engine_t fc_list_engine;
+
+extern const list_engine_t* const list_engines[];
+extern const int list_engine_count;
+
+/* NULL, если имя неизвестно */
+const list_engine_t* list_engine_find(const char* name);
+
+#endif /* _LIST_ENGINE_H_ */
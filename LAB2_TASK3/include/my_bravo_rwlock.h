@@ -0,0 +1,46 @@
+#ifndef _MY_BRAVO_RWLOCK_H_
+#define _MY_BRAVO_RWLOCK_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "my_futex_rwlock.h"
+
+/*
+ * Блокировка чтения-записи с распределённым индикатором читателей (BRAVO)
+ *
+ * Пока включён reader_bias, читатель не трогает общее слово состояния:
+ * он занимает свой слот в массиве slots (каждый слот - отдельная строка кэша),
+ * так что читатели на разных ядрах не делят ни одной строки кэша.
+ * Писатель берёт базовую блокировку underlying, снимает reader_bias и ждёт,
+ * пока опустеют все слоты.
+ *
+ * Снятие reader_bias стоит писателю прохода по всем слотам, поэтому после
+ * него смещение выключается на время, в BRAVO_INHIBIT_FACTOR раз большее
+ * длительности снятия. При частых записях читатели работают через underlying
+ * и писатели слоты не сканируют.
+ *
+ * Политика базовой блокировки - Writer-preference, как у my_rwlock_t.
+ */
+
+#define BRAVO_SLOTS           64  /* Слотов читателей на одну блокировку */
+#define BRAVO_CACHE_LINE      64
+#define BRAVO_INHIBIT_FACTOR  9   /* Множитель паузы после снятия смещения */
+
+typedef struct {
+    _Alignas(BRAVO_CACHE_LINE) atomic_uint owner;  /* 0 или номер потока-читателя */
+} my_bravo_slot_t;
+
+typedef struct {
+    my_futex_rwlock_t underlying;          /* Писатели и читатели без смещения */
+    atomic_int        reader_bias;         /* Читатели идут через слоты */
+    atomic_ullong     inhibit_until;       /* До этого момента (нс) смещение не включать */
+    my_bravo_slot_t   slots[BRAVO_SLOTS];  /* Распределённый индикатор читателей */
+} my_bravo_rwlock_t;
+
+int my_bravo_rwlock_init(my_bravo_rwlock_t* rwlock);
+int my_bravo_rwlock_destroy(my_bravo_rwlock_t* rwlock);
+int my_bravo_rwlock_rdlock(my_bravo_rwlock_t* rwlock);
+int my_bravo_rwlock_wrlock(my_bravo_rwlock_t* rwlock);
+int my_bravo_rwlock_unlock(my_bravo_rwlock_t* rwlock);
+
+#endif /* _MY_BRAVO_RWLOCK_H_ */
@@ -0,0 +1,76 @@
+#ifndef _MY_FUTEX_H_
+#define _MY_FUTEX_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*
+ * Ожидание на 32-битном слове без мьютекса и условных переменных
+ *
+ * futex_wait(addr, expected) засыпает, только если *addr всё ещё равно expected
+ * (проверка и засыпание атомарны в ядре), поэтому изменение слова до вызова
+ * не теряется. Возможны ложные пробуждения - вызывающий код перепроверяет условие.
+ *
+ * Linux:  системный вызов futex
+ * macOS:  __ulock_wait/__ulock_wake (на них же построены os_unfair_lock и pthread)
+ * Прочие: sched_yield, т.е. активное ожидание с уступанием процессора
+ */
+
+#if defined(__linux__)
+
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static inline void futex_wait(atomic_uint* addr, uint32_t expected) {
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static inline void futex_wake(atomic_uint* addr, int count) {
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+#elif defined(__APPLE__)
+
+#define UL_COMPARE_AND_WAIT 1
+#define ULF_WAKE_ALL        0x00000100
+
+extern int __ulock_wait(uint32_t operation, void* addr, uint64_t value, uint32_t timeout_us);
+extern int __ulock_wake(uint32_t operation, void* addr, uint64_t wake_value);
+
+static inline void futex_wait(atomic_uint* addr, uint32_t expected) {
+    __ulock_wait(UL_COMPARE_AND_WAIT, (void*)addr, expected, 0);
+}
+
+static inline void futex_wake(atomic_uint* addr, int count) {
+    __ulock_wake(UL_COMPARE_AND_WAIT | (count > 1 ? ULF_WAKE_ALL : 0), (void*)addr, 0);
+}
+
+#else
+
+#include <sched.h>
+
+static inline void futex_wait(atomic_uint* addr, uint32_t expected) {
+    if (atomic_load(addr) == expected) {
+        sched_yield();
+    }
+}
+
+static inline void futex_wake(atomic_uint* addr, int count) {
+    (void)addr;
+    (void)count;
+}
+
+#endif
+
+/* Подсказка процессору внутри цикла активного ожидания */
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax() ((void)0)
+#endif
+
+#endif /* _MY_FUTEX_H_ */
@@ -0,0 +1,33 @@
+#ifndef _MY_FUTEX_RWLOCK_H_
+#define _MY_FUTEX_RWLOCK_H_
+
+#include <stdatomic.h>
+
+/*
+ * Блокировка чтения-записи на одном атомарном слове состояния
+ *
+ * Слово state:
+ * - биты 0-19:  число активных читателей
+ * - бит 20:     писатель держит блокировку
+ * - биты 21-30: число ожидающих писателей
+ * - бит 31:     есть спящие читатели
+ *
+ * Захват без конкуренции - одна операция CAS, мьютекс не берётся.
+ * Читатели спят на самом state, писатели - на отдельном счётчике writer_seq,
+ * чтобы освобождение будило ровно одного писателя, а не всех ожидающих.
+ *
+ * Политика та же, что у my_rwlock_t: Writer-preference (приоритет писателей).
+ * Читатели не получают блокировку, пока есть ожидающие писатели.
+ */
+typedef struct {
+    atomic_uint state;       /* Читатели, писатель, ожидающие писатели */
+    atomic_uint writer_seq;  /* Номер передачи блокировки ожидающему писателю */
+} my_futex_rwlock_t;
+
+int my_futex_rwlock_init(my_futex_rwlock_t* rwlock);
+int my_futex_rwlock_destroy(my_futex_rwlock_t* rwlock);
+int my_futex_rwlock_rdlock(my_futex_rwlock_t* rwlock);
+int my_futex_rwlock_wrlock(my_futex_rwlock_t* rwlock);
+int my_futex_rwlock_unlock(my_futex_rwlock_t* rwlock);
+
+#endif /* _MY_FUTEX_RWLOCK_H_ */
@@ -2,6 +2,8 @@
 #define _MY_RWLOCK_H_
 
 #include <pthread.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 /*
  * Собственная реализация блокировки чтения-записи (Read-Write Lock)
@@ -18,7 +20,23 @@
  * Политика: Writer-preference (приоритет писателей)
  * Читатели не получают блокировку, если есть ожидающие писатели.
  * Это предотвращает голодание писателей.
+ *
+ * Режим ожидания (wait_mode):
+ * - MY_RWLOCK_PARK: сразу pthread_cond_wait (как раньше)
+ * - MY_RWLOCK_SPIN: активное ожидание вне мьютекса, без засыпания
+ * - MY_RWLOCK_ADAPTIVE: активное ожидание не дольше двух средних удержаний
+ *   блокировки, затем pthread_cond_wait
+ * Режим пробуждения читателей (wake_mode):
+ * - MY_RWLOCK_WAKE_BROADCAST: освобождение будит всех читателей сразу
+ * - MY_RWLOCK_WAKE_CHAIN: будится один читатель, он будит следующего
  */
+#define MY_RWLOCK_PARK           0
+#define MY_RWLOCK_SPIN           1
+#define MY_RWLOCK_ADAPTIVE       2
+
+#define MY_RWLOCK_WAKE_BROADCAST 0
+#define MY_RWLOCK_WAKE_CHAIN     1
+
 typedef struct {
     pthread_mutex_t mutex;           /* Защита внутреннего состояния */
     pthread_cond_t  readers_cv;      /* CV для ожидающих читателей */
@@ -27,6 +45,13 @@ typedef struct {
     int             waiting_readers; /* Число ожидающих читателей */
     int             waiting_writers; /* Число ожидающих писателей */
     int             writer_active;   /* Флаг: писатель держит блокировку */
+    int             wait_mode;       /* MY_RWLOCK_PARK, _SPIN или _ADAPTIVE */
+    int             wake_mode;       /* MY_RWLOCK_WAKE_BROADCAST или _CHAIN */
+    atomic_int      reader_blocked;  /* Копия условия ожидания читателя для спина */
+    atomic_int      writer_blocked;  /* Копия условия ожидания писателя для спина */
+    atomic_uint     hold_ns;         /* Среднее время удержания, нс (adaptive) */
+    uint64_t        hold_start;      /* Начало текущего удержания, нс (adaptive) */
+    unsigned        hold_count;      /* Счётчик удержаний для выборочного замера */
 } my_rwlock_t;
 
 /*
@@ -35,6 +60,13 @@ typedef struct {
  */
 int my_rwlock_init(my_rwlock_t* rwlock);
 
+/*
+ * Инициализация с режимами ожидания и пробуждения
+ * my_rwlock_init - то же с MY_RWLOCK_PARK и MY_RWLOCK_WAKE_BROADCAST
+ * Возвращает EINVAL при неизвестном режиме
+ */
+int my_rwlock_init_mode(my_rwlock_t* rwlock, int wait_mode, int wake_mode);
+
 /*
  * Уничтожение rwlock
  * Освобождает ресурсы (mutex, condvars)
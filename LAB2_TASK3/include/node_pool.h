@@ -0,0 +1,34 @@
+#ifndef _NODE_POOL_H_
+#define _NODE_POOL_H_
+
+#include <stddef.h>
+
+/*
+ * Пул узлов фиксированного размера с кэшем в каждом потоке
+ *
+ * Узлы нарезаются из плит (slab) по NODE_POOL_SLAB_BYTES, выровненных
+ * на свой размер: соседние вставки одного потока лежат рядом в памяти,
+ * а пул узла находится по адресу узла без лишних полей.
+ *
+ * Каждый поток выделяет и освобождает узлы в собственном списке свободных
+ * узлов, без блокировок; мьютекс пула берётся только при получении новой плиты.
+ * Узел, освобождённый другим потоком, попадает в список освобождающего.
+ *
+ * node_pool_configure вызывается до создания пулов:
+ * - enabled = 0: node_pool_alloc/node_pool_free сводятся к malloc/free
+ * - prefault_nodes > 0: при создании пул заранее выделяет и заполняет плиты
+ *   на столько узлов, чтобы ошибки страниц не попадали в замеры
+ */
+
+#define NODE_POOL_SLAB_BYTES  (64 * 1024)
+#define NODE_POOL_CACHE_LINE  64
+
+typedef struct node_pool_s node_pool_t;
+
+void         node_pool_configure(int enabled, size_t prefault_nodes);
+node_pool_t* node_pool_create(size_t node_size);
+void         node_pool_destroy(node_pool_t* pool);
+void*        node_pool_alloc(node_pool_t* pool);
+void         node_pool_free(void* node);
+
+#endif /* _NODE_POOL_H_ */
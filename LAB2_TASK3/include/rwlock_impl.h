@@ -0,0 +1,43 @@
+#ifndef _RWLOCK_IMPL_H_
+#define _RWLOCK_IMPL_H_
+
+#include <stddef.h>
+
+/*
+ * Таблица реализаций блокировки чтения-записи для выбора во время работы
+ *
+ * Все реализации сводятся к одному интерфейсу над void*:
+ *   custom  - my_rwlock_t (mutex + две условные переменные)
+ *   custom-spin, custom-adapt - my_rwlock_t с активным или адаптивным ожиданием
+ *   custom-chain - my_rwlock_t, читатели будят друг друга по цепочке
+ *   pthread - библиотечный pthread_rwlock_t
+ *   futex   - my_futex_rwlock_t (одно атомарное слово)
+ *   bravo   - my_bravo_rwlock_t (распределённые слоты читателей)
+ *   mutex   - pthread_mutex_t, читатели тоже исключают друг друга
+ *   spin    - спин-блокировка test-and-test-and-set, тоже без общих читателей
+ */
+typedef struct {
+    const char* name;                 /* Имя для командной строки */
+    size_t size;                      /* Размер объекта блокировки */
+    int (*init)(void* lock);
+    int (*destroy)(void* lock);
+    int (*rdlock)(void* lock);
+    int (*wrlock)(void* lock);
+    int (*unlock)(void* lock);
+} rwlock_impl_t;
+
+extern const rwlock_impl_t* const rwlock_impls[];
+extern const int rwlock_impl_count;
+
+/* NULL, если имя неизвестно */
+const rwlock_impl_t* rwlock_impl_find(const char* name);
+
+/*
+ * Массив из count блокировок, каждая в своих строках кэша
+ * rwlock_impl_at возвращает i-ю; NULL при нехватке памяти
+ */
+void* rwlock_impl_new(const rwlock_impl_t* impl, int count);
+void* rwlock_impl_at(const rwlock_impl_t* impl, void* locks, int i);
+void  rwlock_impl_free(const rwlock_impl_t* impl, void* locks, int count);
+
+#endif /* _RWLOCK_IMPL_H_ */
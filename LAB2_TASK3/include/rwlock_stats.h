@@ -0,0 +1,116 @@
+#ifndef _RWLOCK_STATS_H_
+#define _RWLOCK_STATS_H_
+
+/*
+ * Инструментирование блокировки и операций (включается -DRWLOCK_STATS)
+ *
+ * Каждый поток пишет в свою запись без синхронизации: счётчики захватов,
+ * пробуждений и гистограммы времени ожидания и операций. После завершения
+ * потоков rwlock_stats_collect() складывает записи всех потоков.
+ *
+ * Гистограмма логарифмически-линейная, как HdrHistogram: степень двойки
+ * делится на STATS_HIST_SUB одинаковых корзин, относительная ошибка
+ * значения не больше 1 / STATS_HIST_SUB.
+ *
+ * Без RWLOCK_STATS макросы ниже пустые, и код блокировки не меняется.
+ */
+
+#ifdef RWLOCK_STATS
+
+#include <stdio.h>
+#include <stdint.h>
+#include "timer.h"
+
+#define STATS_HIST_SUB_BITS 5
+#define STATS_HIST_SUB      (1 << STATS_HIST_SUB_BITS)
+#define STATS_HIST_MAX_BITS 40   /* Значения от 2^40 нс (~18 минут) попадают в последнюю корзину */
+#define STATS_HIST_BUCKETS  ((STATS_HIST_MAX_BITS - STATS_HIST_SUB_BITS + 1) * STATS_HIST_SUB)
+
+/* Писатель, ждавший дольше порога, считается голодающим */
+#ifndef RWLOCK_STATS_STARVE_NS
+#define RWLOCK_STATS_STARVE_NS 1000000ull
+#endif
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[STATS_HIST_BUCKETS];
+} stats_hist_t;
+
+enum {
+    STATS_RD_ACQUIRE,     /* Захваты на чтение */
+    STATS_WR_ACQUIRE,     /* Захваты на запись */
+    STATS_RD_CONTENDED,   /* Читатель ждал на условной переменной */
+    STATS_WR_CONTENDED,   /* Писатель ждал на условной переменной */
+    STATS_CV_WAKEUPS,     /* Возвраты из pthread_cond_wait */
+    STATS_CV_SPURIOUS,    /* Возвраты, после которых пришлось ждать снова */
+    STATS_WR_STARVED,     /* Ожидания писателя дольше RWLOCK_STATS_STARVE_NS */
+    STATS_SPIN_WINS,      /* Захваты после спина без засыпания */
+    STATS_COUNTER_COUNT
+};
+
+enum {
+    STATS_RD_WAIT,        /* Время rdlock, нс */
+    STATS_WR_WAIT,        /* Время wrlock, нс */
+    STATS_OP_MEMBER,      /* Операции Thread_work, нс */
+    STATS_OP_INSERT,
+    STATS_OP_DELETE,
+    STATS_HIST_COUNT
+};
+
+typedef struct {
+    uint64_t     counters[STATS_COUNTER_COUNT];
+    stats_hist_t hists[STATS_HIST_COUNT];
+} rwlock_stats_t;
+
+extern _Thread_local rwlock_stats_t* rwlock_stats_mine;
+
+/* Регистрирует запись вызывающего потока (при первом обращении) */
+rwlock_stats_t* rwlock_stats_register(void);
+
+static inline rwlock_stats_t* rwlock_stats_local(void) {
+    return rwlock_stats_mine != NULL ? rwlock_stats_mine : rwlock_stats_register();
+}
+
+void     stats_hist_record(stats_hist_t* hist, uint64_t value);
+/* count одинаковых значений (средняя задержка операции пакета) */
+void     stats_hist_record_n(stats_hist_t* hist, uint64_t value, uint64_t count);
+uint64_t stats_hist_percentile(const stats_hist_t* hist, double p);
+
+/* Обнуляет записи всех потоков; вызывать, когда рабочие потоки не запущены */
+void rwlock_stats_reset(void);
+
+/* Сумма записей всех потоков; вызывать после pthread_join */
+void rwlock_stats_collect(rwlock_stats_t* total);
+
+void rwlock_stats_print(FILE* out, const rwlock_stats_t* stats);
+
+#define RWLOCK_STATS_VAR(decl)       decl
+#define RWLOCK_STATS_NOW(t)          GET_TIME_NS(t)
+#define RWLOCK_STATS_COUNT(id)       (rwlock_stats_local()->counters[id]++)
+#define RWLOCK_STATS_RECORD(id, v)   stats_hist_record(&rwlock_stats_local()->hists[id], v)
+#define RWLOCK_STATS_SINCE(id, t0) { \
+   uint64_t t1_; \
+   GET_TIME_NS(t1_); \
+   RWLOCK_STATS_RECORD(id, t1_ - (t0)); \
+}
+/* Пакет из n операций: каждой записывается время пакета, делённое на n */
+#define RWLOCK_STATS_SINCE_EACH(id, t0, n) { \
+   uint64_t t1_; \
+   GET_TIME_NS(t1_); \
+   stats_hist_record_n(&rwlock_stats_local()->hists[id], (t1_ - (t0)) / (uint64_t)(n), (uint64_t)(n)); \
+}
+
+#else
+
+#define RWLOCK_STATS_VAR(decl)
+#define RWLOCK_STATS_NOW(t)
+#define RWLOCK_STATS_COUNT(id)
+#define RWLOCK_STATS_RECORD(id, v)
+#define RWLOCK_STATS_SINCE(id, t0)
+#define RWLOCK_STATS_SINCE_EACH(id, t0, n)
+
+#endif /* RWLOCK_STATS */
+
+#endif /* _RWLOCK_STATS_H_ */
@@ -1,13 +1,24 @@
 #ifndef _TIMER_H_
 #define _TIMER_H_
 
-#include <sys/time.h>
+#include <stdint.h>
+#include <time.h>
 
-/* Макрос GET_TIME возвращает текущее время в секундах (double) */
+/*
+ * Макрос GET_TIME возвращает текущее время в секундах (double)
+ * Часы монотонные: перевод системного времени не искажает замер
+ */
 #define GET_TIME(now) { \
-   struct timeval t; \
-   gettimeofday(&t, NULL); \
-   now = t.tv_sec + t.tv_usec/1000000.0; \
+   struct timespec t; \
+   clock_gettime(CLOCK_MONOTONIC, &t); \
+   now = t.tv_sec + t.tv_nsec/1000000000.0; \
+}
+
+/* Макрос GET_TIME_NS - монотонное время в наносекундах (uint64_t), для задержек операций */
+#define GET_TIME_NS(now) { \
+   struct timespec ts; \
+   clock_gettime(CLOCK_MONOTONIC, &ts); \
+   now = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec; \
 }
 
 #endif /* _TIMER_H_ */
@@ -0,0 +1,722 @@
+/*
+ * bench_rwlock.c - Единый тест блокировок чтения-записи на множестве ключей
+ *
+ * Заменяет test_custom_rwlock.c и test_pthread_rwlock.c, которые отличались
+ * только типом блокировки. Реализация rwlock (rwlock_impl.h) и структура
+ * данных (list_engine.h) выбираются во время работы, программа сама
+ * перебирает их сочетания, числа потоков и доли операций.
+ *
+ * Использование: ./bench_rwlock [опции]
+ *   --lock=L[,L...]      custom, custom-spin, custom-adapt, custom-chain, pthread, futex,
+ *                        bravo, mutex, spin; all - все реализации (custom,pthread)
+ *   --engine=E[,E...]    list, hoh, harris, skiplist, hash, fc; all - все структуры (list)
+ *   --threads=N[,N...]   числа потоков (1,2,4,8)
+ *   --mix=S:I[,S:I...]   доли поиска и вставки, остальное - удаления (0.8:0.1)
+ *   --keys=N             ключей до запуска потоков (1000)
+ *   --range=N            ключи операций из [0, N), N до 10^9 (100000000)
+ *   --ops=N              операций за прогон на все потоки (100000)
+ *   --runs=N             замеряемых прогонов на конфигурацию (5)
+ *   --warmup=N           прогревочных прогонов без замера (1)
+ *   --alloc=M            malloc, pool или prefault (malloc)
+ *   --sample=N           замерять задержку каждой N-й операции (16)
+ *   --batch=N            операции пакетами по N (1 - по одной, до 1024)
+ *   --pin                привязать поток i к ядру i % число ядер (Linux)
+ *   --verify             проверять содержимое множества после каждого прогона
+ *   --format=F           table, csv или json (table)
+ *   --output=FILE        файл результатов вместо stdout
+ *
+ * Каждый прогон начинается с нового множества, заполненного теми же ключами
+ * (seed = 1), потоки стартуют вместе по барьеру. По прогонам считаются
+ * медиана, минимум и максимум времени, пропускная способность по медиане
+ * и p50/p99 задержки операции по всем замеряемым прогонам.
+ *
+ * В пакетном режиме поток генерирует N операций, группирует их по виду и
+ * выполняет каждую группу через insert_many/member_many/delete_many
+ * (или по одной, если пакетов у структуры нет); общий rwlock берётся один
+ * раз на группу. Задержка операции - время пакета, делённое на N.
+ *
+ * С --verify потоки записывают ключи успешных вставок и удалений. Успешные
+ * вставки и удаления одного ключа чередуются при любом порядке потоков,
+ * поэтому после прогона ключ должен быть в множестве ровно тогда, когда
+ * начальное наличие + вставки - удаления равно 1, а в остальных случаях 0.
+ * Расхождение - ошибка блокировки или структуры: программа выходит с кодом 1.
+ * Чтобы операции чаще попадали в одни ключи, используйте небольшой --range.
+ *
+ * При сборке с -DRWLOCK_STATS (make stats) после каждой конфигурации в stderr
+ * выводятся счётчики блокировки и гистограммы задержек всех операций
+ * замеряемых прогонов (rwlock_stats.h). В пакетном режиме каждой операции
+ * группы записывается время группы, делённое на её размер.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "my_rand.h"
+#include "rwlock_impl.h"
+#include "list_engine.h"
+#include "node_pool.h"
+#include "timer.h"
+#include "rwlock_stats.h"
+
+#define MAX_LIST 16   /* Элементов в списке значений опции */
+#define MAX_BATCH 1024
+
+typedef struct {
+    double search;
+    double insert;
+} op_mix_t;
+
+/* Параметры одного прогона */
+typedef struct {
+    const rwlock_impl_t* lock_impl;
+    const list_engine_t* engine;
+    int      thread_count;
+    op_mix_t mix;
+} run_config_t;
+
+/* Аргумент потока */
+typedef struct {
+    long      rank;
+    int       ops;
+    uint32_t* samples;        /* Задержки в нс или NULL */
+    int       sample_count;
+    int       member_count, insert_count, delete_count;
+    uint64_t  start_ns, finish_ns;  /* Начало и конец работы потока */
+    uint32_t* changes;        /* --verify: key * 2 + 1 - вставка, key * 2 - удаление, или NULL */
+    int       change_count;
+} thread_arg_t;
+
+/* Барьер на mutex и условной переменной (pthread_barrier_t нет в macOS) */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cv;
+    int             waiting;
+    int             total;
+    int             generation;
+} start_barrier_t;
+
+/* Глобальные параметры */
+int         initial_keys = 1000;
+int         max_key = 100000000;     /* Ключи операций в [0, max_key) */
+int         total_ops = 100000;
+int         runs = 5;
+int         warmup_runs = 1;
+int         alloc_mode = 0;          /* 0 - malloc, 1 - pool, 2 - prefault */
+int         sample_every = 16;
+int         batch_size = 1;
+int         pin_threads = 0;
+int         verify = 0;
+long        cpu_count = 1;
+
+/* Текущий прогон */
+run_config_t    current;
+void*           list;
+void*           rwlock;              /* Общий rwlock для coarse_lock */
+start_barrier_t start_barrier;
+
+/* Прототипы функций */
+void  Usage(char* prog_name);
+void* Thread_work(void* arg);
+static void verify_run(uint32_t* changes, size_t count);
+
+/*-----------------------------------------------------------------*/
+static void barrier_init(start_barrier_t* b, int total) {
+    pthread_mutex_init(&b->mutex, NULL);
+    pthread_cond_init(&b->cv, NULL);
+    b->waiting = 0;
+    b->total = total;
+    b->generation = 0;
+}
+
+static void barrier_destroy(start_barrier_t* b) {
+    pthread_cond_destroy(&b->cv);
+    pthread_mutex_destroy(&b->mutex);
+}
+
+static void barrier_wait(start_barrier_t* b) {
+    int generation;
+
+    pthread_mutex_lock(&b->mutex);
+    generation = b->generation;
+    if (++b->waiting == b->total) {
+        b->waiting = 0;
+        b->generation++;
+        pthread_cond_broadcast(&b->cv);
+    } else {
+        while (generation == b->generation) {
+            pthread_cond_wait(&b->cv, &b->mutex);
+        }
+    }
+    pthread_mutex_unlock(&b->mutex);
+}
+
+/*-----------------------------------------------------------------*/
+static void pin_to_cpu(long rank) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(rank % cpu_count, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)rank;
+#endif
+}
+
+/*-----------------------------------------------------------------*/
+/* Группа операций одного вида: общий rwlock берётся один раз на группу */
+static void run_group(int kind, const int* keys, int count, int* results) {
+    const list_engine_t* engine = current.engine;
+    const rwlock_impl_t* lock = current.lock_impl;
+    void (*many)(void*, const int*, int, int*);
+    int  (*one)(void*, int);
+
+    if (kind == LIST_OP_MEMBER) {
+        many = engine->member_many;
+        one = engine->member;
+    } else if (kind == LIST_OP_INSERT) {
+        many = engine->insert_many;
+        one = engine->insert;
+    } else {
+        many = engine->delete_many;
+        one = engine->delete;
+    }
+
+    if (engine->coarse_lock) {
+        if (kind == LIST_OP_MEMBER) lock->rdlock(rwlock);
+        else lock->wrlock(rwlock);
+    }
+    if (many != NULL) {
+        many(list, keys, count, results);
+    } else if (results != NULL) {
+        for (int i = 0; i < count; i++) results[i] = one(list, keys[i]);
+    } else {
+        for (int i = 0; i < count; i++) one(list, keys[i]);
+    }
+    if (engine->coarse_lock) lock->unlock(rwlock);
+}
+
+/* Успешная вставка или удаление для --verify */
+static inline void log_change(thread_arg_t* ta, int key, int inserted) {
+    ta->changes[ta->change_count++] = (uint32_t)key * 2 + (inserted ? 1 : 0);
+}
+
+/* Пакетный режим Thread_work */
+static void work_batched(thread_arg_t* ta, unsigned* seed) {
+    int keys[3][MAX_BATCH];
+    int results[MAX_BATCH];
+    int counts[3];
+    int i, b, n, kind, timed;
+    double which_op;
+    uint64_t t0 = 0, t1;
+    RWLOCK_STATS_VAR(uint64_t op_t0;)
+
+    for (i = 0; i < ta->ops; i += batch_size) {
+        n = ta->ops - i < batch_size ? ta->ops - i : batch_size;
+        counts[LIST_OP_MEMBER] = counts[LIST_OP_INSERT] = counts[LIST_OP_DELETE] = 0;
+        for (b = 0; b < n; b++) {
+            which_op = my_drand(seed);
+            if (which_op < current.mix.search) kind = LIST_OP_MEMBER;
+            else if (which_op < current.mix.search + current.mix.insert) kind = LIST_OP_INSERT;
+            else kind = LIST_OP_DELETE;
+            keys[kind][counts[kind]++] = my_rand(seed) % max_key;
+        }
+
+        timed = ta->samples != NULL && i % sample_every == 0;
+        if (timed) GET_TIME_NS(t0);
+        for (kind = 0; kind < 3; kind++) {
+            if (counts[kind] == 0) continue;
+            RWLOCK_STATS_NOW(op_t0);
+            run_group(kind, keys[kind], counts[kind], ta->changes != NULL ? results : NULL);
+            RWLOCK_STATS_SINCE_EACH(STATS_OP_MEMBER + kind, op_t0, counts[kind]);
+            if (ta->changes != NULL && kind != LIST_OP_MEMBER) {
+                for (b = 0; b < counts[kind]; b++) {
+                    if (results[b]) log_change(ta, keys[kind][b], kind == LIST_OP_INSERT);
+                }
+            }
+        }
+        if (timed) {
+            GET_TIME_NS(t1);
+            t1 = (t1 - t0) / n;
+            ta->samples[ta->sample_count++] = (uint32_t)(t1 > UINT32_MAX ? UINT32_MAX : t1);
+        }
+
+        ta->member_count += counts[LIST_OP_MEMBER];
+        ta->insert_count += counts[LIST_OP_INSERT];
+        ta->delete_count += counts[LIST_OP_DELETE];
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Функция потока - выполняет операции над множеством */
+void* Thread_work(void* arg) {
+    thread_arg_t* ta = (thread_arg_t*)arg;
+    const list_engine_t* engine = current.engine;
+    const rwlock_impl_t* lock = current.lock_impl;
+    int coarse = engine->coarse_lock;
+    int i, val, rv;
+    double which_op;
+    unsigned seed = ta->rank + 1;
+    uint64_t t0 = 0, t1;
+    int timed;
+    RWLOCK_STATS_VAR(uint64_t op_t0;)
+
+    if (pin_threads) pin_to_cpu(ta->rank);
+    barrier_wait(&start_barrier);
+    GET_TIME_NS(ta->start_ns);
+
+    if (batch_size > 1) {
+        work_batched(ta, &seed);
+        GET_TIME_NS(ta->finish_ns);
+        return NULL;
+    }
+
+    for (i = 0; i < ta->ops; i++) {
+        which_op = my_drand(&seed);
+        val = my_rand(&seed) % max_key;
+        timed = ta->samples != NULL && i % sample_every == 0;
+        if (timed) GET_TIME_NS(t0);
+        RWLOCK_STATS_NOW(op_t0);
+
+        if (which_op < current.mix.search) {
+            /* Операция поиска - блокировка на чтение */
+            if (coarse) lock->rdlock(rwlock);
+            engine->member(list, val);
+            if (coarse) lock->unlock(rwlock);
+            RWLOCK_STATS_SINCE(STATS_OP_MEMBER, op_t0);
+            ta->member_count++;
+        } else if (which_op < current.mix.search + current.mix.insert) {
+            /* Операция вставки - блокировка на запись */
+            if (coarse) lock->wrlock(rwlock);
+            rv = engine->insert(list, val);
+            if (coarse) lock->unlock(rwlock);
+            RWLOCK_STATS_SINCE(STATS_OP_INSERT, op_t0);
+            if (rv && ta->changes != NULL) log_change(ta, val, 1);
+            ta->insert_count++;
+        } else {
+            /* Операция удаления - блокировка на запись */
+            if (coarse) lock->wrlock(rwlock);
+            rv = engine->delete(list, val);
+            if (coarse) lock->unlock(rwlock);
+            RWLOCK_STATS_SINCE(STATS_OP_DELETE, op_t0);
+            if (rv && ta->changes != NULL) log_change(ta, val, 0);
+            ta->delete_count++;
+        }
+
+        if (timed) {
+            GET_TIME_NS(t1);
+            ta->samples[ta->sample_count++] = (uint32_t)(t1 - t0 > UINT32_MAX ? UINT32_MAX : t1 - t0);
+        }
+    }
+
+    GET_TIME_NS(ta->finish_ns);
+    return NULL;
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Один прогон: новое множество, начальные ключи, потоки по барьеру
+ * Задержки дописываются в samples (если не NULL) с позиции *sample_count
+ * Возвращает время в секундах от старта первого потока до конца последнего:
+ * главный поток может проснуться после барьера позже рабочих
+ */
+static double run_once(uint32_t* samples, size_t* sample_count) {
+    int thread_count = current.thread_count;
+    int ops_per_thread = total_ops / thread_count;
+    pthread_t* thread_handles;
+    thread_arg_t* args;
+    uint32_t* changes = NULL;
+    size_t change_count = 0;
+    unsigned seed = 1;
+    long i, attempts;
+    uint64_t start, finish;
+    int key;
+
+    node_pool_configure(alloc_mode != 0,
+                        alloc_mode == 2 ? (size_t)initial_keys + (size_t)(total_ops * current.mix.insert) + 1 : 0);
+    list = current.engine->create(current.lock_impl);
+    rwlock = rwlock_impl_new(current.lock_impl, 1);
+    thread_handles = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    args = (thread_arg_t*)calloc(thread_count, sizeof(thread_arg_t));
+    if (verify) {
+        /* Начальные ключи, затем участки потоков по ops_per_thread записей */
+        changes = (uint32_t*)malloc(((size_t)initial_keys + (size_t)thread_count * ops_per_thread + 1) * sizeof(uint32_t));
+    }
+    if (list == NULL || rwlock == NULL || thread_handles == NULL || args == NULL || (verify && changes == NULL)) {
+        fprintf(stderr, "Cant allocate memory for the run\n");
+        exit(1);
+    }
+
+    /* Начальное заполнение (до запуска потоков) */
+    i = attempts = 0;
+    while (i < initial_keys && attempts < 2 * initial_keys) {
+        key = my_rand(&seed) % max_key;
+        if (current.engine->insert(list, key)) {
+            if (changes != NULL) changes[change_count++] = (uint32_t)key * 2 + 1;
+            i++;
+        }
+        attempts++;
+    }
+
+    /* Задержки потоков в непересекающихся участках samples */
+    for (i = 0; i < thread_count; i++) {
+        args[i].rank = i;
+        args[i].ops = ops_per_thread;
+        if (samples != NULL) {
+            args[i].samples = samples + *sample_count + i * ((ops_per_thread + sample_every - 1) / sample_every);
+        }
+        if (changes != NULL) {
+            args[i].changes = changes + initial_keys + (size_t)i * ops_per_thread;
+        }
+    }
+
+    barrier_init(&start_barrier, thread_count + 1);
+    for (i = 0; i < thread_count; i++)
+        pthread_create(&thread_handles[i], NULL, Thread_work, &args[i]);
+
+    barrier_wait(&start_barrier);
+    for (i = 0; i < thread_count; i++)
+        pthread_join(thread_handles[i], NULL);
+
+    start = args[0].start_ns;
+    finish = args[0].finish_ns;
+    for (i = 1; i < thread_count; i++) {
+        if (args[i].start_ns < start) start = args[i].start_ns;
+        if (args[i].finish_ns > finish) finish = args[i].finish_ns;
+    }
+
+    /* Сжатие участков задержек подряд */
+    if (samples != NULL) {
+        for (i = 0; i < thread_count; i++) {
+            memmove(samples + *sample_count, args[i].samples, args[i].sample_count * sizeof(uint32_t));
+            *sample_count += args[i].sample_count;
+        }
+    }
+
+    if (changes != NULL) {
+        for (i = 0; i < thread_count; i++) {
+            memmove(changes + change_count, args[i].changes, args[i].change_count * sizeof(uint32_t));
+            change_count += args[i].change_count;
+        }
+        verify_run(changes, change_count);
+        free(changes);
+    }
+
+    barrier_destroy(&start_barrier);
+    current.engine->destroy(list);
+    rwlock_impl_free(current.lock_impl, rwlock, 1);
+    free(thread_handles);
+    free(args);
+
+    return (finish - start) / 1e9;
+}
+
+/*-----------------------------------------------------------------*/
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t* sorted, size_t count, double p) {
+    size_t k;
+    if (count == 0) return 0;
+    k = (size_t)(p * (count - 1) + 0.5);
+    return sorted[k];
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Проверка прогона (--verify): changes - успешные вставки и удаления всех
+ * потоков, включая начальное заполнение. После сортировки записи одного
+ * ключа идут подряд; вставки минус удаления должны быть 0 или 1 и совпадать
+ * с member() для этого ключа. Вызывается после pthread_join.
+ */
+static void verify_run(uint32_t* changes, size_t count) {
+    size_t i = 0, j, errors = 0;
+    int key, net, found;
+
+    qsort(changes, count, sizeof(uint32_t), compare_u32);
+    while (i < count) {
+        key = (int)(changes[i] / 2);
+        net = 0;
+        for (j = i; j < count && (int)(changes[j] / 2) == key; j++) {
+            net += changes[j] % 2 ? 1 : -1;
+        }
+        found = current.engine->member(list, key);
+        if ((net != 0 && net != 1) || found != net) {
+            if (errors == 0) {
+                fprintf(stderr, "Verification failed (lock=%s engine=%s threads=%d): key %d: "
+                                "%d net successful inserts, member() returned %d\n",
+                        current.lock_impl->name, current.engine->name, current.thread_count, key, net, found);
+            }
+            errors++;
+        }
+        i = j;
+    }
+    if (errors > 0) {
+        fprintf(stderr, "Verification failed for %zu keys\n", errors);
+        exit(1);
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Разбор "a,b,c" в элементы; 0 при ошибке или переполнении */
+static int split_list(char* text, char* items[MAX_LIST]) {
+    int count = 0;
+    char* save = NULL;
+
+    for (char* item = strtok_r(text, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+        if (count == MAX_LIST) return 0;
+        items[count++] = item;
+    }
+    return count;
+}
+
+static const char* alloc_names[] = { "malloc", "pool", "prefault" };
+
+static void print_header(FILE* out, const char* format) {
+    if (strcmp(format, "csv") == 0) {
+        fprintf(out, "lock,engine,threads,search,insert,delete,keys,ops,alloc,runs,"
+                     "median_sec,min_sec,max_sec,throughput_ops_sec,p50_ns,p99_ns,batch\n");
+    } else if (strcmp(format, "json") == 0) {
+        fprintf(out, "[\n");
+    } else {
+        fprintf(out, "%-12s | %-8s | %-7s | %-14s | %-12s | %-12s | %-9s | %-9s\n",
+                "Lock", "Engine", "Threads", "Mix(S/I/D)", "Median(s)", "Ops/s", "p50(ns)", "p99(ns)");
+        fprintf(out, "-------------|----------|---------|----------------|--------------|--------------|-----------|----------\n");
+    }
+}
+
+static void print_result(FILE* out, const char* format, int first, const run_config_t* c,
+                         const double* times, const uint32_t* sorted, size_t sample_count) {
+    double median = runs % 2 ? times[runs / 2] : 0.5 * (times[runs / 2 - 1] + times[runs / 2]);
+    int ops = total_ops / c->thread_count * c->thread_count;
+    double throughput = median > 0 ? ops / median : 0.0;
+    double del = 1.0 - c->mix.search - c->mix.insert;
+    uint32_t p50 = percentile(sorted, sample_count, 0.50);
+    uint32_t p99 = percentile(sorted, sample_count, 0.99);
+
+    if (del < 0) del = 0;
+    if (strcmp(format, "csv") == 0) {
+        fprintf(out, "%s,%s,%d,%.2f,%.2f,%.2f,%d,%d,%s,%d,%e,%e,%e,%.0f,%u,%u,%d\n",
+                c->lock_impl->name, c->engine->name, c->thread_count, c->mix.search, c->mix.insert, del,
+                initial_keys, ops, alloc_names[alloc_mode], runs, median, times[0], times[runs - 1],
+                throughput, p50, p99, batch_size);
+    } else if (strcmp(format, "json") == 0) {
+        fprintf(out, "%s  {\"lock\": \"%s\", \"engine\": \"%s\", \"threads\": %d, "
+                     "\"search\": %.2f, \"insert\": %.2f, \"delete\": %.2f, \"keys\": %d, \"ops\": %d, "
+                     "\"alloc\": \"%s\", \"runs\": %d, \"median_sec\": %e, \"min_sec\": %e, \"max_sec\": %e, "
+                     "\"throughput_ops_sec\": %.0f, \"p50_ns\": %u, \"p99_ns\": %u, \"batch\": %d}",
+                first ? "" : ",\n", c->lock_impl->name, c->engine->name, c->thread_count,
+                c->mix.search, c->mix.insert, del, initial_keys, ops, alloc_names[alloc_mode], runs,
+                median, times[0], times[runs - 1], throughput, p50, p99, batch_size);
+    } else {
+        char mix[32];
+        snprintf(mix, sizeof(mix), "%.2f/%.2f/%.2f", c->mix.search, c->mix.insert, del);
+        fprintf(out, "%-12s | %-8s | %-7d | %-14s | %-12e | %-12.0f | %-9u | %-9u\n",
+                c->lock_impl->name, c->engine->name, c->thread_count, mix, median, throughput, p50, p99);
+    }
+    fflush(out);
+}
+
+static void print_footer(FILE* out, const char* format) {
+    if (strcmp(format, "json") == 0) {
+        fprintf(out, "\n]\n");
+    }
+}
+
+/*-----------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+    char lock_default[] = "custom,pthread", engine_default[] = "list";
+    char threads_default[] = "1,2,4,8", mix_default[] = "0.8:0.1";
+    char *lock_arg = lock_default, *engine_arg = engine_default;
+    char *threads_arg = threads_default, *mix_arg = mix_default;
+    const char* format = "table";
+    const char* output_file = NULL;
+    char* items[MAX_LIST];
+    const rwlock_impl_t* locks[MAX_LIST];
+    const list_engine_t* engines[MAX_LIST];
+    int thread_counts[MAX_LIST];
+    op_mix_t mixes[MAX_LIST];
+    int lock_count, engine_count, thread_list_count, mix_count;
+    int a, max_threads = 1;
+
+    for (a = 1; a < argc; a++) {
+        if (strncmp(argv[a], "--lock=", 7) == 0) {
+            lock_arg = argv[a] + 7;
+        } else if (strncmp(argv[a], "--engine=", 9) == 0) {
+            engine_arg = argv[a] + 9;
+        } else if (strncmp(argv[a], "--threads=", 10) == 0) {
+            threads_arg = argv[a] + 10;
+        } else if (strncmp(argv[a], "--mix=", 6) == 0) {
+            mix_arg = argv[a] + 6;
+        } else if (strncmp(argv[a], "--keys=", 7) == 0) {
+            initial_keys = atoi(argv[a] + 7);
+        } else if (strncmp(argv[a], "--range=", 8) == 0) {
+            max_key = atoi(argv[a] + 8);
+        } else if (strncmp(argv[a], "--ops=", 6) == 0) {
+            total_ops = atoi(argv[a] + 6);
+        } else if (strncmp(argv[a], "--runs=", 7) == 0) {
+            runs = atoi(argv[a] + 7);
+        } else if (strncmp(argv[a], "--warmup=", 9) == 0) {
+            warmup_runs = atoi(argv[a] + 9);
+        } else if (strcmp(argv[a], "--alloc=malloc") == 0) {
+            alloc_mode = 0;
+        } else if (strcmp(argv[a], "--alloc=pool") == 0) {
+            alloc_mode = 1;
+        } else if (strcmp(argv[a], "--alloc=prefault") == 0) {
+            alloc_mode = 2;
+        } else if (strncmp(argv[a], "--sample=", 9) == 0) {
+            sample_every = atoi(argv[a] + 9);
+        } else if (strncmp(argv[a], "--batch=", 8) == 0) {
+            batch_size = atoi(argv[a] + 8);
+        } else if (strcmp(argv[a], "--pin") == 0) {
+            pin_threads = 1;
+        } else if (strcmp(argv[a], "--verify") == 0) {
+            verify = 1;
+        } else if (strcmp(argv[a], "--format=table") == 0 || strcmp(argv[a], "--format=csv") == 0 ||
+                   strcmp(argv[a], "--format=json") == 0) {
+            format = argv[a] + 9;
+        } else if (strncmp(argv[a], "--output=", 9) == 0) {
+            output_file = argv[a] + 9;
+        } else {
+            Usage(argv[0]);
+        }
+    }
+    if (initial_keys < 0 || max_key < 1 || max_key > 1000000000 || total_ops < 1 || runs < 1 || warmup_runs < 0 || sample_every < 1 ||
+        batch_size < 1 || batch_size > MAX_BATCH) {
+        Usage(argv[0]);
+    }
+
+    /* Списки значений */
+    if (strcmp(lock_arg, "all") == 0) {
+        lock_count = rwlock_impl_count;
+        for (a = 0; a < lock_count; a++) locks[a] = rwlock_impls[a];
+    } else {
+        lock_count = split_list(lock_arg, items);
+        for (a = 0; a < lock_count; a++) {
+            if ((locks[a] = rwlock_impl_find(items[a])) == NULL) {
+                fprintf(stderr, "Unknown lock: %s\n", items[a]);
+                return 1;
+            }
+        }
+    }
+    if (strcmp(engine_arg, "all") == 0) {
+        engine_count = list_engine_count;
+        for (a = 0; a < engine_count; a++) engines[a] = list_engines[a];
+    } else {
+        engine_count = split_list(engine_arg, items);
+        for (a = 0; a < engine_count; a++) {
+            if ((engines[a] = list_engine_find(items[a])) == NULL) {
+                fprintf(stderr, "Unknown engine: %s\n", items[a]);
+                return 1;
+            }
+        }
+    }
+    thread_list_count = split_list(threads_arg, items);
+    for (a = 0; a < thread_list_count; a++) {
+        thread_counts[a] = atoi(items[a]);
+        if (thread_counts[a] < 1 || thread_counts[a] > total_ops) {
+            fprintf(stderr, "Thread count must be between 1 and the number of ops: %s\n", items[a]);
+            return 1;
+        }
+        if (thread_counts[a] > max_threads) max_threads = thread_counts[a];
+    }
+    mix_count = split_list(mix_arg, items);
+    for (a = 0; a < mix_count; a++) {
+        if (sscanf(items[a], "%lf:%lf", &mixes[a].search, &mixes[a].insert) != 2 ||
+            mixes[a].search < 0 || mixes[a].insert < 0 || mixes[a].search + mixes[a].insert > 1.0 + 1e-9) {
+            fprintf(stderr, "Mix must be SEARCH:INSERT with shares summing to at most 1: %s\n", items[a]);
+            return 1;
+        }
+    }
+    if (lock_count == 0 || engine_count == 0 || thread_list_count == 0 || mix_count == 0) {
+        Usage(argv[0]);
+    }
+
+    cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count < 1) cpu_count = 1;
+
+    FILE* out = stdout;
+    if (output_file != NULL && (out = fopen(output_file, "w")) == NULL) {
+        fprintf(stderr, "Cant create output file: %s\n", output_file);
+        return 1;
+    }
+
+    /* Задержки всех замеряемых прогонов одной конфигурации */
+    size_t per_run = (size_t)total_ops / sample_every + max_threads + 1;
+    uint32_t* samples = (uint32_t*)malloc(per_run * runs * sizeof(uint32_t));
+    double* times = (double*)malloc(runs * sizeof(double));
+    if (samples == NULL || times == NULL) {
+        fprintf(stderr, "Cant allocate memory for latency samples\n");
+        return 1;
+    }
+
+    print_header(out, format);
+    int first = 1;
+    for (int l = 0; l < lock_count; l++) {
+        for (int e = 0; e < engine_count; e++) {
+            for (int m = 0; m < mix_count; m++) {
+                for (int t = 0; t < thread_list_count; t++) {
+                    size_t sample_count = 0;
+
+                    current.lock_impl = locks[l];
+                    current.engine = engines[e];
+                    current.thread_count = thread_counts[t];
+                    current.mix = mixes[m];
+                    fprintf(stderr, "Running lock=%s engine=%s threads=%d mix=%.2f:%.2f...\n",
+                            locks[l]->name, engines[e]->name, thread_counts[t], mixes[m].search, mixes[m].insert);
+
+                    for (int w = 0; w < warmup_runs; w++) {
+                        run_once(NULL, NULL);
+                    }
+#ifdef RWLOCK_STATS
+                    rwlock_stats_reset();
+#endif
+                    for (int r = 0; r < runs; r++) {
+                        times[r] = run_once(samples, &sample_count);
+                    }
+
+                    qsort(times, runs, sizeof(double), compare_double);
+                    qsort(samples, sample_count, sizeof(uint32_t), compare_u32);
+                    print_result(out, format, first, &current, times, samples, sample_count);
+#ifdef RWLOCK_STATS
+                    {
+                        rwlock_stats_t stats;
+                        rwlock_stats_collect(&stats);
+                        rwlock_stats_print(stderr, &stats);
+                    }
+#endif
+                    first = 0;
+                }
+            }
+        }
+    }
+    print_footer(out, format);
+
+    if (out != stdout) fclose(out);
+    free(samples);
+    free(times);
+    return 0;
+}
+
+/*-----------------------------------------------------------------*/
+void Usage(char* prog_name) {
+    fprintf(stderr, "usage: %s [--lock=L,...|all] [--engine=E,...|all] [--threads=N,...] [--mix=S:I,...]\n"
+                    "       [--keys=N] [--range=N] [--ops=N] [--runs=N] [--warmup=N] [--alloc=malloc|pool|prefault]\n"
+                    "       [--sample=N] [--batch=N] [--pin] [--verify] [--format=table|csv|json] [--output=FILE]\n"
+                    "  locks:   custom custom-spin custom-adapt custom-chain pthread futex bravo mutex spin\n"
+                    "  engines: list hoh harris skiplist hash fc\n", prog_name);
+    exit(1);
+}
@@ -0,0 +1,164 @@
+/*
+ * epoch.c - Эпохальное освобождение памяти
+ *
+ * Глобальная эпоха global_epoch продвигается, когда все потоки внутри
+ * операций уже видели текущее значение. Метка отложенного узла - значение
+ * эпохи после его исключения; узел с меткой r освобождается при эпохе r + 2.
+ *
+ * У потока три корзины (метка % 3). Все метки в корзинах не больше seen,
+ * поэтому при переходе к эпохе g > seen корзины g % 3 и (g + 1) % 3
+ * содержат только метки не больше g - 2 и освобождаются целиком.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "epoch.h"
+
+#define EPOCH_QUIESCENT  UINT_MAX  /* Поток вне операции */
+#define EPOCH_BUCKETS    3
+#define EPOCH_BATCH      64        /* Отложенных узлов между попытками продвинуть эпоху */
+#define EPOCH_CACHE_LINE 64
+
+typedef struct epoch_record_s {
+    _Alignas(EPOCH_CACHE_LINE) atomic_uint local;  /* Эпоха текущей операции потока */
+    atomic_int     in_use;                         /* Запись занята живым потоком */
+    unsigned       seen;                           /* Последняя обработанная эпоха */
+    unsigned       retired;                        /* Отложено с последней попытки */
+    epoch_entry_t* limbo[EPOCH_BUCKETS];           /* Корзины отложенных узлов */
+    struct epoch_record_s* next;
+} epoch_record_t;
+
+static atomic_uint global_epoch = 0;
+static _Atomic(epoch_record_t*) records = NULL;   /* Записи всех потоков, только добавляются */
+static _Thread_local epoch_record_t* my_record = NULL;
+static pthread_key_t  record_key;
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Завершение потока: запись освобождается для следующих потоков вместе
+ * с отложенными узлами - корзины сохраняют смысл меток и у нового владельца
+ */
+static void release_record(void* arg) {
+    epoch_record_t* rec = (epoch_record_t*)arg;
+    atomic_store(&rec->local, EPOCH_QUIESCENT);
+    atomic_store(&rec->in_use, 0);
+}
+
+static void create_record_key(void) {
+    pthread_key_create(&record_key, release_record);
+}
+
+static epoch_record_t* get_record(void) {
+    epoch_record_t* rec = my_record;
+    epoch_record_t* head;
+    int expected;
+
+    if (rec != NULL) {
+        return rec;
+    }
+    pthread_once(&record_key_once, create_record_key);
+
+    /* Запись завершившегося потока, чтобы список не рос с каждым запуском потоков */
+    for (rec = atomic_load(&records); rec != NULL; rec = rec->next) {
+        expected = 0;
+        if (atomic_load(&rec->in_use) == 0 && atomic_compare_exchange_strong(&rec->in_use, &expected, 1)) {
+            my_record = rec;
+            pthread_setspecific(record_key, rec);
+            return rec;
+        }
+    }
+
+    rec = (epoch_record_t*)aligned_alloc(EPOCH_CACHE_LINE, sizeof(epoch_record_t));
+    if (rec == NULL) {
+        abort();
+    }
+    atomic_init(&rec->local, EPOCH_QUIESCENT);
+    atomic_init(&rec->in_use, 1);
+    rec->seen = atomic_load(&global_epoch);
+    rec->retired = 0;
+    for (int b = 0; b < EPOCH_BUCKETS; b++) {
+        rec->limbo[b] = NULL;
+    }
+
+    head = atomic_load(&records);
+    do {
+        rec->next = head;
+    } while (!atomic_compare_exchange_weak(&records, &head, rec));
+
+    my_record = rec;
+    pthread_setspecific(record_key, rec);
+    return rec;
+}
+
+static void free_bucket(epoch_record_t* rec, int b) {
+    epoch_entry_t* entry = rec->limbo[b];
+    epoch_entry_t* next;
+
+    rec->limbo[b] = NULL;
+    while (entry != NULL) {
+        next = entry->retired_next;
+        entry->free_fn(entry);
+        entry = next;
+    }
+}
+
+/* Освобождение корзин, ставших безопасными при переходе к эпохе epoch */
+static void collect(epoch_record_t* rec, unsigned epoch) {
+    if (epoch == rec->seen) {
+        return;
+    }
+    free_bucket(rec, epoch % EPOCH_BUCKETS);
+    free_bucket(rec, (epoch + 1) % EPOCH_BUCKETS);
+    rec->seen = epoch;
+}
+
+/* Продвижение эпохи, если все активные потоки уже в текущей */
+static void try_advance(void) {
+    unsigned epoch = atomic_load(&global_epoch);
+    unsigned local;
+
+    for (epoch_record_t* rec = atomic_load(&records); rec != NULL; rec = rec->next) {
+        local = atomic_load(&rec->local);
+        if (local != EPOCH_QUIESCENT && local != epoch) {
+            return;
+        }
+    }
+    atomic_compare_exchange_strong(&global_epoch, &epoch, epoch + 1);
+}
+
+void epoch_enter(void) {
+    epoch_record_t* rec = get_record();
+    unsigned epoch = atomic_load(&global_epoch);
+
+    atomic_store(&rec->local, epoch);
+    collect(rec, epoch);
+}
+
+void epoch_exit(void) {
+    atomic_store_explicit(&my_record->local, EPOCH_QUIESCENT, memory_order_release);
+}
+
+void epoch_retire(epoch_entry_t* entry, void (*free_fn)(epoch_entry_t*)) {
+    epoch_record_t* rec = get_record();
+    unsigned epoch = atomic_load(&global_epoch);
+
+    collect(rec, epoch);
+    entry->free_fn = free_fn;
+    entry->retired_next = rec->limbo[epoch % EPOCH_BUCKETS];
+    rec->limbo[epoch % EPOCH_BUCKETS] = entry;
+
+    if (++rec->retired >= EPOCH_BATCH) {
+        rec->retired = 0;
+        try_advance();
+    }
+}
+
+void epoch_drain(void) {
+    for (epoch_record_t* rec = atomic_load(&records); rec != NULL; rec = rec->next) {
+        for (int b = 0; b < EPOCH_BUCKETS; b++) {
+            free_bucket(rec, b);
+        }
+    }
+}
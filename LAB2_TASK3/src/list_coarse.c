@@ -0,0 +1,228 @@
+/*
+ * list_coarse.c - Исходный отсортированный связный список
+ *
+ * Операции Insert/Member/Delete из первоначального теста без изменений
+ * алгоритма; синхронизацию даёт общий rwlock в Thread_work (coarse_lock = 1).
+ *
+ * Пакетные операции сортируют ключи и выполняют их за один проход по
+ * списку (coarse_list_apply); тот же проход использует list_fc.c.
+ */
+
+#include <stdlib.h>
+#include "node_pool.h"
+#include "list_engine.h"
+
+/* Узел связного списка */
+struct list_node_s {
+    int    data;
+    struct list_node_s* next;
+};
+
+typedef struct {
+    struct list_node_s* head;   /* Голова списка */
+    node_pool_t*        pool;
+} coarse_list_t;
+
+static void* List_create(const rwlock_impl_t* lock) {
+    coarse_list_t* cl = (coarse_list_t*)malloc(sizeof(coarse_list_t));
+    (void)lock;
+    cl->head = NULL;
+    cl->pool = node_pool_create(sizeof(struct list_node_s));
+    return cl;
+}
+
+/*-----------------------------------------------------------------*/
+static void List_destroy(void* list) {
+    coarse_list_t* cl = (coarse_list_t*)list;
+    struct list_node_s* current = cl->head;
+    struct list_node_s* following;
+
+    while (current != NULL) {
+        following = current->next;
+        node_pool_free(current);
+        current = following;
+    }
+    node_pool_destroy(cl->pool);
+    free(cl);
+}
+
+/*-----------------------------------------------------------------*/
+/* Вставка значения в отсортированный список */
+static int Insert(void* list, int value) {
+    coarse_list_t* cl = (coarse_list_t*)list;
+    struct list_node_s* curr = cl->head;
+    struct list_node_s* pred = NULL;
+    struct list_node_s* temp;
+    int rv = 1;
+
+    while (curr != NULL && curr->data < value) {
+        pred = curr;
+        curr = curr->next;
+    }
+
+    if (curr == NULL || curr->data > value) {
+        temp = (struct list_node_s*)node_pool_alloc(cl->pool);
+        temp->data = value;
+        temp->next = curr;
+        if (pred == NULL)
+            cl->head = temp;
+        else
+            pred->next = temp;
+    } else {
+        rv = 0;  /* Значение уже в списке */
+    }
+
+    return rv;
+}
+
+/*-----------------------------------------------------------------*/
+/* Поиск значения в списке */
+static int Member(void* list, int value) {
+    struct list_node_s* temp;
+
+    temp = ((coarse_list_t*)list)->head;
+    while (temp != NULL && temp->data < value)
+        temp = temp->next;
+
+    if (temp == NULL || temp->data > value) {
+        return 0;
+    } else {
+        return 1;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Удаление значения из списка */
+static int Delete(void* list, int value) {
+    coarse_list_t* cl = (coarse_list_t*)list;
+    struct list_node_s* curr = cl->head;
+    struct list_node_s* pred = NULL;
+    int rv = 1;
+
+    while (curr != NULL && curr->data < value) {
+        pred = curr;
+        curr = curr->next;
+    }
+
+    if (curr != NULL && curr->data == value) {
+        if (pred == NULL) {
+            cl->head = curr->next;
+        } else {
+            pred->next = curr->next;
+        }
+        node_pool_free(curr);
+    } else {
+        rv = 0;  /* Значение не найдено */
+    }
+
+    return rv;
+}
+
+/*-----------------------------------------------------------------*/
+/* Порядок по ключу, при равных ключах - по адресу операции */
+static int compare_ops(const void* a, const void* b) {
+    const list_op_t* x = *(list_op_t* const*)a;
+    const list_op_t* y = *(list_op_t* const*)b;
+
+    if (x->key != y->key) {
+        return (x->key > y->key) - (x->key < y->key);
+    }
+    return (x > y) - (x < y);
+}
+
+void list_ops_sort(list_op_t** ops, int count) {
+    qsort(ops, count, sizeof(list_op_t*), compare_ops);
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Выполнение отсортированных операций за один проход
+ *
+ * pred/curr продвигаются только вперёд: после вставки curr указывает на
+ * новый узел, после удаления - на следующий, поэтому повтор ключа видит
+ * результат предыдущей операции с ним.
+ */
+void coarse_list_apply(void* list, list_op_t* const* ops, int count) {
+    coarse_list_t* cl = (coarse_list_t*)list;
+    struct list_node_s* curr = cl->head;
+    struct list_node_s* pred = NULL;
+    struct list_node_s* temp;
+    int found;
+
+    for (int i = 0; i < count; i++) {
+        list_op_t* op = ops[i];
+
+        while (curr != NULL && curr->data < op->key) {
+            pred = curr;
+            curr = curr->next;
+        }
+        found = curr != NULL && curr->data == op->key;
+
+        if (op->op == LIST_OP_MEMBER) {
+            op->result = found;
+        } else if (op->op == LIST_OP_INSERT) {
+            op->result = !found;
+            if (!found) {
+                temp = (struct list_node_s*)node_pool_alloc(cl->pool);
+                temp->data = op->key;
+                temp->next = curr;
+                if (pred == NULL)
+                    cl->head = temp;
+                else
+                    pred->next = temp;
+                curr = temp;
+            }
+        } else {
+            op->result = found;
+            if (found) {
+                temp = curr->next;
+                if (pred == NULL)
+                    cl->head = temp;
+                else
+                    pred->next = temp;
+                node_pool_free(curr);
+                curr = temp;
+            }
+        }
+    }
+}
+
+/* Пакет операций одного вида частями по LIST_BATCH_MAX */
+static void apply_keys(void* list, int kind, const int* keys, int count, int* results) {
+    list_op_t ops[LIST_BATCH_MAX];
+    list_op_t* sorted[LIST_BATCH_MAX];
+
+    for (int base = 0; base < count; base += LIST_BATCH_MAX) {
+        int n = count - base < LIST_BATCH_MAX ? count - base : LIST_BATCH_MAX;
+
+        for (int i = 0; i < n; i++) {
+            ops[i].key = keys[base + i];
+            ops[i].op = kind;
+            sorted[i] = &ops[i];
+        }
+        list_ops_sort(sorted, n);
+        coarse_list_apply(list, sorted, n);
+        if (results != NULL) {
+            for (int i = 0; i < n; i++) {
+                results[base + i] = ops[i].result;
+            }
+        }
+    }
+}
+
+static void Insert_many(void* list, const int* keys, int count, int* results) {
+    apply_keys(list, LIST_OP_INSERT, keys, count, results);
+}
+
+static void Member_many(void* list, const int* keys, int count, int* results) {
+    apply_keys(list, LIST_OP_MEMBER, keys, count, results);
+}
+
+static void Delete_many(void* list, const int* keys, int count, int* results) {
+    apply_keys(list, LIST_OP_DELETE, keys, count, results);
+}
+
+const list_engine_t coarse_list_engine = {
+    "list", 1, List_create, List_destroy, Insert, Member, Delete,
+    Insert_many, Member_many, Delete_many
+};
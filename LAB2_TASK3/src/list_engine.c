@@ -0,0 +1,21 @@
+/*
+ * list_engine.c - Реестр реализаций множества для выбора по имени
+ */
+
+#include <string.h>
+#include "list_engine.h"
+
+const list_engine_t* const list_engines[] = {
+    &coarse_list_engine, &hoh_list_engine, &harris_list_engine, &skiplist_engine, &hash_set_engine,
+    &fc_list_engine
+};
+const int list_engine_count = sizeof(list_engines) / sizeof(list_engines[0]);
+
+const list_engine_t* list_engine_find(const char* name) {
+    for (int i = 0; i < list_engine_count; i++) {
+        if (strcmp(list_engines[i]->name, name) == 0) {
+            return list_engines[i];
+        }
+    }
+    return NULL;
+}
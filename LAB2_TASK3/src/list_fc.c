@@ -0,0 +1,235 @@
+/*
+ * list_fc.c - Исходный список с flat combining для вставок и удалений
+ *
+ * Поиск идёт под rdlock выбранной реализации rwlock, как в "list".
+ * Вставка или удаление публикуется в слоте потока (FC_MAX_SLOTS слотов,
+ * каждый в своей строке кэша). Поток, захвативший флаг комбинатора,
+ * собирает запросы всех слотов, сортирует их по ключу и применяет одним
+ * проходом coarse_list_apply под одним wrlock; остальные потоки только
+ * ждут, пока их слот не обнулится. Вместо передачи wrlock от писателя
+ * к писателю блокировка берётся один раз на пакет запросов.
+ *
+ * Поток получает слот при первой операции с множеством и помнит его
+ * для последнего множества; когда слоты кончились, поток выполняет
+ * свои операции сам, как комбинатор без чужих запросов.
+ */
+
+#include <stdlib.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "my_futex.h"
+#include "list_engine.h"
+
+#define FC_MAX_SLOTS      64
+#define FC_CACHE_LINE     64
+#define FC_SPIN_BEFORE_YIELD 128   /* Проверок слота до sched_yield */
+
+typedef struct {
+    _Alignas(FC_CACHE_LINE) atomic_int pending;   /* 1 - запрос ждёт комбинатора */
+    list_op_t req;
+} fc_slot_t;
+
+typedef struct {
+    fc_slot_t            slots[FC_MAX_SLOTS];
+    atomic_int           slot_count;     /* Выданные слоты (может превысить FC_MAX_SLOTS) */
+    atomic_int           combining;      /* Флаг комбинатора */
+    unsigned             id;             /* Номер множества для слота потока */
+    const rwlock_impl_t* lock;
+    void*                rwlock;         /* rdlock - поиск, wrlock - проход комбинатора */
+    void*                list;           /* Исходный список (coarse_list_engine) */
+} fc_list_t;
+
+static atomic_uint next_list_id = 1;
+static _Thread_local unsigned   my_list_id = 0;
+static _Thread_local fc_slot_t* my_slot = NULL;
+
+static void* fc_create(const rwlock_impl_t* lock) {
+    fc_list_t* fc = (fc_list_t*)aligned_alloc(FC_CACHE_LINE, sizeof(fc_list_t));
+
+    for (int i = 0; i < FC_MAX_SLOTS; i++) {
+        atomic_init(&fc->slots[i].pending, 0);
+    }
+    atomic_init(&fc->slot_count, 0);
+    atomic_init(&fc->combining, 0);
+    fc->id = atomic_fetch_add(&next_list_id, 1);
+    fc->lock = lock;
+    fc->rwlock = rwlock_impl_new(lock, 1);
+    fc->list = coarse_list_engine.create(lock);
+    return fc;
+}
+
+static void fc_destroy(void* list) {
+    fc_list_t* fc = (fc_list_t*)list;
+
+    coarse_list_engine.destroy(fc->list);
+    rwlock_impl_free(fc->lock, fc->rwlock, 1);
+    free(fc);
+}
+
+/*-----------------------------------------------------------------*/
+static fc_slot_t* get_slot(fc_list_t* fc) {
+    int i;
+
+    if (my_list_id != fc->id) {
+        i = atomic_fetch_add(&fc->slot_count, 1);
+        my_list_id = fc->id;
+        my_slot = i < FC_MAX_SLOTS ? &fc->slots[i] : NULL;
+    }
+    return my_slot;
+}
+
+static int try_combine(fc_list_t* fc) {
+    return atomic_load_explicit(&fc->combining, memory_order_relaxed) == 0 &&
+           atomic_exchange_explicit(&fc->combining, 1, memory_order_acquire) == 0;
+}
+
+static void lock_combine(fc_list_t* fc) {
+    int spins = 0;
+
+    while (!try_combine(fc)) {
+        if (++spins < FC_SPIN_BEFORE_YIELD) {
+            cpu_relax();
+        } else {
+            spins = 0;
+            sched_yield();
+        }
+    }
+}
+
+static void unlock_combine(fc_list_t* fc) {
+    atomic_store_explicit(&fc->combining, 0, memory_order_release);
+}
+
+/*
+ * Проход комбинатора: own - операции вызывающего потока, к ним добавляются
+ * запросы всех слотов; всё применяется одним проходом под wrlock, затем
+ * слоты обнуляются (release - результат виден ждущему потоку)
+ */
+static void combine(fc_list_t* fc, list_op_t* const* own, int own_count) {
+    list_op_t* ops[LIST_BATCH_MAX + FC_MAX_SLOTS];
+    fc_slot_t* served[FC_MAX_SLOTS];
+    int count = 0, served_count = 0;
+    int slots = atomic_load(&fc->slot_count);
+
+    if (slots > FC_MAX_SLOTS) slots = FC_MAX_SLOTS;
+    for (int i = 0; i < own_count; i++) {
+        ops[count++] = own[i];
+    }
+    for (int i = 0; i < slots; i++) {
+        if (atomic_load_explicit(&fc->slots[i].pending, memory_order_acquire)) {
+            ops[count++] = &fc->slots[i].req;
+            served[served_count++] = &fc->slots[i];
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+
+    list_ops_sort(ops, count);
+    fc->lock->wrlock(fc->rwlock);
+    coarse_list_apply(fc->list, ops, count);
+    fc->lock->unlock(fc->rwlock);
+
+    for (int i = 0; i < served_count; i++) {
+        atomic_store_explicit(&served[i]->pending, 0, memory_order_release);
+    }
+}
+
+/* Одна вставка или удаление через слот потока */
+static int fc_execute(fc_list_t* fc, int kind, int value) {
+    fc_slot_t* slot = get_slot(fc);
+    list_op_t req;
+    list_op_t* own = &req;
+    int spins = 0;
+
+    if (slot == NULL) {
+        req.key = value;
+        req.op = kind;
+        lock_combine(fc);
+        combine(fc, &own, 1);
+        unlock_combine(fc);
+        return req.result;
+    }
+
+    slot->req.key = value;
+    slot->req.op = kind;
+    atomic_store_explicit(&slot->pending, 1, memory_order_release);
+
+    while (atomic_load_explicit(&slot->pending, memory_order_acquire)) {
+        if (try_combine(fc)) {
+            /* Свой запрос уже в слоте - проход его выполнит */
+            combine(fc, NULL, 0);
+            unlock_combine(fc);
+        } else if (++spins < FC_SPIN_BEFORE_YIELD) {
+            cpu_relax();
+        } else {
+            spins = 0;
+            sched_yield();
+        }
+    }
+    return slot->req.result;
+}
+
+static int fc_insert(void* list, int value) {
+    return fc_execute((fc_list_t*)list, LIST_OP_INSERT, value);
+}
+
+static int fc_delete(void* list, int value) {
+    return fc_execute((fc_list_t*)list, LIST_OP_DELETE, value);
+}
+
+static int fc_member(void* list, int value) {
+    fc_list_t* fc = (fc_list_t*)list;
+    int rv;
+
+    fc->lock->rdlock(fc->rwlock);
+    rv = coarse_list_engine.member(fc->list, value);
+    fc->lock->unlock(fc->rwlock);
+    return rv;
+}
+
+/*-----------------------------------------------------------------*/
+/* Пакет вставок или удалений: поток сам становится комбинатором */
+static void fc_execute_many(fc_list_t* fc, int kind, const int* keys, int count, int* results) {
+    list_op_t ops[LIST_BATCH_MAX];
+    list_op_t* own[LIST_BATCH_MAX];
+
+    for (int base = 0; base < count; base += LIST_BATCH_MAX) {
+        int n = count - base < LIST_BATCH_MAX ? count - base : LIST_BATCH_MAX;
+
+        for (int i = 0; i < n; i++) {
+            ops[i].key = keys[base + i];
+            ops[i].op = kind;
+            own[i] = &ops[i];
+        }
+        lock_combine(fc);
+        combine(fc, own, n);
+        unlock_combine(fc);
+        if (results != NULL) {
+            for (int i = 0; i < n; i++) {
+                results[base + i] = ops[i].result;
+            }
+        }
+    }
+}
+
+static void fc_insert_many(void* list, const int* keys, int count, int* results) {
+    fc_execute_many((fc_list_t*)list, LIST_OP_INSERT, keys, count, results);
+}
+
+static void fc_delete_many(void* list, const int* keys, int count, int* results) {
+    fc_execute_many((fc_list_t*)list, LIST_OP_DELETE, keys, count, results);
+}
+
+static void fc_member_many(void* list, const int* keys, int count, int* results) {
+    fc_list_t* fc = (fc_list_t*)list;
+
+    fc->lock->rdlock(fc->rwlock);
+    coarse_list_engine.member_many(fc->list, keys, count, results);
+    fc->lock->unlock(fc->rwlock);
+}
+
+const list_engine_t fc_list_engine = {
+    "fc", 0, fc_create, fc_destroy, fc_insert, fc_member, fc_delete,
+    fc_insert_many, fc_member_many, fc_delete_many
+};
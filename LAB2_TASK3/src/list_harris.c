@@ -0,0 +1,207 @@
+/*
+ * list_harris.c - Lock-free отсортированный список Harris-Michael
+ *
+ * Удаление в два шага:
+ * 1. Логическое - младший бит поля next удаляемого узла помечается CAS-ом,
+ *    после этого вставка за этим узлом невозможна
+ * 2. Физическое - CAS в поле next предшественника исключает узел из списка
+ *    (делает удаляющий поток или любой поиск, встретивший помеченный узел)
+ *
+ * Исключённый узел освобождается через epoch_retire: потоки, ещё идущие
+ * по нему, находятся внутри epoch_enter/epoch_exit. Узлы берутся из пула
+ * node_pool, и освобождение после эпохи возвращает узел в кэш потока,
+ * который его исключил.
+ *
+ * member не изменяет список и не повторяет проход (wait-free).
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include "epoch.h"
+#include "node_pool.h"
+#include "list_engine.h"
+
+struct harris_node_s {
+    epoch_entry_t       entry;  /* Первое поле: epoch_entry_t* приводится к узлу */
+    int                 data;
+    _Atomic(uintptr_t)  next;   /* Указатель на следующий узел | бит удаления */
+};
+
+typedef struct {
+    struct harris_node_s* head;
+    node_pool_t*          pool;
+} harris_list_t;
+
+#define MARK ((uintptr_t)1)
+
+static inline struct harris_node_s* ptr(uintptr_t link) {
+    return (struct harris_node_s*)(link & ~MARK);
+}
+
+static inline int marked(uintptr_t link) {
+    return (int)(link & MARK);
+}
+
+static struct harris_node_s* new_node(node_pool_t* pool, int value, struct harris_node_s* next) {
+    struct harris_node_s* node = (struct harris_node_s*)node_pool_alloc(pool);
+    node->data = value;
+    atomic_init(&node->next, (uintptr_t)next);
+    return node;
+}
+
+static void free_node(epoch_entry_t* entry) {
+    node_pool_free(entry);
+}
+
+static void* harris_create(const rwlock_impl_t* lock) {
+    (void)lock;
+    harris_list_t* hl = (harris_list_t*)malloc(sizeof(harris_list_t));
+    hl->pool = node_pool_create(sizeof(struct harris_node_s));
+    hl->head = new_node(hl->pool, INT_MIN, new_node(hl->pool, INT_MAX, NULL));
+    return hl;
+}
+
+static void harris_destroy(void* list) {
+    harris_list_t* hl = (harris_list_t*)list;
+    struct harris_node_s* curr = hl->head;
+    struct harris_node_s* following;
+
+    while (curr != NULL) {
+        following = ptr(atomic_load(&curr->next));
+        node_pool_free(curr);
+        curr = following;
+    }
+    /* Отложенные узлы возвращаются в пул до его уничтожения */
+    epoch_drain();
+    node_pool_destroy(hl->pool);
+    free(hl);
+}
+
+/*
+ * Поиск первого непомеченного узла с data >= value
+ *
+ * По пути исключает помеченные узлы. *pred_link_p - поле next предшественника,
+ * в которое вставляется новый узел или пишется CAS при удалении.
+ */
+static struct harris_node_s* harris_find(struct harris_node_s* head, int value,
+                                         _Atomic(uintptr_t)** pred_link_p) {
+    _Atomic(uintptr_t)* pred_link;
+    struct harris_node_s* curr;
+    uintptr_t succ, expected;
+
+retry:
+    pred_link = &head->next;
+    curr = ptr(atomic_load(pred_link));
+    for (;;) {
+        succ = atomic_load(&curr->next);
+        if (marked(succ)) {
+            /* curr удалён логически - исключаем его из списка */
+            expected = (uintptr_t)curr;
+            if (!atomic_compare_exchange_strong(pred_link, &expected, (uintptr_t)ptr(succ))) {
+                goto retry;
+            }
+            epoch_retire(&curr->entry, free_node);
+            curr = ptr(succ);
+            continue;
+        }
+        if (curr->data >= value) {
+            *pred_link_p = pred_link;
+            return curr;
+        }
+        pred_link = &curr->next;
+        curr = ptr(succ);
+    }
+}
+
+static int harris_insert(void* list, int value) {
+    harris_list_t* hl = (harris_list_t*)list;
+    _Atomic(uintptr_t)* pred_link;
+    struct harris_node_s* curr;
+    struct harris_node_s* node = NULL;
+    uintptr_t expected;
+    int rv = 1;
+
+    epoch_enter();
+    for (;;) {
+        curr = harris_find(hl->head, value, &pred_link);
+        if (curr->data == value) {
+            rv = 0;  /* Значение уже в списке */
+            break;
+        }
+        if (node == NULL) {
+            node = new_node(hl->pool, value, curr);
+        } else {
+            atomic_store_explicit(&node->next, (uintptr_t)curr, memory_order_relaxed);
+        }
+        expected = (uintptr_t)curr;
+        if (atomic_compare_exchange_strong(pred_link, &expected, (uintptr_t)node)) {
+            node = NULL;
+            break;
+        }
+    }
+    epoch_exit();
+
+    /* Узел не попал в список и никому не виден */
+    node_pool_free(node);
+    return rv;
+}
+
+static int harris_member(void* list, int value) {
+    struct harris_node_s* curr = ((harris_list_t*)list)->head;
+    uintptr_t succ;
+    int rv;
+
+    epoch_enter();
+    succ = atomic_load(&curr->next);
+    while (curr->data < value) {
+        curr = ptr(succ);
+        succ = atomic_load(&curr->next);
+    }
+    rv = curr->data == value && !marked(succ);
+    epoch_exit();
+
+    return rv;
+}
+
+static int harris_delete(void* list, int value) {
+    struct harris_node_s* head = ((harris_list_t*)list)->head;
+    _Atomic(uintptr_t)* pred_link;
+    struct harris_node_s* curr;
+    uintptr_t succ, expected;
+    int rv = 0;
+
+    epoch_enter();
+    for (;;) {
+        curr = harris_find(head, value, &pred_link);
+        if (curr->data != value) {
+            break;  /* Значение не найдено */
+        }
+
+        /* Логическое удаление: побеждает тот, кто первым пометил next */
+        succ = atomic_load(&curr->next);
+        if (marked(succ) ||
+            !atomic_compare_exchange_strong(&curr->next, &succ, succ | MARK)) {
+            continue;
+        }
+        rv = 1;
+
+        /* Физическое удаление; при неудаче узел исключит повторный поиск */
+        expected = (uintptr_t)curr;
+        if (atomic_compare_exchange_strong(pred_link, &expected, succ)) {
+            epoch_retire(&curr->entry, free_node);
+        } else {
+            harris_find(head, value, &pred_link);
+        }
+        break;
+    }
+    epoch_exit();
+
+    return rv;
+}
+
+const list_engine_t harris_list_engine = {
+    "harris", 0, harris_create, harris_destroy, harris_insert, harris_member, harris_delete,
+    NULL, NULL, NULL
+};
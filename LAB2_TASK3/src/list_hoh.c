@@ -0,0 +1,138 @@
+/*
+ * list_hoh.c - Отсортированный список с блокировкой на каждом узле
+ *
+ * Проход идёт "из рук в руки" (hand-over-hand): следующий узел блокируется
+ * до освобождения текущего, поэтому поток всегда держит pred и curr.
+ * Вставка и удаление блокируют только два соседних узла, и операции
+ * в разных частях списка не мешают друг другу.
+ *
+ * Сторожевые узлы head (INT_MIN) и tail (INT_MAX) избавляют от проверок на NULL.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include "node_pool.h"
+#include "list_engine.h"
+
+struct hoh_node_s {
+    int    data;
+    struct hoh_node_s* next;
+    pthread_mutex_t    mutex;
+};
+
+typedef struct {
+    struct hoh_node_s* head;
+    node_pool_t*       pool;
+} hoh_list_t;
+
+static struct hoh_node_s* new_node(node_pool_t* pool, int value, struct hoh_node_s* next) {
+    struct hoh_node_s* node = (struct hoh_node_s*)node_pool_alloc(pool);
+    node->data = value;
+    node->next = next;
+    pthread_mutex_init(&node->mutex, NULL);
+    return node;
+}
+
+static void free_node(struct hoh_node_s* node) {
+    pthread_mutex_destroy(&node->mutex);
+    node_pool_free(node);
+}
+
+static void* hoh_create(const rwlock_impl_t* lock) {
+    (void)lock;
+    hoh_list_t* hl = (hoh_list_t*)malloc(sizeof(hoh_list_t));
+    hl->pool = node_pool_create(sizeof(struct hoh_node_s));
+    hl->head = new_node(hl->pool, INT_MIN, new_node(hl->pool, INT_MAX, NULL));
+    return hl;
+}
+
+static void hoh_destroy(void* list) {
+    hoh_list_t* hl = (hoh_list_t*)list;
+    struct hoh_node_s* curr = hl->head;
+    struct hoh_node_s* following;
+
+    while (curr != NULL) {
+        following = curr->next;
+        free_node(curr);
+        curr = following;
+    }
+    node_pool_destroy(hl->pool);
+    free(hl);
+}
+
+/*
+ * Поиск первого узла с data >= value
+ * Возвращает заблокированные pred и curr
+ */
+static void hoh_find(struct hoh_node_s* head, int value,
+                     struct hoh_node_s** pred_p, struct hoh_node_s** curr_p) {
+    struct hoh_node_s* pred = head;
+    struct hoh_node_s* curr;
+
+    pthread_mutex_lock(&pred->mutex);
+    curr = pred->next;
+    pthread_mutex_lock(&curr->mutex);
+    while (curr->data < value) {
+        pthread_mutex_unlock(&pred->mutex);
+        pred = curr;
+        curr = curr->next;
+        pthread_mutex_lock(&curr->mutex);
+    }
+
+    *pred_p = pred;
+    *curr_p = curr;
+}
+
+static int hoh_insert(void* list, int value) {
+    hoh_list_t* hl = (hoh_list_t*)list;
+    struct hoh_node_s *pred, *curr;
+    int rv = 1;
+
+    hoh_find(hl->head, value, &pred, &curr);
+    if (curr->data > value) {
+        pred->next = new_node(hl->pool, value, curr);
+    } else {
+        rv = 0;  /* Значение уже в списке */
+    }
+    pthread_mutex_unlock(&curr->mutex);
+    pthread_mutex_unlock(&pred->mutex);
+
+    return rv;
+}
+
+static int hoh_member(void* list, int value) {
+    struct hoh_node_s *pred, *curr;
+    int rv;
+
+    hoh_find(((hoh_list_t*)list)->head, value, &pred, &curr);
+    rv = curr->data == value;
+    pthread_mutex_unlock(&curr->mutex);
+    pthread_mutex_unlock(&pred->mutex);
+
+    return rv;
+}
+
+static int hoh_delete(void* list, int value) {
+    struct hoh_node_s *pred, *curr;
+
+    hoh_find(((hoh_list_t*)list)->head, value, &pred, &curr);
+    if (curr->data != value) {
+        pthread_mutex_unlock(&curr->mutex);
+        pthread_mutex_unlock(&pred->mutex);
+        return 0;  /* Значение не найдено */
+    }
+
+    /* До curr можно добраться только через заблокированный pred */
+    pred->next = curr->next;
+    pthread_mutex_unlock(&curr->mutex);
+    pthread_mutex_unlock(&pred->mutex);
+    free_node(curr);
+
+    return 1;
+}
+
+const list_engine_t hoh_list_engine = {
+    "hoh", 0, hoh_create, hoh_destroy, hoh_insert, hoh_member, hoh_delete,
+    NULL, NULL, NULL
+};
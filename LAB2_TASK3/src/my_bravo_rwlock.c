@@ -0,0 +1,178 @@
+/*
+ * my_bravo_rwlock.c - rwlock с распределённым индикатором читателей (BRAVO)
+ *
+ * Быстрый путь читателя: CAS своего слота и проверка reader_bias.
+ * Общая строка кэша не изменяется, поэтому при 80% поисков читатели
+ * разных ядер не мешают друг другу.
+ *
+ * Медленный путь (смещение выключено, слот занят другим потоком с тем же
+ * номером слота) - обычный my_futex_rwlock_t.
+ */
+
+#include <time.h>
+#include <sched.h>
+#include <errno.h>
+#include "my_bravo_rwlock.h"
+
+/* Номер потока для выбора слота: выдаётся при первом обращении, 0 не используется */
+static atomic_uint next_thread_token = 1;
+static _Thread_local unsigned thread_token = 0;
+
+static unsigned my_token(void) {
+    if (thread_token == 0) {
+        thread_token = atomic_fetch_add(&next_thread_token, 1);
+    }
+    return thread_token;
+}
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+/*
+ * Инициализация rwlock
+ */
+int my_bravo_rwlock_init(my_bravo_rwlock_t* rwlock) {
+    int rc;
+
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    rc = my_futex_rwlock_init(&rwlock->underlying);
+    if (rc != 0) {
+        return rc;
+    }
+
+    atomic_init(&rwlock->reader_bias, 1);
+    atomic_init(&rwlock->inhibit_until, 0);
+    for (int i = 0; i < BRAVO_SLOTS; i++) {
+        atomic_init(&rwlock->slots[i].owner, 0);
+    }
+
+    return 0;
+}
+
+/*
+ * Уничтожение rwlock
+ */
+int my_bravo_rwlock_destroy(my_bravo_rwlock_t* rwlock) {
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    for (int i = 0; i < BRAVO_SLOTS; i++) {
+        if (atomic_load(&rwlock->slots[i].owner) != 0) {
+            return EBUSY;
+        }
+    }
+
+    return my_futex_rwlock_destroy(&rwlock->underlying);
+}
+
+/*
+ * Получение блокировки на чтение (Read Lock)
+ *
+ * Алгоритм:
+ * 1. Если reader_bias включён - занять свой слот и перепроверить reader_bias
+ *    (писатель мог снять смещение между проверкой и занятием слота)
+ * 2. Иначе - rdlock базовой блокировки; если пауза после снятия смещения
+ *    закончилась, снова включить reader_bias (писателей сейчас нет)
+ */
+int my_bravo_rwlock_rdlock(my_bravo_rwlock_t* rwlock) {
+    unsigned token, free_slot = 0;
+    my_bravo_slot_t* slot;
+    int rc;
+
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    if (atomic_load_explicit(&rwlock->reader_bias, memory_order_relaxed)) {
+        token = my_token();
+        slot = &rwlock->slots[token % BRAVO_SLOTS];
+        if (atomic_compare_exchange_strong(&slot->owner, &free_slot, token)) {
+            if (atomic_load(&rwlock->reader_bias)) {
+                return 0;
+            }
+            /* Смещение снято - освобождаем слот, писатель его ждёт */
+            atomic_store_explicit(&slot->owner, 0, memory_order_release);
+        }
+    }
+
+    rc = my_futex_rwlock_rdlock(&rwlock->underlying);
+    if (rc != 0) {
+        return rc;
+    }
+
+    if (!atomic_load_explicit(&rwlock->reader_bias, memory_order_relaxed) &&
+        now_ns() >= atomic_load_explicit(&rwlock->inhibit_until, memory_order_relaxed)) {
+        atomic_store(&rwlock->reader_bias, 1);
+    }
+
+    return 0;
+}
+
+/*
+ * Получение блокировки на запись (Write Lock)
+ *
+ * Алгоритм:
+ * 1. wrlock базовой блокировки (исключает читателей медленного пути и писателей)
+ * 2. Если reader_bias включён - снять его и дождаться, пока читатели
+ *    освободят все слоты
+ * 3. Выключить смещение на BRAVO_INHIBIT_FACTOR длительностей шага 2
+ */
+int my_bravo_rwlock_wrlock(my_bravo_rwlock_t* rwlock) {
+    unsigned long long start, finish;
+    int rc;
+
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    rc = my_futex_rwlock_wrlock(&rwlock->underlying);
+    if (rc != 0) {
+        return rc;
+    }
+
+    if (atomic_load_explicit(&rwlock->reader_bias, memory_order_relaxed)) {
+        atomic_store(&rwlock->reader_bias, 0);
+        start = now_ns();
+        for (int i = 0; i < BRAVO_SLOTS; i++) {
+            while (atomic_load(&rwlock->slots[i].owner) != 0) {
+                sched_yield();
+            }
+        }
+        finish = now_ns();
+        atomic_store_explicit(&rwlock->inhibit_until, finish + (finish - start) * BRAVO_INHIBIT_FACTOR,
+                              memory_order_relaxed);
+    }
+
+    return 0;
+}
+
+/*
+ * Освобождение блокировки (Unlock)
+ *
+ * Если слот потока занят им самим - это читатель быстрого пути, освобождаем слот.
+ * Иначе блокировка взята через underlying, тип определяет my_futex_rwlock_unlock.
+ */
+int my_bravo_rwlock_unlock(my_bravo_rwlock_t* rwlock) {
+    unsigned token;
+    my_bravo_slot_t* slot;
+
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    token = my_token();
+    slot = &rwlock->slots[token % BRAVO_SLOTS];
+    if (atomic_load_explicit(&slot->owner, memory_order_relaxed) == token) {
+        atomic_store_explicit(&slot->owner, 0, memory_order_release);
+        return 0;
+    }
+
+    return my_futex_rwlock_unlock(&rwlock->underlying);
+}
@@ -0,0 +1,184 @@
+/*
+ * my_futex_rwlock.c - Блокировка чтения-записи на атомарном слове и futex
+ *
+ * В отличие от my_rwlock.c, где каждая операция захватывает общий mutex,
+ * здесь всё состояние лежит в одном 32-битном слове:
+ * - без конкуренции rdlock/wrlock/unlock - одна атомарная операция
+ * - в ядро поток уходит только когда действительно нужно ждать
+ *
+ * Политика: Writer-preference (приоритет писателей)
+ * - Ожидающий писатель увеличивает счётчик в state, и новые читатели
+ *   засыпают, пока счётчик не обнулится
+ * - Освобождение сначала передаёт блокировку писателю, читателей будит
+ *   только когда ожидающих писателей не осталось
+ */
+
+#include <limits.h>
+#include <errno.h>
+#include "my_futex.h"
+#include "my_futex_rwlock.h"
+
+#define READER_MASK     0x000FFFFFu  /* Число активных читателей */
+#define WRITER          0x00100000u  /* Писатель держит блокировку */
+#define WAITER_UNIT     0x00200000u  /* Один ожидающий писатель */
+#define WAITER_MASK     0x7FE00000u  /* Число ожидающих писателей */
+#define READERS_PARKED  0x80000000u  /* Есть спящие читатели */
+
+/*
+ * Пробуждение одного ожидающего писателя
+ *
+ * Писатель читает writer_seq до проверки state, поэтому увеличение
+ * счётчика после освобождения state не даёт ему уснуть с устаревшим значением.
+ */
+static void wake_writer(my_futex_rwlock_t* rwlock) {
+    atomic_fetch_add(&rwlock->writer_seq, 1);
+    futex_wake(&rwlock->writer_seq, 1);
+}
+
+/*
+ * Инициализация rwlock
+ */
+int my_futex_rwlock_init(my_futex_rwlock_t* rwlock) {
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    atomic_init(&rwlock->state, 0);
+    atomic_init(&rwlock->writer_seq, 0);
+
+    return 0;
+}
+
+/*
+ * Уничтожение rwlock
+ *
+ * Ресурсов ядра нет, проверяется только, что блокировка свободна
+ */
+int my_futex_rwlock_destroy(my_futex_rwlock_t* rwlock) {
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    if ((atomic_load(&rwlock->state) & ~READERS_PARKED) != 0) {
+        return EBUSY;
+    }
+
+    return 0;
+}
+
+/*
+ * Получение блокировки на чтение (Read Lock)
+ *
+ * Алгоритм:
+ * 1. Если нет писателя и ожидающих писателей - CAS увеличивает число читателей
+ * 2. Иначе выставить READERS_PARKED и уснуть на state, пока слово не изменится
+ * 3. После пробуждения повторить с шага 1
+ */
+int my_futex_rwlock_rdlock(my_futex_rwlock_t* rwlock) {
+    unsigned s;
+
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    s = atomic_load_explicit(&rwlock->state, memory_order_relaxed);
+    for (;;) {
+        if ((s & (WRITER | WAITER_MASK)) == 0) {
+            if (atomic_compare_exchange_weak_explicit(&rwlock->state, &s, s + 1,
+                                                      memory_order_acquire, memory_order_relaxed)) {
+                return 0;
+            }
+            continue;
+        }
+
+        /* Писатель активен или ждёт - засыпаем до изменения state */
+        if ((s & READERS_PARKED) == 0 &&
+            !atomic_compare_exchange_weak_explicit(&rwlock->state, &s, s | READERS_PARKED,
+                                                   memory_order_relaxed, memory_order_relaxed)) {
+            continue;
+        }
+        futex_wait(&rwlock->state, s | READERS_PARKED);
+        s = atomic_load_explicit(&rwlock->state, memory_order_relaxed);
+    }
+}
+
+/*
+ * Получение блокировки на запись (Write Lock)
+ *
+ * Алгоритм:
+ * 1. Если state == 0 - CAS сразу выставляет WRITER
+ * 2. Иначе зарегистрироваться в счётчике ожидающих писателей
+ *    (с этого момента новые читатели не входят)
+ * 3. Ждать на writer_seq, пока не уйдут читатели и активный писатель
+ * 4. Одним CAS убрать себя из ожидающих и выставить WRITER
+ */
+int my_futex_rwlock_wrlock(my_futex_rwlock_t* rwlock) {
+    unsigned s = 0;
+    unsigned seq;
+
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    if (atomic_compare_exchange_strong_explicit(&rwlock->state, &s, WRITER,
+                                                memory_order_acquire, memory_order_relaxed)) {
+        return 0;
+    }
+
+    atomic_fetch_add(&rwlock->state, WAITER_UNIT);
+    for (;;) {
+        seq = atomic_load(&rwlock->writer_seq);
+        s = atomic_load(&rwlock->state);
+        while ((s & (READER_MASK | WRITER)) == 0) {
+            if (atomic_compare_exchange_weak(&rwlock->state, &s, s - WAITER_UNIT + WRITER)) {
+                return 0;
+            }
+        }
+        futex_wait(&rwlock->writer_seq, seq);
+    }
+}
+
+/*
+ * Освобождение блокировки (Unlock)
+ *
+ * Тип блокировки определяется по биту WRITER, как в my_rwlock.c:
+ * - Писатель снимает WRITER; если есть ожидающие писатели - будит одного,
+ *   иначе будит всех спящих читателей
+ * - Читатель уменьшает счётчик; последний читатель будит писателя
+ */
+int my_futex_rwlock_unlock(my_futex_rwlock_t* rwlock) {
+    unsigned s, next;
+
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    s = atomic_load_explicit(&rwlock->state, memory_order_relaxed);
+    if (s & WRITER) {
+        /* Писатель освобождает блокировку */
+        do {
+            next = s & ~WRITER;
+            if ((next & WAITER_MASK) == 0) {
+                next &= ~READERS_PARKED;
+            }
+        } while (!atomic_compare_exchange_weak(&rwlock->state, &s, next));
+
+        /* Приоритет писателям: если есть ожидающие писатели - будим одного */
+        if (next & WAITER_MASK) {
+            wake_writer(rwlock);
+        } else if (s & READERS_PARKED) {
+            /* Иначе будим всех читателей */
+            futex_wake(&rwlock->state, INT_MAX);
+        }
+    } else {
+        /* Читатель освобождает блокировку */
+        s = atomic_fetch_sub(&rwlock->state, 1);
+
+        /* Последний читатель передаёт блокировку ожидающему писателю */
+        if ((s & READER_MASK) == 1 && (s & WAITER_MASK)) {
+            wake_writer(rwlock);
+        }
+    }
+
+    return 0;
+}
@@ -8,11 +8,129 @@
  * Политика: Writer-preference (приоритет писателей)
  * - Если есть ожидающие писатели, новые читатели блокируются
  * - Это предотвращает голодание писателей при высокой нагрузке чтения
+ *
+ * Перед pthread_cond_wait поток может ждать активно (MY_RWLOCK_SPIN,
+ * MY_RWLOCK_ADAPTIVE): под мьютексом условие ожидания копируется в
+ * reader_blocked/writer_blocked, и поток крутится на копии, не держа мьютекс.
+ * Копия - только подсказка: после спина условие перепроверяется под мьютексом.
+ *
+ * С -DRWLOCK_STATS rdlock/wrlock считают захваты, пробуждения и время
+ * ожидания (rwlock_stats.h); без флага макросы статистики пустые.
  */
 
 #include <stdlib.h>
 #include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include "my_futex.h"
 #include "my_rwlock.h"
+#include "rwlock_stats.h"
+#include "timer.h"
+
+#define SPIN_BEFORE_YIELD  128     /* Итераций спина до sched_yield (MY_RWLOCK_SPIN) */
+#define SPIN_CLOCK_EVERY   32      /* Итераций спина между чтениями часов (adaptive) */
+#define SPIN_MIN_NS        500     /* Границы бюджета спина (adaptive) */
+#define SPIN_MAX_NS        20000   /* Дольше засыпание дешевле спина */
+#define HOLD_EWMA_SHIFT    3       /* Вес нового замера удержания - 1/8 */
+#define HOLD_SAMPLE_EVERY  8       /* Замеряется каждое 8-е удержание */
+
+#define READER_BLOCKED(rw) ((rw)->writer_active || (rw)->waiting_writers > 0)
+#define WRITER_BLOCKED(rw) ((rw)->active_readers > 0 || (rw)->writer_active)
+
+static long online_cpus = 0;
+
+/*
+ * Обновление копий условий ожидания для спина; вызывается под мьютексом
+ * после каждого изменения счётчиков
+ */
+static void update_hints(my_rwlock_t* rwlock) {
+    atomic_store_explicit(&rwlock->reader_blocked, READER_BLOCKED(rwlock), memory_order_relaxed);
+    atomic_store_explicit(&rwlock->writer_blocked, WRITER_BLOCKED(rwlock), memory_order_relaxed);
+}
+
+/*
+ * Начало и конец удержания (фаза писателя или непрерывная фаза читателей)
+ * Замеряется каждое HOLD_SAMPLE_EVERY-е удержание: два чтения часов на
+ * каждом захвате заметно удлиняют короткие критические секции
+ */
+static void hold_begin(my_rwlock_t* rwlock) {
+    rwlock->hold_start = 0;
+    if (rwlock->wait_mode == MY_RWLOCK_ADAPTIVE && online_cpus > 1 &&
+        ++rwlock->hold_count % HOLD_SAMPLE_EVERY == 0) {
+        GET_TIME_NS(rwlock->hold_start);
+    }
+}
+
+static void hold_end(my_rwlock_t* rwlock) {
+    uint64_t now, sample;
+    unsigned avg;
+
+    if (rwlock->hold_start == 0) {
+        return;
+    }
+    GET_TIME_NS(now);
+    sample = now - rwlock->hold_start;
+    if (sample > UINT32_MAX) sample = UINT32_MAX;
+    avg = atomic_load_explicit(&rwlock->hold_ns, memory_order_relaxed);
+    avg = (unsigned)((int64_t)avg + (((int64_t)sample - (int64_t)avg) >> HOLD_EWMA_SHIFT));
+    atomic_store_explicit(&rwlock->hold_ns, avg, memory_order_relaxed);
+}
+
+/*
+ * Активное ожидание, пока *blocked не обнулится; вызывается без мьютекса
+ *
+ * MY_RWLOCK_SPIN: без ограничения, после SPIN_BEFORE_YIELD итераций - sched_yield
+ * MY_RWLOCK_ADAPTIVE: не дольше двух средних удержаний (в пределах
+ *   SPIN_MIN_NS..SPIN_MAX_NS); при среднем удержании дольше SPIN_MAX_NS
+ *   или одном процессоре спин бесполезен, adaptive_budget() возвращает 0
+ *
+ * Возвращает 1, если условие снялось, 0 - если бюджет исчерпан
+ */
+static uint64_t adaptive_budget(my_rwlock_t* rwlock) {
+    uint64_t budget = 2ull * atomic_load_explicit(&rwlock->hold_ns, memory_order_relaxed);
+
+    if (online_cpus < 2 || budget > 2 * SPIN_MAX_NS) return 0;
+    if (budget < SPIN_MIN_NS) return SPIN_MIN_NS;
+    return budget > SPIN_MAX_NS ? SPIN_MAX_NS : budget;
+}
+
+static int spin_wait(my_rwlock_t* rwlock, atomic_int* blocked, uint64_t budget) {
+    uint64_t start, now;
+    int spins = 0;
+
+    if (rwlock->wait_mode == MY_RWLOCK_SPIN) {
+        while (atomic_load_explicit(blocked, memory_order_relaxed)) {
+            if (++spins < SPIN_BEFORE_YIELD) {
+                cpu_relax();
+            } else {
+                spins = 0;
+                sched_yield();
+            }
+        }
+        return 1;
+    }
+
+    GET_TIME_NS(start);
+    while (atomic_load_explicit(blocked, memory_order_relaxed)) {
+        cpu_relax();
+        if (++spins % SPIN_CLOCK_EVERY == 0) {
+            GET_TIME_NS(now);
+            if (now - start > budget) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Пробуждение читателей после освобождения */
+static void wake_readers(my_rwlock_t* rwlock) {
+    if (rwlock->wake_mode == MY_RWLOCK_WAKE_CHAIN) {
+        pthread_cond_signal(&rwlock->readers_cv);
+    } else {
+        pthread_cond_broadcast(&rwlock->readers_cv);
+    }
+}
 
 /*
  * Инициализация rwlock
@@ -21,11 +139,24 @@
  * обнуляет все счётчики и флаги.
  */
 int my_rwlock_init(my_rwlock_t* rwlock) {
+    return my_rwlock_init_mode(rwlock, MY_RWLOCK_PARK, MY_RWLOCK_WAKE_BROADCAST);
+}
+
+/*
+ * Инициализация rwlock с режимами ожидания и пробуждения
+ */
+int my_rwlock_init_mode(my_rwlock_t* rwlock, int wait_mode, int wake_mode) {
     int rc;
     
-    if (rwlock == NULL) {
+    if (rwlock == NULL ||
+        (wait_mode != MY_RWLOCK_PARK && wait_mode != MY_RWLOCK_SPIN && wait_mode != MY_RWLOCK_ADAPTIVE) ||
+        (wake_mode != MY_RWLOCK_WAKE_BROADCAST && wake_mode != MY_RWLOCK_WAKE_CHAIN)) {
         return EINVAL;
     }
+
+    if (online_cpus == 0) {
+        online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    }
     
     /* Инициализация мьютекса */
     rc = pthread_mutex_init(&rwlock->mutex, NULL);
@@ -53,6 +184,13 @@ int my_rwlock_init(my_rwlock_t* rwlock) {
     rwlock->waiting_readers = 0;
     rwlock->waiting_writers = 0;
     rwlock->writer_active = 0;
+    rwlock->wait_mode = wait_mode;
+    rwlock->wake_mode = wake_mode;
+    atomic_init(&rwlock->reader_blocked, 0);
+    atomic_init(&rwlock->writer_blocked, 0);
+    atomic_init(&rwlock->hold_ns, 0);
+    rwlock->hold_start = 0;
+    rwlock->hold_count = 0;
     
     return 0;
 }
@@ -86,34 +224,70 @@ int my_rwlock_destroy(my_rwlock_t* rwlock) {
  * 
  * Алгоритм:
  * 1. Захватить mutex
- * 2. Увеличить счётчик ожидающих читателей
- * 3. Ждать, пока:
+ * 2. В режимах spin/adaptive: пока писатель активен или ждёт - отпустить
+ *    mutex и крутиться на reader_blocked (adaptive - в пределах бюджета)
+ * 3. Увеличить счётчик ожидающих читателей
+ * 4. Ждать, пока:
  *    - Нет активного писателя (writer_active == 0) И
  *    - Нет ожидающих писателей (waiting_writers == 0)
  *      (политика writer-preference)
- * 4. Уменьшить счётчик ожидающих, увеличить счётчик активных
- * 5. Освободить mutex
+ * 5. Уменьшить счётчик ожидающих, увеличить счётчик активных
+ *    (в режиме цепочки разбудить следующего ожидающего читателя)
+ * 6. Освободить mutex
  * 
  * Несколько читателей могут работать одновременно.
  */
 int my_rwlock_rdlock(my_rwlock_t* rwlock) {
+    uint64_t budget = 0;
+    RWLOCK_STATS_VAR(uint64_t t0; int waited = 0; int spun = 0;)
+
     if (rwlock == NULL) {
         return EINVAL;
     }
     
+    RWLOCK_STATS_NOW(t0);
     pthread_mutex_lock(&rwlock->mutex);
+
+    /* Активное ожидание вне мьютекса */
+    if (rwlock->wait_mode != MY_RWLOCK_PARK) {
+        while (READER_BLOCKED(rwlock) &&
+               (rwlock->wait_mode == MY_RWLOCK_SPIN || (budget = adaptive_budget(rwlock)) > 0)) {
+            RWLOCK_STATS_VAR(spun = 1;)
+            pthread_mutex_unlock(&rwlock->mutex);
+            int freed = spin_wait(rwlock, &rwlock->reader_blocked, budget);
+            pthread_mutex_lock(&rwlock->mutex);
+            if (!freed) break;
+        }
+    }
     
     rwlock->waiting_readers++;
     
     /* Ждём, пока нет активного писателя и нет ожидающих писателей */
-    while (rwlock->writer_active || rwlock->waiting_writers > 0) {
+    while (READER_BLOCKED(rwlock)) {
+        RWLOCK_STATS_VAR(waited = 1;)
         pthread_cond_wait(&rwlock->readers_cv, &rwlock->mutex);
+        RWLOCK_STATS_COUNT(STATS_CV_WAKEUPS);
+        RWLOCK_STATS_VAR(if (READER_BLOCKED(rwlock)) RWLOCK_STATS_COUNT(STATS_CV_SPURIOUS);)
     }
     
     rwlock->waiting_readers--;
     rwlock->active_readers++;
-    
+    if (rwlock->active_readers == 1) {
+        hold_begin(rwlock);
+    }
+
+    /* Цепочка: вошедший читатель будит следующего */
+    if (rwlock->wake_mode == MY_RWLOCK_WAKE_CHAIN && rwlock->waiting_readers > 0) {
+        pthread_cond_signal(&rwlock->readers_cv);
+    }
+
+    update_hints(rwlock);
     pthread_mutex_unlock(&rwlock->mutex);
+
+    RWLOCK_STATS_COUNT(STATS_RD_ACQUIRE);
+    RWLOCK_STATS_VAR(if (waited) RWLOCK_STATS_COUNT(STATS_RD_CONTENDED);)
+    RWLOCK_STATS_VAR(if (spun && !waited) RWLOCK_STATS_COUNT(STATS_SPIN_WINS);)
+    RWLOCK_STATS_SINCE(STATS_RD_WAIT, t0);
     
     return 0;
 }
@@ -123,34 +297,69 @@ int my_rwlock_rdlock(my_rwlock_t* rwlock) {
  * 
  * Алгоритм:
  * 1. Захватить mutex
- * 2. Увеличить счётчик ожидающих писателей
- * 3. Ждать, пока:
+ * 2. Увеличить счётчик ожидающих писателей (новые читатели перестают входить,
+ *    в том числе пока писатель крутится в режимах spin/adaptive)
+ * 3. В режимах spin/adaptive: отпустить mutex и крутиться на writer_blocked
+ * 4. Ждать, пока:
  *    - Нет активных читателей (active_readers == 0) И
  *    - Нет активного писателя (writer_active == 0)
- * 4. Уменьшить счётчик ожидающих, установить флаг активного писателя
- * 5. Освободить mutex
+ * 5. Уменьшить счётчик ожидающих, установить флаг активного писателя
+ * 6. Освободить mutex
  * 
  * Только один писатель может работать в любой момент времени.
  * Писатель получает эксклюзивный доступ.
  */
 int my_rwlock_wrlock(my_rwlock_t* rwlock) {
+    uint64_t budget = 0;
+    RWLOCK_STATS_VAR(uint64_t t0; uint64_t t1; int waited = 0; int spun = 0;)
+
     if (rwlock == NULL) {
         return EINVAL;
     }
     
+    RWLOCK_STATS_NOW(t0);
     pthread_mutex_lock(&rwlock->mutex);
     
     rwlock->waiting_writers++;
+    /* Ждущий писатель блокирует новых читателей: подсказку обновляем сразу,
+     * даже если писатель уснёт без вращения (PARK или нулевой бюджет) */
+    update_hints(rwlock);
+
+    /* Активное ожидание вне мьютекса */
+    if (rwlock->wait_mode != MY_RWLOCK_PARK) {
+        while (WRITER_BLOCKED(rwlock) &&
+               (rwlock->wait_mode == MY_RWLOCK_SPIN || (budget = adaptive_budget(rwlock)) > 0)) {
+            RWLOCK_STATS_VAR(spun = 1;)
+            update_hints(rwlock);
+            pthread_mutex_unlock(&rwlock->mutex);
+            int freed = spin_wait(rwlock, &rwlock->writer_blocked, budget);
+            pthread_mutex_lock(&rwlock->mutex);
+            if (!freed) break;
+        }
+    }
     
     /* Ждём, пока нет активных читателей и писателей */
-    while (rwlock->active_readers > 0 || rwlock->writer_active) {
+    while (WRITER_BLOCKED(rwlock)) {
+        RWLOCK_STATS_VAR(waited = 1;)
         pthread_cond_wait(&rwlock->writers_cv, &rwlock->mutex);
+        RWLOCK_STATS_COUNT(STATS_CV_WAKEUPS);
+        RWLOCK_STATS_VAR(if (WRITER_BLOCKED(rwlock)) RWLOCK_STATS_COUNT(STATS_CV_SPURIOUS);)
     }
     
     rwlock->waiting_writers--;
     rwlock->writer_active = 1;
+    hold_begin(rwlock);
     
+    update_hints(rwlock);
     pthread_mutex_unlock(&rwlock->mutex);
+
+    /* Голодание писателя - ожидание дольше порога */
+    RWLOCK_STATS_NOW(t1);
+    RWLOCK_STATS_COUNT(STATS_WR_ACQUIRE);
+    RWLOCK_STATS_VAR(if (waited) RWLOCK_STATS_COUNT(STATS_WR_CONTENDED);)
+    RWLOCK_STATS_VAR(if (spun && !waited) RWLOCK_STATS_COUNT(STATS_SPIN_WINS);)
+    RWLOCK_STATS_VAR(if (t1 - t0 > RWLOCK_STATS_STARVE_NS) RWLOCK_STATS_COUNT(STATS_WR_STARVED);)
+    RWLOCK_STATS_RECORD(STATS_WR_WAIT, t1 - t0);
     
     return 0;
 }
@@ -164,7 +373,11 @@ int my_rwlock_wrlock(my_rwlock_t* rwlock) {
  * 
  * После освобождения:
  * - Если есть ожидающие писатели - пробуждаем одного писателя
- * - Иначе пробуждаем всех ожидающих читателей
+ * - Иначе пробуждаем всех ожидающих читателей (в режиме цепочки - одного,
+ *   остальных по очереди будят вошедшие читатели)
+ *
+ * Крутящихся потоков в счётчиках ожидающих читателей нет: они видят
+ * освобождение через reader_blocked/writer_blocked.
  */
 int my_rwlock_unlock(my_rwlock_t* rwlock) {
     if (rwlock == NULL) {
@@ -176,13 +389,14 @@ int my_rwlock_unlock(my_rwlock_t* rwlock) {
     if (rwlock->writer_active) {
         /* Писатель освобождает блокировку */
         rwlock->writer_active = 0;
+        hold_end(rwlock);
         
         /* Приоритет писателям: если есть ожидающие писатели - будим одного */
         if (rwlock->waiting_writers > 0) {
             pthread_cond_signal(&rwlock->writers_cv);
         } else if (rwlock->waiting_readers > 0) {
-            /* Иначе будим всех читателей */
-            pthread_cond_broadcast(&rwlock->readers_cv);
+            /* Иначе будим читателей */
+            wake_readers(rwlock);
         }
     } else {
         /* Читатель освобождает блокировку */
@@ -190,15 +404,18 @@ int my_rwlock_unlock(my_rwlock_t* rwlock) {
         
         /* Если это был последний читатель */
         if (rwlock->active_readers == 0) {
+            hold_end(rwlock);
+
             /* Приоритет писателям */
             if (rwlock->waiting_writers > 0) {
                 pthread_cond_signal(&rwlock->writers_cv);
             } else if (rwlock->waiting_readers > 0) {
-                pthread_cond_broadcast(&rwlock->readers_cv);
+                wake_readers(rwlock);
             }
         }
     }
     
+    update_hints(rwlock);
     pthread_mutex_unlock(&rwlock->mutex);
     
     return 0;
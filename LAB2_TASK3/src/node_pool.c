@@ -0,0 +1,197 @@
+/*
+ * node_pool.c - Пул узлов с плитами и кэшем потока
+ *
+ * Плита: заголовок в первой строке кэша (пул, связь в списке плит),
+ * затем узлы. Кэш потока для пула - список освобождённых узлов и ещё
+ * не нарезанный остаток текущей плиты. Потоку хватает нескольких слотов
+ * кэша: в тесте одновременно живёт один-два пула.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "node_pool.h"
+
+#define NODE_POOL_CACHE_SLOTS 8
+
+typedef struct slab_s {
+    node_pool_t*   pool;
+    struct slab_s* next;
+} slab_t;
+
+#define SLAB_HEADER_BYTES \
+    ((sizeof(slab_t) + NODE_POOL_CACHE_LINE - 1) / NODE_POOL_CACHE_LINE * NODE_POOL_CACHE_LINE)
+
+struct node_pool_s {
+    unsigned long   id;          /* Уникален за время работы процесса */
+    size_t          node_size;
+    pthread_mutex_t mutex;       /* Защищает slabs и spare */
+    slab_t*         slabs;       /* Все плиты, выданные потокам */
+    slab_t*         spare;       /* Заранее заполненные, ещё не выданные плиты */
+};
+
+typedef struct free_node_s {
+    struct free_node_s* next;
+} free_node_t;
+
+typedef struct {
+    unsigned long id;            /* 0 - слот свободен */
+    free_node_t*  free_list;
+    char*         bump;          /* Остаток текущей плиты */
+    char*         bump_end;
+} pool_cache_t;
+
+static int            pools_enabled = 0;
+static size_t         pool_prefault = 0;
+static atomic_ulong   next_pool_id = 1;
+
+static _Thread_local pool_cache_t caches[NODE_POOL_CACHE_SLOTS];
+static _Thread_local unsigned     next_victim = 0;
+
+void node_pool_configure(int enabled, size_t prefault_nodes) {
+    pools_enabled = enabled;
+    pool_prefault = enabled ? prefault_nodes : 0;
+}
+
+static slab_t* new_slab(node_pool_t* pool) {
+    slab_t* slab = (slab_t*)aligned_alloc(NODE_POOL_SLAB_BYTES, NODE_POOL_SLAB_BYTES);
+    if (slab == NULL) {
+        abort();
+    }
+    slab->pool = pool;
+    return slab;
+}
+
+node_pool_t* node_pool_create(size_t node_size) {
+    node_pool_t* pool = (node_pool_t*)malloc(sizeof(node_pool_t));
+    size_t per_slab;
+    slab_t* slab;
+
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    /* Узел должен вмещать связь списка свободных и сохранять выравнивание указателя */
+    if (node_size < sizeof(free_node_t)) {
+        node_size = sizeof(free_node_t);
+    }
+    pool->node_size = (node_size + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+    pool->id = atomic_fetch_add(&next_pool_id, 1);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pool->slabs = NULL;
+    pool->spare = NULL;
+
+    /* Предварительное заполнение: страницы плит касаются сейчас, а не в замере */
+    per_slab = (NODE_POOL_SLAB_BYTES - SLAB_HEADER_BYTES) / pool->node_size;
+    for (size_t nodes = 0; nodes < pool_prefault; nodes += per_slab) {
+        slab = new_slab(pool);
+        memset((char*)slab + SLAB_HEADER_BYTES, 0, NODE_POOL_SLAB_BYTES - SLAB_HEADER_BYTES);
+        slab->next = pool->spare;
+        pool->spare = slab;
+    }
+
+    return pool;
+}
+
+void node_pool_destroy(node_pool_t* pool) {
+    slab_t* lists[2];
+    slab_t *slab, *following;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    lists[0] = pool->slabs;
+    lists[1] = pool->spare;
+    for (int l = 0; l < 2; l++) {
+        for (slab = lists[l]; slab != NULL; slab = following) {
+            following = slab->next;
+            free(slab);
+        }
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+/* Слот кэша текущего потока для пула; при нехватке слотов вытесняется старый */
+static pool_cache_t* get_cache(unsigned long id) {
+    pool_cache_t* cache;
+
+    for (int c = 0; c < NODE_POOL_CACHE_SLOTS; c++) {
+        if (caches[c].id == id) {
+            return &caches[c];
+        }
+    }
+    for (int c = 0; c < NODE_POOL_CACHE_SLOTS; c++) {
+        if (caches[c].id == 0) {
+            caches[c].id = id;
+            return &caches[c];
+        }
+    }
+
+    /* Узлы вытесненного слота остаются в плитах своего пула до его уничтожения */
+    cache = &caches[next_victim++ % NODE_POOL_CACHE_SLOTS];
+    memset(cache, 0, sizeof(*cache));
+    cache->id = id;
+    return cache;
+}
+
+void* node_pool_alloc(node_pool_t* pool) {
+    pool_cache_t* cache;
+    free_node_t* node;
+    slab_t* slab;
+
+    if (!pools_enabled) {
+        return malloc(pool->node_size);
+    }
+
+    cache = get_cache(pool->id);
+    if (cache->free_list != NULL) {
+        node = cache->free_list;
+        cache->free_list = node->next;
+        return node;
+    }
+
+    if (cache->bump == NULL || cache->bump + pool->node_size > cache->bump_end) {
+        pthread_mutex_lock(&pool->mutex);
+        slab = pool->spare;
+        if (slab != NULL) {
+            pool->spare = slab->next;
+        } else {
+            slab = new_slab(pool);
+        }
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pthread_mutex_unlock(&pool->mutex);
+
+        cache->bump = (char*)slab + SLAB_HEADER_BYTES;
+        cache->bump_end = (char*)slab + NODE_POOL_SLAB_BYTES;
+    }
+
+    node = (free_node_t*)cache->bump;
+    cache->bump += pool->node_size;
+    return node;
+}
+
+void node_pool_free(void* node) {
+    slab_t* slab;
+    pool_cache_t* cache;
+    free_node_t* free_node;
+
+    if (node == NULL) {
+        return;
+    }
+    if (!pools_enabled) {
+        free(node);
+        return;
+    }
+
+    /* Плита выровнена на свой размер - её заголовок в начале */
+    slab = (slab_t*)((uintptr_t)node & ~(uintptr_t)(NODE_POOL_SLAB_BYTES - 1));
+    cache = get_cache(slab->pool->id);
+    free_node = (free_node_t*)node;
+    free_node->next = cache->free_list;
+    cache->free_list = free_node;
+}
@@ -0,0 +1,200 @@
+/*
+ * rwlock_impl.c - Реализации rwlock за общим интерфейсом rwlock_impl_t
+ *
+ * Собственные блокировки вызываются напрямую, для библиотечных и
+ * эталонных (mutex, spin) - тонкие обёртки с сигнатурой над void*.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "my_futex.h"
+#include "my_rwlock.h"
+#include "my_futex_rwlock.h"
+#include "my_bravo_rwlock.h"
+#include "rwlock_impl.h"
+
+#define LOCK_CACHE_LINE 64
+#define SPIN_BEFORE_YIELD 128   /* Попыток до sched_yield в spin */
+
+/* Обёртка функций вида f(T*) в f(void*) */
+#define WRAP_LOCK(prefix, type, fn)                                   \
+    static int prefix##_##fn(void* lock) { return fn((type*)lock); }
+
+WRAP_LOCK(custom, my_rwlock_t, my_rwlock_init)
+WRAP_LOCK(custom, my_rwlock_t, my_rwlock_destroy)
+WRAP_LOCK(custom, my_rwlock_t, my_rwlock_rdlock)
+WRAP_LOCK(custom, my_rwlock_t, my_rwlock_wrlock)
+WRAP_LOCK(custom, my_rwlock_t, my_rwlock_unlock)
+
+WRAP_LOCK(futex, my_futex_rwlock_t, my_futex_rwlock_init)
+WRAP_LOCK(futex, my_futex_rwlock_t, my_futex_rwlock_destroy)
+WRAP_LOCK(futex, my_futex_rwlock_t, my_futex_rwlock_rdlock)
+WRAP_LOCK(futex, my_futex_rwlock_t, my_futex_rwlock_wrlock)
+WRAP_LOCK(futex, my_futex_rwlock_t, my_futex_rwlock_unlock)
+
+WRAP_LOCK(bravo, my_bravo_rwlock_t, my_bravo_rwlock_init)
+WRAP_LOCK(bravo, my_bravo_rwlock_t, my_bravo_rwlock_destroy)
+WRAP_LOCK(bravo, my_bravo_rwlock_t, my_bravo_rwlock_rdlock)
+WRAP_LOCK(bravo, my_bravo_rwlock_t, my_bravo_rwlock_wrlock)
+WRAP_LOCK(bravo, my_bravo_rwlock_t, my_bravo_rwlock_unlock)
+
+WRAP_LOCK(pthread, pthread_rwlock_t, pthread_rwlock_destroy)
+WRAP_LOCK(pthread, pthread_rwlock_t, pthread_rwlock_rdlock)
+WRAP_LOCK(pthread, pthread_rwlock_t, pthread_rwlock_wrlock)
+WRAP_LOCK(pthread, pthread_rwlock_t, pthread_rwlock_unlock)
+
+static int pthread_init(void* lock) {
+    return pthread_rwlock_init((pthread_rwlock_t*)lock, NULL);
+}
+
+WRAP_LOCK(mutex, pthread_mutex_t, pthread_mutex_destroy)
+WRAP_LOCK(mutex, pthread_mutex_t, pthread_mutex_lock)
+WRAP_LOCK(mutex, pthread_mutex_t, pthread_mutex_unlock)
+
+static int mutex_init(void* lock) {
+    return pthread_mutex_init((pthread_mutex_t*)lock, NULL);
+}
+
+/* Собственная блокировка с другими режимами ожидания и пробуждения */
+static int custom_spin_init(void* lock) {
+    return my_rwlock_init_mode((my_rwlock_t*)lock, MY_RWLOCK_SPIN, MY_RWLOCK_WAKE_BROADCAST);
+}
+
+static int custom_adapt_init(void* lock) {
+    return my_rwlock_init_mode((my_rwlock_t*)lock, MY_RWLOCK_ADAPTIVE, MY_RWLOCK_WAKE_BROADCAST);
+}
+
+static int custom_chain_init(void* lock) {
+    return my_rwlock_init_mode((my_rwlock_t*)lock, MY_RWLOCK_PARK, MY_RWLOCK_WAKE_CHAIN);
+}
+
+/* Спин-блокировка: ждём на чтении, CAS только когда слово свободно */
+static int spin_init(void* lock) {
+    atomic_init((atomic_int*)lock, 0);
+    return 0;
+}
+
+static int spin_destroy(void* lock) {
+    (void)lock;
+    return 0;
+}
+
+static int spin_lock(void* lock) {
+    atomic_int* word = (atomic_int*)lock;
+    int spins = 0;
+
+    while (atomic_exchange_explicit(word, 1, memory_order_acquire)) {
+        while (atomic_load_explicit(word, memory_order_relaxed)) {
+            if (++spins < SPIN_BEFORE_YIELD) {
+                cpu_relax();
+            } else {
+                spins = 0;
+                sched_yield();
+            }
+        }
+    }
+    return 0;
+}
+
+static int spin_unlock(void* lock) {
+    atomic_store_explicit((atomic_int*)lock, 0, memory_order_release);
+    return 0;
+}
+
+static const rwlock_impl_t custom_impl = {
+    "custom", sizeof(my_rwlock_t), custom_my_rwlock_init, custom_my_rwlock_destroy,
+    custom_my_rwlock_rdlock, custom_my_rwlock_wrlock, custom_my_rwlock_unlock
+};
+
+static const rwlock_impl_t custom_spin_impl = {
+    "custom-spin", sizeof(my_rwlock_t), custom_spin_init, custom_my_rwlock_destroy,
+    custom_my_rwlock_rdlock, custom_my_rwlock_wrlock, custom_my_rwlock_unlock
+};
+
+static const rwlock_impl_t custom_adapt_impl = {
+    "custom-adapt", sizeof(my_rwlock_t), custom_adapt_init, custom_my_rwlock_destroy,
+    custom_my_rwlock_rdlock, custom_my_rwlock_wrlock, custom_my_rwlock_unlock
+};
+
+static const rwlock_impl_t custom_chain_impl = {
+    "custom-chain", sizeof(my_rwlock_t), custom_chain_init, custom_my_rwlock_destroy,
+    custom_my_rwlock_rdlock, custom_my_rwlock_wrlock, custom_my_rwlock_unlock
+};
+
+static const rwlock_impl_t pthread_impl = {
+    "pthread", sizeof(pthread_rwlock_t), pthread_init, pthread_pthread_rwlock_destroy,
+    pthread_pthread_rwlock_rdlock, pthread_pthread_rwlock_wrlock, pthread_pthread_rwlock_unlock
+};
+
+static const rwlock_impl_t futex_impl = {
+    "futex", sizeof(my_futex_rwlock_t), futex_my_futex_rwlock_init, futex_my_futex_rwlock_destroy,
+    futex_my_futex_rwlock_rdlock, futex_my_futex_rwlock_wrlock, futex_my_futex_rwlock_unlock
+};
+
+static const rwlock_impl_t bravo_impl = {
+    "bravo", sizeof(my_bravo_rwlock_t), bravo_my_bravo_rwlock_init, bravo_my_bravo_rwlock_destroy,
+    bravo_my_bravo_rwlock_rdlock, bravo_my_bravo_rwlock_wrlock, bravo_my_bravo_rwlock_unlock
+};
+
+static const rwlock_impl_t mutex_impl = {
+    "mutex", sizeof(pthread_mutex_t), mutex_init, mutex_pthread_mutex_destroy,
+    mutex_pthread_mutex_lock, mutex_pthread_mutex_lock, mutex_pthread_mutex_unlock
+};
+
+static const rwlock_impl_t spin_impl = {
+    "spin", sizeof(atomic_int), spin_init, spin_destroy, spin_lock, spin_lock, spin_unlock
+};
+
+const rwlock_impl_t* const rwlock_impls[] = {
+    &custom_impl, &custom_spin_impl, &custom_adapt_impl, &custom_chain_impl, &pthread_impl, &futex_impl, &bravo_impl, &mutex_impl, &spin_impl
+};
+const int rwlock_impl_count = sizeof(rwlock_impls) / sizeof(rwlock_impls[0]);
+
+const rwlock_impl_t* rwlock_impl_find(const char* name) {
+    for (int i = 0; i < rwlock_impl_count; i++) {
+        if (strcmp(rwlock_impls[i]->name, name) == 0) {
+            return rwlock_impls[i];
+        }
+    }
+    return NULL;
+}
+
+/* Шаг массива: размер блокировки, округлённый до строки кэша */
+static size_t lock_stride(const rwlock_impl_t* impl) {
+    return (impl->size + LOCK_CACHE_LINE - 1) / LOCK_CACHE_LINE * LOCK_CACHE_LINE;
+}
+
+void* rwlock_impl_new(const rwlock_impl_t* impl, int count) {
+    char* locks = (char*)aligned_alloc(LOCK_CACHE_LINE, lock_stride(impl) * count);
+
+    if (locks == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        if (impl->init(locks + lock_stride(impl) * i) != 0) {
+            while (--i >= 0) {
+                impl->destroy(locks + lock_stride(impl) * i);
+            }
+            free(locks);
+            return NULL;
+        }
+    }
+    return locks;
+}
+
+void* rwlock_impl_at(const rwlock_impl_t* impl, void* locks, int i) {
+    return (char*)locks + lock_stride(impl) * i;
+}
+
+void rwlock_impl_free(const rwlock_impl_t* impl, void* locks, int count) {
+    if (locks == NULL) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        impl->destroy(rwlock_impl_at(impl, locks, i));
+    }
+    free(locks);
+}
@@ -0,0 +1,190 @@
+/*
+ * rwlock_stats.c - Записи статистики потоков и гистограммы задержек
+ *
+ * Запись создаётся при первом обращении потока и остаётся в общем списке
+ * до конца программы. Завершившийся поток отдаёт запись следующему, как
+ * в epoch.c, поэтому список не растёт с каждым прогоном, а накопленные
+ * значения сохраняются до rwlock_stats_reset().
+ */
+
+#ifdef RWLOCK_STATS
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "rwlock_stats.h"
+
+typedef struct stats_record_s {
+    rwlock_stats_t         stats;
+    int                    in_use;   /* Запись занята живым потоком */
+    struct stats_record_s* next;
+} stats_record_t;
+
+_Thread_local rwlock_stats_t* rwlock_stats_mine = NULL;
+
+static stats_record_t*  records = NULL;
+static pthread_mutex_t  records_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t    record_key;
+static pthread_once_t   record_key_once = PTHREAD_ONCE_INIT;
+
+static void release_record(void* arg) {
+    stats_record_t* rec = (stats_record_t*)arg;
+
+    pthread_mutex_lock(&records_mutex);
+    rec->in_use = 0;
+    pthread_mutex_unlock(&records_mutex);
+}
+
+static void create_record_key(void) {
+    pthread_key_create(&record_key, release_record);
+}
+
+rwlock_stats_t* rwlock_stats_register(void) {
+    stats_record_t* rec;
+
+    pthread_once(&record_key_once, create_record_key);
+
+    pthread_mutex_lock(&records_mutex);
+    for (rec = records; rec != NULL && rec->in_use; rec = rec->next)
+        ;
+    if (rec == NULL) {
+        rec = (stats_record_t*)calloc(1, sizeof(stats_record_t));
+        if (rec == NULL) {
+            abort();
+        }
+        rec->next = records;
+        records = rec;
+    }
+    rec->in_use = 1;
+    pthread_mutex_unlock(&records_mutex);
+
+    pthread_setspecific(record_key, rec);
+    rwlock_stats_mine = &rec->stats;
+    return rwlock_stats_mine;
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Номер корзины: значения меньше STATS_HIST_SUB - точно, далее у значения
+ * со старшим битом msb корзину выбирают следующие STATS_HIST_SUB_BITS бит
+ */
+static int bucket_of(uint64_t value) {
+    int msb, shift;
+
+    if (value < STATS_HIST_SUB) {
+        return (int)value;
+    }
+    msb = 63 - __builtin_clzll(value);
+    if (msb >= STATS_HIST_MAX_BITS) {
+        return STATS_HIST_BUCKETS - 1;
+    }
+    shift = msb - STATS_HIST_SUB_BITS;
+    return (shift + 1) * STATS_HIST_SUB + (int)(value >> shift) - STATS_HIST_SUB;
+}
+
+/* Наименьшее значение корзины */
+static uint64_t bucket_value(int bucket) {
+    int shift;
+
+    if (bucket < STATS_HIST_SUB) {
+        return (uint64_t)bucket;
+    }
+    shift = bucket / STATS_HIST_SUB - 1;
+    return (uint64_t)(STATS_HIST_SUB + bucket % STATS_HIST_SUB) << shift;
+}
+
+void stats_hist_record(stats_hist_t* hist, uint64_t value) {
+    hist->buckets[bucket_of(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) hist->max = value;
+}
+
+void stats_hist_record_n(stats_hist_t* hist, uint64_t value, uint64_t count) {
+    hist->buckets[bucket_of(value)] += count;
+    hist->count += count;
+    hist->sum += value * count;
+    if (count > 0 && value > hist->max) hist->max = value;
+}
+
+uint64_t stats_hist_percentile(const stats_hist_t* hist, double p) {
+    uint64_t rank, seen = 0;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+    rank = (uint64_t)(p * (hist->count - 1)) + 1;
+    for (int b = 0; b < STATS_HIST_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (seen >= rank) {
+            uint64_t value = bucket_value(b);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+/*-----------------------------------------------------------------*/
+void rwlock_stats_reset(void) {
+    pthread_mutex_lock(&records_mutex);
+    for (stats_record_t* rec = records; rec != NULL; rec = rec->next) {
+        memset(&rec->stats, 0, sizeof(rec->stats));
+    }
+    pthread_mutex_unlock(&records_mutex);
+}
+
+void rwlock_stats_collect(rwlock_stats_t* total) {
+    memset(total, 0, sizeof(*total));
+
+    pthread_mutex_lock(&records_mutex);
+    for (stats_record_t* rec = records; rec != NULL; rec = rec->next) {
+        for (int c = 0; c < STATS_COUNTER_COUNT; c++) {
+            total->counters[c] += rec->stats.counters[c];
+        }
+        for (int h = 0; h < STATS_HIST_COUNT; h++) {
+            stats_hist_t* dst = &total->hists[h];
+            const stats_hist_t* src = &rec->stats.hists[h];
+
+            dst->count += src->count;
+            dst->sum += src->sum;
+            if (src->max > dst->max) dst->max = src->max;
+            for (int b = 0; b < STATS_HIST_BUCKETS; b++) {
+                dst->buckets[b] += src->buckets[b];
+            }
+        }
+    }
+    pthread_mutex_unlock(&records_mutex);
+}
+
+/*-----------------------------------------------------------------*/
+static double share(uint64_t part, uint64_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+void rwlock_stats_print(FILE* out, const rwlock_stats_t* stats) {
+    static const char* hist_names[STATS_HIST_COUNT] = { "rd_wait", "wr_wait", "member", "insert", "delete" };
+    const uint64_t* c = stats->counters;
+
+    fprintf(out, "  rdlock: %llu (contended %.1f%%), wrlock: %llu (contended %.1f%%)\n",
+            (unsigned long long)c[STATS_RD_ACQUIRE], share(c[STATS_RD_CONTENDED], c[STATS_RD_ACQUIRE]),
+            (unsigned long long)c[STATS_WR_ACQUIRE], share(c[STATS_WR_CONTENDED], c[STATS_WR_ACQUIRE]));
+    fprintf(out, "  cv wakeups: %llu (spurious %llu), starved writers (> %llu ns): %llu\n",
+            (unsigned long long)c[STATS_CV_WAKEUPS], (unsigned long long)c[STATS_CV_SPURIOUS],
+            (unsigned long long)RWLOCK_STATS_STARVE_NS, (unsigned long long)c[STATS_WR_STARVED]);
+    fprintf(out, "  acquired by spinning: %llu\n", (unsigned long long)c[STATS_SPIN_WINS]);
+    fprintf(out, "  %-8s | %-10s | %-10s | %-10s | %-10s | %-10s | %-10s\n",
+            "Hist", "Count", "Mean(ns)", "p50(ns)", "p99(ns)", "p99.9(ns)", "Max(ns)");
+    for (int h = 0; h < STATS_HIST_COUNT; h++) {
+        const stats_hist_t* hist = &stats->hists[h];
+
+        if (hist->count == 0) continue;
+        fprintf(out, "  %-8s | %-10llu | %-10.0f | %-10llu | %-10llu | %-10llu | %-10llu\n",
+                hist_names[h], (unsigned long long)hist->count, (double)hist->sum / hist->count,
+                (unsigned long long)stats_hist_percentile(hist, 0.50),
+                (unsigned long long)stats_hist_percentile(hist, 0.99),
+                (unsigned long long)stats_hist_percentile(hist, 0.999),
+                (unsigned long long)hist->max);
+    }
+}
+
+#endif /* RWLOCK_STATS */
@@ -0,0 +1,182 @@
+/*
+ * set_hash.c - Хеш-множество с полосами блокировок (lock striping)
+ *
+ * Корзины - цепочки узлов. Корзина b защищена блокировкой полосы
+ * b % HASH_STRIPES, где блокировка - та же реализация rwlock_impl_t, что
+ * выбрана для теста, поэтому сравнивается одна и та же блокировка
+ * на структуре с O(1) операциями. Общий rwlock Thread_work не нужен.
+ *
+ * При средней длине цепочки больше HASH_MAX_LOAD таблица удваивается;
+ * поток берёт все полосы по порядку на запись. Номер полосы зависит только
+ * от младших бит хеша, поэтому ключ остаётся в своей полосе после удвоения.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "node_pool.h"
+#include "list_engine.h"
+
+#define HASH_STRIPES         64
+#define HASH_INITIAL_BUCKETS 1024   /* Степень двойки, кратная HASH_STRIPES */
+#define HASH_MAX_LOAD        4
+
+struct hash_node_s {
+    int    data;
+    struct hash_node_s* next;
+};
+
+typedef struct {
+    const rwlock_impl_t* lock;
+    void*                stripes;       /* HASH_STRIPES блокировок lock */
+    struct hash_node_s** buckets;
+    size_t               bucket_count;  /* Меняется только под всеми полосами */
+    atomic_long          size;
+    node_pool_t*         pool;          /* Узлы цепочек */
+} hash_set_t;
+
+static inline uint32_t hash_key(int value) {
+    uint32_t h = (uint32_t)value * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+static inline void* stripe_of(hash_set_t* set, uint32_t h) {
+    return rwlock_impl_at(set->lock, set->stripes, (int)(h % HASH_STRIPES));
+}
+
+static void* hash_create(const rwlock_impl_t* lock) {
+    hash_set_t* set = (hash_set_t*)malloc(sizeof(hash_set_t));
+
+    set->lock = lock;
+    set->stripes = rwlock_impl_new(lock, HASH_STRIPES);
+    set->bucket_count = HASH_INITIAL_BUCKETS;
+    set->buckets = (struct hash_node_s**)calloc(set->bucket_count, sizeof(struct hash_node_s*));
+    atomic_init(&set->size, 0);
+    set->pool = node_pool_create(sizeof(struct hash_node_s));
+    return set;
+}
+
+static void hash_destroy(void* list) {
+    hash_set_t* set = (hash_set_t*)list;
+    struct hash_node_s *curr, *following;
+
+    for (size_t b = 0; b < set->bucket_count; b++) {
+        for (curr = set->buckets[b]; curr != NULL; curr = following) {
+            following = curr->next;
+            node_pool_free(curr);
+        }
+    }
+    rwlock_impl_free(set->lock, set->stripes, HASH_STRIPES);
+    node_pool_destroy(set->pool);
+    free(set->buckets);
+    free(set);
+}
+
+/* Удвоение таблицы под всеми полосами */
+static void hash_resize(hash_set_t* set, size_t old_count) {
+    struct hash_node_s** buckets;
+    struct hash_node_s *curr, *following;
+    size_t count, b;
+
+    for (int s = 0; s < HASH_STRIPES; s++) {
+        set->lock->wrlock(rwlock_impl_at(set->lock, set->stripes, s));
+    }
+
+    /* Другой поток мог удвоить таблицу раньше */
+    if (set->bucket_count == old_count) {
+        count = old_count * 2;
+        buckets = (struct hash_node_s**)calloc(count, sizeof(struct hash_node_s*));
+        if (buckets != NULL) {
+            for (size_t old = 0; old < old_count; old++) {
+                for (curr = set->buckets[old]; curr != NULL; curr = following) {
+                    following = curr->next;
+                    b = hash_key(curr->data) & (count - 1);
+                    curr->next = buckets[b];
+                    buckets[b] = curr;
+                }
+            }
+            free(set->buckets);
+            set->buckets = buckets;
+            set->bucket_count = count;
+        }
+    }
+
+    for (int s = HASH_STRIPES - 1; s >= 0; s--) {
+        set->lock->unlock(rwlock_impl_at(set->lock, set->stripes, s));
+    }
+}
+
+static int hash_insert(void* list, int value) {
+    hash_set_t* set = (hash_set_t*)list;
+    uint32_t h = hash_key(value);
+    void* stripe = stripe_of(set, h);
+    struct hash_node_s** bucket;
+    struct hash_node_s* curr;
+    size_t count;
+    int rv = 1;
+
+    set->lock->wrlock(stripe);
+    count = set->bucket_count;
+    bucket = &set->buckets[h & (count - 1)];
+    for (curr = *bucket; curr != NULL && curr->data != value; curr = curr->next)
+        ;
+    if (curr == NULL) {
+        curr = (struct hash_node_s*)node_pool_alloc(set->pool);
+        curr->data = value;
+        curr->next = *bucket;
+        *bucket = curr;
+    } else {
+        rv = 0;  /* Значение уже в множестве */
+    }
+    set->lock->unlock(stripe);
+
+    if (rv && (size_t)atomic_fetch_add(&set->size, 1) + 1 > count * HASH_MAX_LOAD) {
+        hash_resize(set, count);
+    }
+    return rv;
+}
+
+static int hash_member(void* list, int value) {
+    hash_set_t* set = (hash_set_t*)list;
+    uint32_t h = hash_key(value);
+    void* stripe = stripe_of(set, h);
+    struct hash_node_s* curr;
+
+    set->lock->rdlock(stripe);
+    for (curr = set->buckets[h & (set->bucket_count - 1)]; curr != NULL && curr->data != value; curr = curr->next)
+        ;
+    set->lock->unlock(stripe);
+
+    return curr != NULL;
+}
+
+static int hash_delete(void* list, int value) {
+    hash_set_t* set = (hash_set_t*)list;
+    uint32_t h = hash_key(value);
+    void* stripe = stripe_of(set, h);
+    struct hash_node_s** link;
+    struct hash_node_s* curr;
+
+    set->lock->wrlock(stripe);
+    link = &set->buckets[h & (set->bucket_count - 1)];
+    while (*link != NULL && (*link)->data != value) {
+        link = &(*link)->next;
+    }
+    curr = *link;
+    if (curr != NULL) {
+        *link = curr->next;
+    }
+    set->lock->unlock(stripe);
+
+    if (curr == NULL) {
+        return 0;  /* Значение не найдено */
+    }
+    atomic_fetch_sub(&set->size, 1);
+    node_pool_free(curr);
+    return 1;
+}
+
+const list_engine_t hash_set_engine = {
+    "hash", 0, hash_create, hash_destroy, hash_insert, hash_member, hash_delete,
+    NULL, NULL, NULL
+};
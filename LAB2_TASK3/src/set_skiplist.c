@@ -0,0 +1,154 @@
+/*
+ * set_skiplist.c - Множество на списке с пропусками (skip list)
+ *
+ * Поиск, вставка и удаление - O(log n) в среднем вместо O(n) у списка:
+ * узел с вероятностью 1/2 поднимается на следующий уровень, и проход
+ * сверху вниз пропускает большую часть ключей.
+ *
+ * Реализация не синхронизирована (coarse_lock = 1): Thread_work берёт
+ * тот же общий rwlock, что и для списка. Member только читает, поэтому
+ * читатели работают параллельно; случайный уровень выбирается при вставке
+ * под блокировкой на запись.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include "list_engine.h"
+
+#define SKIPLIST_MAX_LEVEL 20   /* Хватает для 2^20 ключей */
+
+struct skip_node_s {
+    int    data;
+    int    height;
+    struct skip_node_s* next[];  /* next[0..height-1] */
+};
+
+typedef struct {
+    struct skip_node_s* head;    /* Сторож INT_MIN высоты SKIPLIST_MAX_LEVEL */
+    int      level;              /* Число занятых уровней */
+    unsigned seed;               /* Генератор высоты узлов (xorshift) */
+} skiplist_t;
+
+static struct skip_node_s* new_node(int value, int height) {
+    struct skip_node_s* node = (struct skip_node_s*)malloc(sizeof(struct skip_node_s) +
+                                                           height * sizeof(struct skip_node_s*));
+    node->data = value;
+    node->height = height;
+    for (int l = 0; l < height; l++) {
+        node->next[l] = NULL;
+    }
+    return node;
+}
+
+static int random_height(skiplist_t* sl) {
+    unsigned x = sl->seed;
+    int height = 1;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sl->seed = x;
+
+    while ((x & 1) && height < SKIPLIST_MAX_LEVEL) {
+        height++;
+        x >>= 1;
+    }
+    return height;
+}
+
+/*
+ * Спуск к value: update[l] - последний узел уровня l с data < value
+ * Возвращает первый узел нижнего уровня с data >= value или NULL
+ */
+static struct skip_node_s* skiplist_find(skiplist_t* sl, int value,
+                                         struct skip_node_s* update[SKIPLIST_MAX_LEVEL]) {
+    struct skip_node_s* curr = sl->head;
+
+    for (int l = sl->level - 1; l >= 0; l--) {
+        while (curr->next[l] != NULL && curr->next[l]->data < value) {
+            curr = curr->next[l];
+        }
+        if (update != NULL) {
+            update[l] = curr;
+        }
+    }
+    return curr->next[0];
+}
+
+static void* skiplist_create(const rwlock_impl_t* lock) {
+    (void)lock;
+    skiplist_t* sl = (skiplist_t*)malloc(sizeof(skiplist_t));
+    sl->head = new_node(INT_MIN, SKIPLIST_MAX_LEVEL);
+    sl->level = 1;
+    sl->seed = 2463534242u;
+    return sl;
+}
+
+static void skiplist_destroy(void* list) {
+    skiplist_t* sl = (skiplist_t*)list;
+    struct skip_node_s* curr = sl->head;
+    struct skip_node_s* following;
+
+    while (curr != NULL) {
+        following = curr->next[0];
+        free(curr);
+        curr = following;
+    }
+    free(sl);
+}
+
+static int skiplist_insert(void* list, int value) {
+    skiplist_t* sl = (skiplist_t*)list;
+    struct skip_node_s* update[SKIPLIST_MAX_LEVEL];
+    struct skip_node_s* curr = skiplist_find(sl, value, update);
+    struct skip_node_s* node;
+    int height;
+
+    if (curr != NULL && curr->data == value) {
+        return 0;  /* Значение уже в списке */
+    }
+
+    height = random_height(sl);
+    for (int l = sl->level; l < height; l++) {
+        update[l] = sl->head;
+    }
+    if (height > sl->level) {
+        sl->level = height;
+    }
+
+    node = new_node(value, height);
+    for (int l = 0; l < height; l++) {
+        node->next[l] = update[l]->next[l];
+        update[l]->next[l] = node;
+    }
+    return 1;
+}
+
+static int skiplist_member(void* list, int value) {
+    struct skip_node_s* curr = skiplist_find((skiplist_t*)list, value, NULL);
+    return curr != NULL && curr->data == value;
+}
+
+static int skiplist_delete(void* list, int value) {
+    skiplist_t* sl = (skiplist_t*)list;
+    struct skip_node_s* update[SKIPLIST_MAX_LEVEL];
+    struct skip_node_s* curr = skiplist_find(sl, value, update);
+
+    if (curr == NULL || curr->data != value) {
+        return 0;  /* Значение не найдено */
+    }
+
+    for (int l = 0; l < curr->height; l++) {
+        update[l]->next[l] = curr->next[l];
+    }
+    while (sl->level > 1 && sl->head->next[sl->level - 1] == NULL) {
+        sl->level--;
+    }
+    free(curr);
+    return 1;
+}
+
+const list_engine_t skiplist_engine = {
+    "skiplist", 1, skiplist_create, skiplist_destroy, skiplist_insert, skiplist_member, skiplist_delete,
+    NULL, NULL, NULL
+};
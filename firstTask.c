@@ -1,8 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <omp.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
 // Максимальное количество итераций для проверки ограниченности
 #define MAX_ITERATIONS 1000
 
@@ -12,11 +20,91 @@
 #define MIN_Y -1.5
 #define MAX_Y 1.5
 
+// Размер пакета точек, проверяемых векторным ядром за один вызов
+// (8 double = один регистр AVX-512 или два регистра AVX2)
+#define BATCH_SIZE 8
+
+// Размер строки кэша и число структур Point в одной строке
+#define CACHE_LINE 64
+#define POINTS_PER_LINE (CACHE_LINE / 16)
+
+// Максимальный размер блока выходного массива, захватываемого потоком за раз
+#define CHUNK_POINTS 4096
+
+// Сверка ядер в режиме --verify: VERIFY_BLOCKS блоков по VERIFY_BATCHES пакетов
+// сырых кандидатов, взятых из отдельных от выборки потоков генератора
+#define VERIFY_BLOCKS 64
+#define VERIFY_BATCHES 1024
+#define VERIFY_STREAM 0x8000000000000000ULL
+
+// Размер плитки сетки в режиме grid (узлов по каждой стороне)
+#define GRID_TILE 64
+
+// Площадь множества Мандельброта: по ней в режиме grid подбирается шаг сетки,
+// дающий примерно столько же точек множества, сколько набирает режим sample
+#define MANDELBROT_AREA 1.5066
+
+// Число точек в одном куске при параллельном форматировании CSV
+// и оценка сверху длины одной строки "%.6f,%.6f\n"
+#define CSV_CHUNK_POINTS 65536
+#define CSV_MAX_LINE 64
+
+// Заголовок двоичного формата: сигнатура, версия, число точек,
+// затем пары (x, y) в виде little-endian double
+#define BIN_MAGIC "MBRT"
+#define BIN_VERSION 1
+
 typedef struct {
     double x;
     double y;
 } Point;
 
+// Генератор xoshiro256+ с BATCH_SIZE независимыми дорожками: состояние хранится
+// по словам (s[слово][дорожка]), поэтому шаг всех дорожек векторизуется компилятором
+// и один вызов rngNextBlock даёт целый пакет чисел.
+// Генератор не разделяется между потоками: каждый блок выходного массива получает
+// собственное состояние из пары (seed, номер блока), как в счётных генераторах.
+typedef struct {
+    uint64_t s[4][BATCH_SIZE] __attribute__((aligned(CACHE_LINE)));
+} Rng;
+
+static uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Инициализация генератора для потока чисел с номером stream
+static void rngSeed(Rng* rng, uint64_t seed, uint64_t stream) {
+    uint64_t sm = seed ^ splitmix64(&stream);
+    for (int k = 0; k < BATCH_SIZE; k++) {
+        for (int w = 0; w < 4; w++) {
+            rng->s[w][k] = splitmix64(&sm);
+        }
+    }
+}
+
+// Пакет из BATCH_SIZE равномерно распределённых чисел в [lo, hi)
+static inline void rngNextBlock(Rng* rng, double* out, double lo, double hi) {
+    for (int k = 0; k < BATCH_SIZE; k++) {
+        uint64_t result = rng->s[0][k] + rng->s[3][k];
+        uint64_t t = rng->s[1][k] << 17;
+
+        rng->s[2][k] ^= rng->s[0][k];
+        rng->s[3][k] ^= rng->s[1][k];
+        rng->s[1][k] ^= rng->s[2][k];
+        rng->s[0][k] ^= rng->s[3][k];
+        rng->s[2][k] ^= t;
+        rng->s[3][k] = (rng->s[3][k] << 45) | (rng->s[3][k] >> 19);
+
+        // Старшие 52 бита кладём в мантиссу числа из [1, 2): перевод без деления
+        union { uint64_t u; double d; } bits;
+        bits.u = (result >> 12) | 0x3FF0000000000000ULL;
+        out[k] = (bits.d - 1.0) * (hi - lo) + lo;
+    }
+}
+
 char mandelbrotContains(double real, double img) {
     double z_real = 0.0;
     double z_img = 0.0;
@@ -42,86 +130,612 @@ char mandelbrotContains(double real, double img) {
     return 1;
 }
 
+// Ядро, проверяющее пакет из BATCH_SIZE точек: inside[k] = mandelbrotContains(real[k], img[k])
+typedef void (*BatchKernel)(const double* real, const double* img, char* inside);
+
+// Скалярная версия пакетного ядра - эталон для сверки результатов
+static void mandelbrotBatchScalar(const double* real, const double* img, char* inside) {
+    for (int k = 0; k < BATCH_SIZE; k++) {
+        inside[k] = mandelbrotContains(real[k], img[k]);
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+// AVX2: два регистра по 4 точки обрабатываются вперемешку для лучшей загрузки конвейера.
+// Вылетевшие дорожки продолжают считаться (значения уходят в inf/NaN), но маска escaped
+// только накапливается, поэтому результат совпадает со скалярной версией.
+// Цикл завершается, как только вылетели все 8 точек.
+__attribute__((target("avx2")))
+static void mandelbrotBatchAVX2(const double* real, const double* img, char* inside) {
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+
+    __m256d c_re0 = _mm256_loadu_pd(real);
+    __m256d c_im0 = _mm256_loadu_pd(img);
+    __m256d c_re1 = _mm256_loadu_pd(real + 4);
+    __m256d c_im1 = _mm256_loadu_pd(img + 4);
+
+    __m256d z_re0 = _mm256_setzero_pd(), z_im0 = _mm256_setzero_pd();
+    __m256d z_re1 = _mm256_setzero_pd(), z_im1 = _mm256_setzero_pd();
+    __m256d escaped0 = _mm256_setzero_pd(), escaped1 = _mm256_setzero_pd();
+
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        __m256d re_sq0 = _mm256_mul_pd(z_re0, z_re0);
+        __m256d im_sq0 = _mm256_mul_pd(z_im0, z_im0);
+        __m256d re_sq1 = _mm256_mul_pd(z_re1, z_re1);
+        __m256d im_sq1 = _mm256_mul_pd(z_im1, z_im1);
+
+        escaped0 = _mm256_or_pd(escaped0, _mm256_cmp_pd(_mm256_add_pd(re_sq0, im_sq0), four, _CMP_GE_OQ));
+        escaped1 = _mm256_or_pd(escaped1, _mm256_cmp_pd(_mm256_add_pd(re_sq1, im_sq1), four, _CMP_GE_OQ));
+        if ((_mm256_movemask_pd(escaped0) & _mm256_movemask_pd(escaped1)) == 0xF) {
+            break;
+        }
+
+        __m256d new_re0 = _mm256_add_pd(_mm256_sub_pd(re_sq0, im_sq0), c_re0);
+        __m256d new_re1 = _mm256_add_pd(_mm256_sub_pd(re_sq1, im_sq1), c_re1);
+        z_im0 = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, z_re0), z_im0), c_im0);
+        z_im1 = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, z_re1), z_im1), c_im1);
+        z_re0 = new_re0;
+        z_re1 = new_re1;
+    }
+
+    int mask = _mm256_movemask_pd(escaped0) | (_mm256_movemask_pd(escaped1) << 4);
+    for (int k = 0; k < BATCH_SIZE; k++) {
+        inside[k] = !((mask >> k) & 1);
+    }
+}
+
+// AVX-512: все 8 точек в одном регистре, маска вылета хранится в k-регистре.
+// AVX-512F включает FMA, поэтому умножения записаны через *_round_pd: иначе компилятор
+// сливает их со сложением в FMA и результат у границы множества расходится со скалярным.
+#define MUL512(a, b) _mm512_mul_round_pd((a), (b), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+
+__attribute__((target("avx512f")))
+static void mandelbrotBatchAVX512(const double* real, const double* img, char* inside) {
+    const __m512d four = _mm512_set1_pd(4.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+
+    __m512d c_re = _mm512_loadu_pd(real);
+    __m512d c_im = _mm512_loadu_pd(img);
+    __m512d z_re = _mm512_setzero_pd();
+    __m512d z_im = _mm512_setzero_pd();
+    __mmask8 escaped = 0;
+
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        __m512d re_sq = MUL512(z_re, z_re);
+        __m512d im_sq = MUL512(z_im, z_im);
+
+        escaped |= _mm512_cmp_pd_mask(_mm512_add_pd(re_sq, im_sq), four, _CMP_GE_OQ);
+        if (escaped == 0xFF) {
+            break;
+        }
+
+        __m512d new_re = _mm512_add_pd(_mm512_sub_pd(re_sq, im_sq), c_re);
+        z_im = _mm512_add_pd(MUL512(MUL512(two, z_re), z_im), c_im);
+        z_re = new_re;
+    }
+
+    for (int k = 0; k < BATCH_SIZE; k++) {
+        inside[k] = !((escaped >> k) & 1);
+    }
+}
+#endif
+
+// Выбор ядра по имени; "auto" - самое широкое из поддерживаемых процессором.
+// Возвращает NULL, если имя неизвестно или набор инструкций недоступен.
+static BatchKernel selectBatchKernel(const char* name, const char** chosen) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    int has_avx512 = __builtin_cpu_supports("avx512f");
+    int has_avx2 = __builtin_cpu_supports("avx2");
+#else
+    int has_avx512 = 0;
+    int has_avx2 = 0;
+#endif
+
+    if (strcmp(name, "auto") == 0) {
+        name = has_avx512 ? "avx512" : (has_avx2 ? "avx2" : "scalar");
+    }
+    *chosen = name;
+
+    if (strcmp(name, "scalar") == 0) {
+        return mandelbrotBatchScalar;
+    }
+#ifdef HAVE_X86_SIMD
+    if (strcmp(name, "avx2") == 0 && has_avx2) {
+        return mandelbrotBatchAVX2;
+    }
+    if (strcmp(name, "avx512") == 0 && has_avx512) {
+        return mandelbrotBatchAVX512;
+    }
+#endif
+    return NULL;
+}
+
+// Выходной массив выровнен по строке кэша, чтобы блоки разных потоков не делили строки
+static Point* allocPoints(long n) {
+    size_t bytes = sizeof(Point) * (size_t)(n > 0 ? n : 1);
+    bytes = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    return (Point*)aligned_alloc(CACHE_LINE, bytes);
+}
+
+// Режим sample: случайные точки области до тех пор, пока не наберётся npoints точек множества
+static void sampleMandelbrot(Point* points, long npoints, int nthreads, BatchKernel kernel, uint64_t seed) {
+    // Размер блока: примерно 16 блоков на поток, чтобы хвост работы делился между потоками,
+    // но не больше CHUNK_POINTS и кратно числу точек в строке кэша
+    long chunk = npoints / ((long)nthreads * 16);
+    if (chunk > CHUNK_POINTS) {
+        chunk = CHUNK_POINTS;
+    }
+    chunk = (chunk + POINTS_PER_LINE - 1) / POINTS_PER_LINE * POINTS_PER_LINE;
+    if (chunk < POINTS_PER_LINE) {
+        chunk = POINTS_PER_LINE;
+    }
+
+    long next_chunk = 0;
+
+    // Каждый поток захватывает одним atomic capture целый блок [base, base + chunk) выходного
+    // массива и заполняет его сам, без обращений к общим переменным. Поток берёт новый блок
+    // только после того, как заполнил текущий, поэтому все блоки до npoints оказываются
+    // заполнены целиком и итоговый массив не требует уплотнения: в нём ровно npoints точек.
+    // Генератор каждого блока зависит только от seed и номера блока, поэтому при заданных
+    // seed и числе потоков (от него зависит размер блока) результат воспроизводим побитово.
+#pragma omp parallel
+    {
+        Rng rng;
+
+        while (1) {
+            long base;
+
+#pragma omp atomic capture
+            {
+                base = next_chunk;
+                next_chunk += chunk;
+            }
+            if (base >= npoints) {
+                break;
+            }
+
+            long end = base + chunk < npoints ? base + chunk : npoints;
+            long filled = base;
+            rngSeed(&rng, seed, (uint64_t)(base / chunk));
+
+            while (filled < end) {
+                // Генерируем пакет кандидатов и проверяем его одним вызовом ядра
+                double x[BATCH_SIZE], y[BATCH_SIZE];
+                char inside[BATCH_SIZE];
+                rngNextBlock(&rng, x, MIN_X, MAX_X);
+                rngNextBlock(&rng, y, MIN_Y, MAX_Y);
+
+                kernel(x, y, inside);
+
+                for (int k = 0; k < BATCH_SIZE && filled < end; k++) {
+                    if (inside[k]) {
+                        points[filled].x = x[k];
+                        points[filled].y = y[k];
+                        filled++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Быстрая проверка для режима grid, результат совпадает с mandelbrotContains:
+// - точки главной кардиоиды и круга периода 2 принадлежат множеству аналитически;
+// - если орбита в точности вернулась в сохранённое значение, она периодична и уже
+//   никогда не уйдёт на бесконечность (сохраняемое значение обновляется через
+//   удваивающиеся интервалы, как в алгоритме Брента, чтобы поймать цикл любой длины).
+char mandelbrotContainsFast(double real, double img) {
+    double img_sq = img * img;
+
+    double q = (real - 0.25) * (real - 0.25) + img_sq;
+    if (q * (q + (real - 0.25)) <= 0.25 * img_sq) {
+        return 1;
+    }
+    if ((real + 1.0) * (real + 1.0) + img_sq <= 0.0625) {
+        return 1;
+    }
+
+    double z_real = 0.0;
+    double z_img = 0.0;
+    double saved_real = 0.0;
+    double saved_img = 0.0;
+    int period = 8;
+    int steps = 0;
+
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double z_real_sq = z_real * z_real;
+        double z_img_sq = z_img * z_img;
+
+        if (z_real_sq + z_img_sq >= 4.0) {
+            return 0;
+        }
+
+        double new_z_real = z_real_sq - z_img_sq + real;
+        double new_z_img = 2.0 * z_real * z_img + img;
+
+        z_real = new_z_real;
+        z_img = new_z_img;
+
+        if (z_real == saved_real && z_img == saved_img) {
+            return 1;
+        }
+        if (++steps == period) {
+            steps = 0;
+            period *= 2;
+            saved_real = z_real;
+            saved_img = z_img;
+        }
+    }
+
+    return 1;
+}
+
+// Режим grid: детерминированный обход сетки side x side узлов (центры ячеек области).
+// Сетка делится на плитки GRID_TILE x GRID_TILE, которые раздаются потокам через
+// schedule(dynamic): плитки внутри множества и у его границы считаются гораздо дольше.
+// Каждая плитка собирает свои точки отдельно; затем они склеиваются в порядке плиток,
+// так что результат не зависит от числа потоков. Возвращает массив из *count точек.
+static Point* scanMandelbrotGrid(long side, long* count) {
+    long tiles_per_side = (side + GRID_TILE - 1) / GRID_TILE;
+    long ntiles = tiles_per_side * tiles_per_side;
+    double step_x = (MAX_X - MIN_X) / side;
+    double step_y = (MAX_Y - MIN_Y) / side;
+
+    Point** tile_points = (Point**)calloc(ntiles, sizeof(Point*));
+    long* tile_count = (long*)calloc(ntiles + 1, sizeof(long));
+    if (tile_points == NULL || tile_count == NULL) {
+        free(tile_points);
+        free(tile_count);
+        return NULL;
+    }
+
+    int failed = 0;
+
+#pragma omp parallel
+    {
+        Point* buffer = (Point*)malloc(sizeof(Point) * GRID_TILE * GRID_TILE);
+        if (buffer == NULL) {
+#pragma omp atomic write
+            failed = 1;
+        }
+
+#pragma omp for schedule(dynamic)
+        for (long tile = 0; tile < ntiles; tile++) {
+            if (buffer == NULL) {
+                continue;
+            }
+
+            long row0 = tile / tiles_per_side * GRID_TILE;
+            long col0 = tile % tiles_per_side * GRID_TILE;
+            long row1 = row0 + GRID_TILE < side ? row0 + GRID_TILE : side;
+            long col1 = col0 + GRID_TILE < side ? col0 + GRID_TILE : side;
+            long n = 0;
+
+            for (long row = row0; row < row1; row++) {
+                double y = MIN_Y + (row + 0.5) * step_y;
+                for (long col = col0; col < col1; col++) {
+                    double x = MIN_X + (col + 0.5) * step_x;
+                    if (mandelbrotContainsFast(x, y)) {
+                        buffer[n].x = x;
+                        buffer[n].y = y;
+                        n++;
+                    }
+                }
+            }
+
+            if (n > 0) {
+                tile_points[tile] = (Point*)malloc(sizeof(Point) * n);
+                if (tile_points[tile] == NULL) {
+#pragma omp atomic write
+                    failed = 1;
+                    continue;
+                }
+                memcpy(tile_points[tile], buffer, sizeof(Point) * n);
+            }
+            tile_count[tile + 1] = n;
+        }
+
+        free(buffer);
+    }
+
+    // Префиксные суммы дают смещение каждой плитки в итоговом массиве
+    for (long tile = 0; tile < ntiles; tile++) {
+        tile_count[tile + 1] += tile_count[tile];
+    }
+
+    Point* points = failed ? NULL : allocPoints(tile_count[ntiles]);
+    if (points != NULL) {
+#pragma omp parallel for schedule(dynamic)
+        for (long tile = 0; tile < ntiles; tile++) {
+            long n = tile_count[tile + 1] - tile_count[tile];
+            if (n > 0) {
+                memcpy(points + tile_count[tile], tile_points[tile], sizeof(Point) * n);
+            }
+        }
+        *count = tile_count[ntiles];
+    }
+
+    for (long tile = 0; tile < ntiles; tile++) {
+        free(tile_points[tile]);
+    }
+    free(tile_points);
+    free(tile_count);
+
+    return points;
+}
+
+// Последовательная запись CSV (формат по умолчанию)
+static int writeCsv(FILE* fp, const Point* points, long count) {
+    fprintf(fp, "x,y\n");
+
+    for (long i = 0; i < count; i++) {
+        fprintf(fp, "%.6f,%.6f\n", points[i].x, points[i].y);
+    }
+
+    return ferror(fp) ? -1 : 0;
+}
+
+// Параллельная запись CSV: куски по CSV_CHUNK_POINTS точек форматируются всеми потоками
+// в собственные буферы, а запись идёт в области ordered строго по порядку кусков.
+// Используется тот же формат, что и в writeCsv, поэтому файл совпадает побайтно.
+static int writeCsvParallel(FILE* fp, const Point* points, long count) {
+    long nchunks = (count + CSV_CHUNK_POINTS - 1) / CSV_CHUNK_POINTS;
+    int failed = 0;
+
+    fprintf(fp, "x,y\n");
+
+#pragma omp parallel
+    {
+        char* buffer = (char*)malloc((size_t)CSV_CHUNK_POINTS * CSV_MAX_LINE);
+
+#pragma omp for ordered schedule(static, 1)
+        for (long c = 0; c < nchunks; c++) {
+            size_t length = 0;
+            long begin = c * CSV_CHUNK_POINTS;
+            long end = begin + CSV_CHUNK_POINTS < count ? begin + CSV_CHUNK_POINTS : count;
+
+            if (buffer != NULL) {
+                for (long i = begin; i < end; i++) {
+                    length += snprintf(buffer + length, CSV_MAX_LINE, "%.6f,%.6f\n", points[i].x, points[i].y);
+                }
+            }
+
+#pragma omp ordered
+            {
+                if (buffer == NULL || fwrite(buffer, 1, length, fp) != length) {
+                    failed = 1;
+                }
+            }
+        }
+
+        free(buffer);
+    }
+
+    return failed || ferror(fp) ? -1 : 0;
+}
+
+// Двоичная запись: заголовок и все координаты одним вызовом fwrite.
+// На big-endian машинах данные сначала переставляются в little-endian.
+static int writeBinary(FILE* fp, Point* points, long count) {
+    uint32_t version = BIN_VERSION;
+    uint64_t n = (uint64_t)count;
+    const uint16_t probe = 1;
+    int big_endian = *(const uint8_t*)&probe == 0;
+
+    if (big_endian) {
+        version = __builtin_bswap32(version);
+        n = __builtin_bswap64(n);
+
+        uint64_t* words = (uint64_t*)points;
+#pragma omp parallel for
+        for (long i = 0; i < 2 * count; i++) {
+            words[i] = __builtin_bswap64(words[i]);
+        }
+    }
+
+    fwrite(BIN_MAGIC, 1, 4, fp);
+    fwrite(&version, sizeof(version), 1, fp);
+    fwrite(&n, sizeof(n), 1, fp);
+    int rc = fwrite(points, sizeof(Point), (size_t)count, fp) == (size_t)count ? 0 : -1;
+
+    if (big_endian) {
+        uint64_t* words = (uint64_t*)points;
+#pragma omp parallel for
+        for (long i = 0; i < 2 * count; i++) {
+            words[i] = __builtin_bswap64(words[i]);
+        }
+    }
+
+    return rc == 0 && !ferror(fp) ? 0 : -1;
+}
+
 int main(int argc, char* argv[]) {
 
-    if (argc != 3) {
-        printf("Usage: %s nthreads npoints\n", argv[0]);
+    if (argc < 3) {
+        printf("Usage: %s nthreads npoints [--mode=sample|grid] [--grid=N]"
+               " [--kernel=auto|scalar|avx2|avx512] [--seed=N] [--format=csv|csv-parallel|bin]"
+               " [--verify]\n", argv[0]);
         return 1;
     }
 
     int nthreads = atoi(argv[1]);
     int npoints = atoi(argv[2]);
+    const char* kernel_name = "auto";
+    int verify = 0;
+    int grid_mode = 0;
+    long grid_side = 0;
+    const char* format = "csv";
+    uint64_t seed = (uint64_t)time(NULL);
 
     if (npoints <= 0 || nthreads <= 0) {
         printf("Error: nthreads and npoints must be positive integers.\n");
         return 1;
     }
 
-    omp_set_num_threads(nthreads);
+    for (int a = 3; a < argc; a++) {
+        if (strncmp(argv[a], "--kernel=", 9) == 0) {
+            kernel_name = argv[a] + 9;
+        }
+        else if (strncmp(argv[a], "--seed=", 7) == 0) {
+            seed = strtoull(argv[a] + 7, NULL, 10);
+        }
+        else if (strcmp(argv[a], "--mode=sample") == 0) {
+            grid_mode = 0;
+        }
+        else if (strcmp(argv[a], "--mode=grid") == 0) {
+            grid_mode = 1;
+        }
+        else if (strncmp(argv[a], "--grid=", 7) == 0) {
+            grid_side = atol(argv[a] + 7);
+            if (grid_side <= 0) {
+                printf("Error: Grid size must be a positive integer.\n");
+                return 1;
+            }
+        }
+        else if (strncmp(argv[a], "--format=", 9) == 0) {
+            format = argv[a] + 9;
+            if (strcmp(format, "csv") != 0 && strcmp(format, "csv-parallel") != 0 && strcmp(format, "bin") != 0) {
+                printf("Error: Unknown output format %s\n", format);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[a], "--verify") == 0) {
+            verify = 1;
+        }
+        else {
+            printf("Error: Unknown option %s\n", argv[a]);
+            return 1;
+        }
+    }
 
-    Point* points = (Point*)malloc(sizeof(Point) * npoints);
-    if (points == NULL) {
-        printf("Error: Memory allocation failed.\n");
+    const char* chosen_kernel;
+    BatchKernel kernel = selectBatchKernel(kernel_name, &chosen_kernel);
+    if (kernel == NULL) {
+        printf("Error: Kernel '%s' is not available on this machine.\n", kernel_name);
         return 1;
     }
 
-    long count = 0;
+    if (grid_mode && grid_side == 0) {
+        double domain_area = (MAX_X - MIN_X) * (MAX_Y - MIN_Y);
+        grid_side = (long)ceil(sqrt(npoints * domain_area / MANDELBROT_AREA));
+    }
 
-    double start_time = omp_get_wtime();
+    omp_set_num_threads(nthreads);
 
-#pragma omp parallel
-    {
-        srand(time(NULL) ^ omp_get_thread_num());
+    long count = 0;
+    Point* points;
 
-        while (1) {
-            long current_count;
+    double start_time = omp_get_wtime();
 
-#pragma omp atomic read
-            current_count = count;
-            if (current_count >= npoints) {
-                break;
-            }
+    if (grid_mode) {
+        points = scanMandelbrotGrid(grid_side, &count);
+    }
+    else {
+        points = allocPoints(npoints);
+        if (points != NULL) {
+            sampleMandelbrot(points, npoints, nthreads, kernel, seed);
+            count = npoints;
+        }
+    }
 
-            double x = (double)rand() / RAND_MAX * (MAX_X - MIN_X) + MIN_X;
-            double y = (double)rand() / RAND_MAX * (MAX_Y - MIN_Y) + MIN_Y;
+    if (points == NULL) {
+        printf("Error: Memory allocation failed.\n");
+        return 1;
+    }
 
-            if (mandelbrotContains(x, y)) {
-                long current_index;
+    double end_time = omp_get_wtime();
+    if (grid_mode) {
+        printf("Calculation completed in %f seconds using %d threads (%ldx%ld grid, %ld points).\n",
+            end_time - start_time, nthreads, grid_side, grid_side, count);
+    }
+    else {
+        printf("Calculation completed in %f seconds using %d threads (%s kernel, seed %llu).\n",
+            end_time - start_time, nthreads, chosen_kernel, (unsigned long long)seed);
+    }
 
-#pragma omp atomic capture
-                current_index = count++;
+    if (verify) {
+        // Сверка со скалярной версией: расхождения возможны только у самой границы множества,
+        // где результат чувствителен к округлению (например, при сжатии умножения и сложения в FMA)
+        long mismatches = 0;
 
-                if (current_index < npoints) {
-                    points[current_index].x = x;
-                    points[current_index].y = y;
-                }
-                else {
-                    break;
+#pragma omp parallel for reduction(+:mismatches)
+        for (long i = 0; i < count; i++) {
+            if (!mandelbrotContains(points[i].x, points[i].y)) {
+                mismatches++;
+            }
+        }
+        printf("Verification: %ld of %ld points rejected by the scalar kernel.\n", mismatches, count);
+
+        // Принятые точки не показывают, какие точки ядро ошибочно отбросило, поэтому
+        // выбранное ядро дополнительно сравнивается со скалярным на фиксированной выборке
+        // сырых кандидатов, включая отвергнутые, и расхождения считаются в обе стороны
+        long false_reject = 0;
+        long false_accept = 0;
+
+#pragma omp parallel for reduction(+:false_reject, false_accept)
+        for (long b = 0; b < VERIFY_BLOCKS; b++) {
+            Rng rng;
+            rngSeed(&rng, seed, VERIFY_STREAM + (uint64_t)b);
+
+            for (int i = 0; i < VERIFY_BATCHES; i++) {
+                double x[BATCH_SIZE], y[BATCH_SIZE];
+                char inside[BATCH_SIZE], expected[BATCH_SIZE];
+                rngNextBlock(&rng, x, MIN_X, MAX_X);
+                rngNextBlock(&rng, y, MIN_Y, MAX_Y);
+
+                kernel(x, y, inside);
+                mandelbrotBatchScalar(x, y, expected);
+
+                for (int k = 0; k < BATCH_SIZE; k++) {
+                    if (expected[k] && !inside[k]) {
+                        false_reject++;
+                    }
+                    else if (!expected[k] && inside[k]) {
+                        false_accept++;
+                    }
                 }
             }
         }
+        printf("Verification: %s kernel rejected %ld and accepted %ld of %ld candidates "
+            "contrary to the scalar kernel.\n", chosen_kernel, false_reject, false_accept,
+            (long)VERIFY_BLOCKS * VERIFY_BATCHES * BATCH_SIZE);
     }
 
-    double end_time = omp_get_wtime();
-    printf("Calculation completed in %f seconds using %d threads.\n", end_time - start_time, nthreads);
+    int binary = strcmp(format, "bin") == 0;
+    const char* output_file = binary ? "mandelbrot.bin" : "mandelbrot.csv";
 
-    FILE* fp = fopen("mandelbrot.csv", "w");
+    FILE* fp = fopen(output_file, binary ? "wb" : "w");
     if (fp == NULL) {
         printf("Error: Could not open file for writing.\n");
         free(points);
         return 1;
     }
 
-    fprintf(fp, "x,y\n");
-
-    for (int i = 0; i < npoints; i++) {
-        fprintf(fp, "%.6f,%.6f\n", points[i].x, points[i].y);
+    double write_start = omp_get_wtime();
+    int rc;
+    if (binary) {
+        rc = writeBinary(fp, points, count);
+    }
+    else if (strcmp(format, "csv-parallel") == 0) {
+        rc = writeCsvParallel(fp, points, count);
+    }
+    else {
+        rc = writeCsv(fp, points, count);
     }
 
-    fclose(fp);
+    if (fclose(fp) != 0) {
+        rc = -1;
+    }
     free(points);
 
-    printf("Results written to mandelbrot.csv\n");
+    if (rc != 0) {
+        printf("Error: Could not write %s\n", output_file);
+        return 1;
+    }
+
+    printf("Results written to %s in %f seconds\n", output_file, omp_get_wtime() - write_start);
 
     return 0;
 
@@ -0,0 +1,340 @@
+#!/bin/bash
+#
+# run_regression.sh - Общий прогон производительности всех лабораторных
+#
+# Собирает firstTask.c, решатель N тел (OpenMP и, если есть nvcc, CUDA)
+# и LAB2_TASK3/bench_rwlock, запускает фиксированные нагрузки на разном
+# числе потоков и с разными политиками привязки и дописывает каждый запуск
+# строкой в results/regression.csv. Время берётся из вывода самих программ:
+#   mandelbrot     - "Calculation completed in X seconds" (omp_get_wtime)
+#   nbody-omp      - "Total simulation time: X seconds" (omp_get_wtime)
+#   nbody-cuda     - "Elapsed time: X seconds" (часы хоста вокруг цикла, события CUDA)
+#   rwlock-custom, rwlock-pthread - median_sec из CSV bench_rwlock (CLOCK_MONOTONIC)
+#
+# Использование:
+#   ./run_regression.sh run [метка]      - прогон; метка по умолчанию - дата и коммит
+#   ./run_regression.sh baseline [метка] - сохранить прогон (по умолчанию последний) как эталон
+#   ./run_regression.sh compare [метка]  - сравнить прогон (по умолчанию последний) с эталоном
+#   ./run_regression.sh list             - прогоны в базе
+#
+# compare сравнивает медианы времени по (нагрузка, потоки, политика) и помечает
+# замедление больше THRESHOLD процентов как REGRESSION; код возврата 1, если
+# регрессии есть.
+#
+# Параметры переопределяются переменными окружения, например:
+#   WORKLOADS="mandelbrot rwlock-custom" THREAD_COUNTS="1 4" POLICIES="none close" ./run_regression.sh run
+#
+# Политики привязки:
+#   none       - без привязки
+#   close      - OMP_PROC_BIND=close OMP_PLACES=cores (bench_rwlock: --pin)
+#   spread     - OMP_PROC_BIND=spread OMP_PLACES=cores (bench_rwlock: --pin)
+#   local      - numactl --cpunodebind=0 --membind=0
+#   interleave - numactl --interleave=all
+# Политики numactl пропускаются, если numactl не установлен.
+#
+# Счётчики cycles, instructions и LLC-load-misses пишет perf stat, если он
+# установлен и разрешён (kernel.perf_event_paranoid); иначе поля пустые.
+
+# Параметры прогона
+WORKLOADS=${WORKLOADS:-"mandelbrot nbody-omp nbody-cuda rwlock-custom rwlock-pthread"}
+THREAD_COUNTS=${THREAD_COUNTS:-"1 2 4 8"}
+POLICIES=${POLICIES:-"none close spread local interleave"}
+NUM_RUNS=${NUM_RUNS:-3}
+THRESHOLD=${THRESHOLD:-5}
+
+# Размеры нагрузок
+MANDEL_POINTS=${MANDEL_POINTS:-2000000}
+NBODY_N=${NBODY_N:-2000}
+NBODY_T_END=${NBODY_T_END:-0.1}
+CUDA_N=${CUDA_N:-16384}
+CUDA_T_END=${CUDA_T_END:-1.0}
+RW_KEYS=${RW_KEYS:-1000}
+RW_OPS=${RW_OPS:-100000}
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+RESULTS_DIR=$ROOT/results
+DB=$RESULTS_DIR/regression.csv
+BASELINE=$RESULTS_DIR/baseline.csv
+HEADER="label,date,host,cpu,commit,workload,threads,policy,run,time_sec,cycles,instructions,llc_misses,ipc"
+
+usage() {
+    echo "Usage: $0 run [label] | baseline [label] | compare [label] | list"
+    exit 1
+}
+
+# Последняя метка в файле базы
+last_label() {
+    awk -F, 'NR > 1 { label = $1 } END { print label }' "$1"
+}
+
+#-----------------------------------------------------------------
+# Сборка всех программ в WORK_DIR; недоступные нагрузки убираются из WORKLOADS
+
+build_all() {
+    local available=""
+
+    for w in $WORKLOADS; do
+        case $w in
+            mandelbrot)
+                gcc -fopenmp -O3 -o "$WORK_DIR/mandelbrot" "$ROOT/firstTask.c" -lm || continue
+                ;;
+            nbody-omp)
+                (cd "$ROOT/LAB2_TASK2/openmp" && gcc -fopenmp -O3 -o "$WORK_DIR/openmp" openmp.c barnes_hut.c \
+                    trajectory.c checkpoint.c input_parser.c -lm) || continue
+                # Случайные тела, как в bench_forces.sh
+                awk -v n="$NBODY_N" 'BEGIN {
+                    srand(1);
+                    print n;
+                    for (i = 0; i < n; i++)
+                        printf "%.6f %.6f %.6f %.6f %.6f %.6f %.6f\n", 1e6 + rand() * 1e8,
+                               rand() * 200 - 100, rand() * 200 - 100, rand() * 200 - 100,
+                               rand() * 0.02 - 0.01, rand() * 0.02 - 0.01, rand() * 0.02 - 0.01;
+                }' > "$WORK_DIR/input_nbody.txt"
+                ;;
+            nbody-cuda)
+                if ! command -v nvcc > /dev/null || ! command -v nvidia-smi > /dev/null || ! nvidia-smi > /dev/null 2>&1; then
+                    echo "Skipping nbody-cuda: no nvcc or CUDA device"
+                    continue
+                fi
+                nvcc -O3 -o "$WORK_DIR/nbody_cuda" "$ROOT/LAB2_TASK2/cuda/nbody_newton.cu" -lpthread || continue
+                ;;
+            rwlock-custom|rwlock-pthread)
+                if [ ! -x "$WORK_DIR/bench_rwlock" ]; then
+                    make -s -C "$ROOT/LAB2_TASK3" BENCH_BIN="$WORK_DIR/bench_rwlock" > /dev/null || continue
+                fi
+                ;;
+            *)
+                echo "Unknown workload: $w"
+                continue
+                ;;
+        esac
+        available="$available $w"
+    done
+    WORKLOADS=$available
+}
+
+#-----------------------------------------------------------------
+# Префикс команды для политики; пустая строка - политика недоступна
+
+policy_prefix() {
+    case $1 in
+        none)       echo "env" ;;
+        close)      echo "env OMP_PROC_BIND=close OMP_PLACES=cores" ;;
+        spread)     echo "env OMP_PROC_BIND=spread OMP_PLACES=cores" ;;
+        local)      command -v numactl > /dev/null && echo "numactl --cpunodebind=0 --membind=0" ;;
+        interleave) command -v numactl > /dev/null && echo "numactl --interleave=all" ;;
+    esac
+}
+
+# Команда нагрузки; перед ней ставятся префикс политики и perf stat
+workload_command() {
+    local workload=$1 threads=$2 policy=$3
+    local pin=""
+
+    [ "$policy" = "close" ] || [ "$policy" = "spread" ] && pin="--pin"
+    case $workload in
+        mandelbrot)     echo "./mandelbrot $threads $MANDEL_POINTS --seed=1 --format=bin" ;;
+        nbody-omp)      echo "env OMP_NUM_THREADS=$threads ./openmp $NBODY_T_END input_nbody.txt" ;;
+        nbody-cuda)     echo "./nbody_cuda --generate=plummer --n=$CUDA_N --t-end=$CUDA_T_END --seed=1" ;;
+        rwlock-custom)  echo "./bench_rwlock --lock=custom --engine=list --threads=$threads --keys=$RW_KEYS --ops=$RW_OPS --runs=1 --format=csv $pin" ;;
+        rwlock-pthread) echo "./bench_rwlock --lock=pthread --engine=list --threads=$threads --keys=$RW_KEYS --ops=$RW_OPS --runs=1 --format=csv $pin" ;;
+    esac
+}
+
+# Время из вывода программы
+parse_time() {
+    case $1 in
+        mandelbrot)  sed -n 's/^Calculation completed in \([0-9.e+-]*\) seconds.*/\1/p' ;;
+        nbody-omp)   sed -n 's/^Total simulation time: \([0-9.e+-]*\) seconds.*/\1/p' ;;
+        nbody-cuda)  sed -n 's/^Elapsed time: \([0-9.e+-]*\) seconds.*/\1/p' ;;
+        rwlock-*)    awk -F, 'NR == 2 { print $11 }' ;;
+    esac
+}
+
+#-----------------------------------------------------------------
+do_run() {
+    local label=$1
+    local commit date host cpu perf_ok=0
+
+    commit=$(git -C "$ROOT" rev-parse --short HEAD 2> /dev/null || echo unknown)
+    git -C "$ROOT" diff --quiet HEAD 2> /dev/null || commit="$commit+"
+    [ -z "$label" ] && label="$(date +%Y%m%d-%H%M%S)-$commit"
+    date=$(date +%Y-%m-%dT%H:%M:%S)
+    host=$(uname -n | tr ',' ' ')
+    if [ "$(uname -s)" = "Darwin" ]; then
+        cpu=$(sysctl -n machdep.cpu.brand_string)
+    else
+        cpu=$(grep -m1 'model name' /proc/cpuinfo | sed 's/.*: //')
+    fi
+    cpu=$(echo "${cpu:-unknown}" | tr ',' ' ')
+
+    if command -v perf > /dev/null && perf stat -x, -e cycles,instructions -o /dev/null true 2> /dev/null; then
+        perf_ok=1
+    else
+        echo "perf stat is not available: hardware counters will be empty"
+    fi
+
+    WORK_DIR=$(mktemp -d)
+    mkdir -p "$RESULTS_DIR"
+    [ -f "$DB" ] || echo "$HEADER" > "$DB"
+
+    echo "=============================================="
+    echo "   REGRESSION RUN: $label"
+    echo "=============================================="
+    echo ""
+    build_all
+    echo "Workloads:  $WORKLOADS"
+    echo "Threads:    $THREAD_COUNTS"
+    echo "Policies:   $POLICIES"
+    echo "Runs:       $NUM_RUNS"
+    echo ""
+
+    for workload in $WORKLOADS; do
+        for policy in $POLICIES; do
+            prefix=$(policy_prefix "$policy")
+            if [ -z "$prefix" ]; then
+                echo "Skipping policy $policy: numactl is not installed"
+                continue
+            fi
+            for threads in $THREAD_COUNTS; do
+                # Решатель CUDA не зависит от числа потоков CPU
+                if [ "$workload" = "nbody-cuda" ] && [ "$threads" != "${THREAD_COUNTS%% *}" ]; then
+                    continue
+                fi
+                cmd=$(workload_command "$workload" "$threads" "$policy")
+                for run in $(seq 1 "$NUM_RUNS"); do
+                    rm -f "$WORK_DIR/perf.txt"
+                    if [ $perf_ok -eq 1 ]; then
+                        out=$(cd "$WORK_DIR" && perf stat -x, -e cycles,instructions,LLC-load-misses \
+                              -o perf.txt -- $prefix $cmd 2> /dev/null)
+                    else
+                        out=$(cd "$WORK_DIR" && $prefix $cmd 2> /dev/null)
+                    fi
+                    time_sec=$(echo "$out" | parse_time "$workload" | head -1)
+                    if [ -z "$time_sec" ]; then
+                        echo "  $workload threads=$threads policy=$policy run=$run: no timing in output, skipped"
+                        continue
+                    fi
+
+                    counters=",,,"
+                    if [ -f "$WORK_DIR/perf.txt" ]; then
+                        counters=$(awk -F, '
+                            $3 ~ /^cycles/          { c = $1 }
+                            $3 ~ /^instructions/    { i = $1 }
+                            $3 ~ /^LLC-load-misses/ { l = $1 }
+                            END {
+                                if (c !~ /^[0-9]+$/) c = ""
+                                if (i !~ /^[0-9]+$/) i = ""
+                                if (l !~ /^[0-9]+$/) l = ""
+                                ipc = (c != "" && i != "" && c > 0) ? sprintf("%.3f", i / c) : ""
+                                print c "," i "," l "," ipc
+                            }' "$WORK_DIR/perf.txt")
+                    fi
+
+                    echo "$label,$date,$host,$cpu,$commit,$workload,$threads,$policy,$run,$time_sec,$counters" >> "$DB"
+                    printf "  %-14s threads=%-3s policy=%-10s run=%s: %s s\n" "$workload" "$threads" "$policy" "$run" "$time_sec"
+                done
+            done
+        done
+    done
+
+    rm -rf "$WORK_DIR"
+    echo ""
+    echo "Results appended to $DB (label $label)"
+}
+
+#-----------------------------------------------------------------
+do_baseline() {
+    local label=${1:-$(last_label "$DB")}
+
+    if [ -z "$label" ] || ! grep -q "^$label," "$DB"; then
+        echo "No run '$label' in $DB"
+        exit 1
+    fi
+    { echo "$HEADER"; grep "^$label," "$DB"; } > "$BASELINE"
+    echo "Baseline set to $label ($(($(wc -l < "$BASELINE") - 1)) rows) in $BASELINE"
+}
+
+do_compare() {
+    local label=${1:-$(last_label "$DB")}
+
+    if [ ! -f "$BASELINE" ]; then
+        echo "No baseline: run '$0 baseline' first"
+        exit 1
+    fi
+    if [ -z "$label" ] || ! grep -q "^$label," "$DB"; then
+        echo "No run '$label' in $DB"
+        exit 1
+    fi
+
+    echo "Baseline: $(last_label "$BASELINE")"
+    echo "Current:  $label"
+    echo "Threshold: $THRESHOLD%"
+    echo ""
+
+    # Медианы времени и IPC по (нагрузка, потоки, политика) в эталоне и прогоне
+    awk -F, -v label="$label" -v threshold="$THRESHOLD" '
+        function median(list,    n, v, i, j, t) {
+            n = split(list, v, " ")
+            for (i = 2; i <= n; i++) {
+                t = v[i] + 0
+                for (j = i - 1; j >= 1 && v[j] + 0 > t; j--) v[j + 1] = v[j]
+                v[j + 1] = t
+            }
+            if (n == 0) return ""
+            return n % 2 ? v[(n + 1) / 2] : (v[n / 2] + v[n / 2 + 1]) / 2
+        }
+        FNR == 1 { file++; next }
+        file == 1 || $1 == label {
+            key = $6 "," $7 "," $8
+            if (file == 1) { base[key] = base[key] " " $10; if ($14 != "") base_ipc[key] = base_ipc[key] " " $14 }
+            else           { cur[key] = cur[key] " " $10;   if ($14 != "") cur_ipc[key] = cur_ipc[key] " " $14 }
+            if (!(key in seen)) { seen[key] = 1; order[++nkeys] = key }
+        }
+        END {
+            printf "%-14s | %-7s | %-10s | %-12s | %-12s | %-9s | %-11s | %s\n",
+                   "Workload", "Threads", "Policy", "Base(s)", "Current(s)", "Change", "IPC b/c", "Status"
+            print "---------------|---------|------------|--------------|--------------|-----------|-------------|-----------"
+            regressions = 0
+            for (k = 1; k <= nkeys; k++) {
+                key = order[k]
+                split(key, f, ",")
+                if (!(key in base) || !(key in cur)) {
+                    status = (key in base) ? "missing" : "new"
+                    printf "%-14s | %-7s | %-10s | %-12s | %-12s | %-9s | %-11s | %s\n", f[1], f[2], f[3],
+                           (key in base) ? median(base[key]) : "-", (key in cur) ? median(cur[key]) : "-", "-", "-", status
+                    continue
+                }
+                b = median(base[key]); c = median(cur[key])
+                change = b > 0 ? (c - b) / b * 100 : 0
+                status = "ok"
+                if (change > threshold) { status = "REGRESSION"; regressions++ }
+                else if (change < -threshold) status = "faster"
+                ipc = (key in base_ipc && key in cur_ipc) ? median(base_ipc[key]) "/" median(cur_ipc[key]) : "-"
+                printf "%-14s | %-7s | %-10s | %-12g | %-12g | %+8.1f%% | %-11s | %s\n",
+                       f[1], f[2], f[3], b, c, change, ipc, status
+            }
+            print ""
+            print regressions " regression(s) over " threshold "%"
+            exit regressions > 0
+        }' "$BASELINE" "$DB"
+}
+
+do_list() {
+    [ -f "$DB" ] || { echo "No results yet: $DB"; exit 0; }
+    awk -F, 'NR > 1 {
+        if (!($1 in rows)) { order[++n] = $1; date[$1] = $2; commit[$1] = $5 }
+        rows[$1]++
+    }
+    END {
+        for (i = 1; i <= n; i++) printf "%-32s %s  %-10s %d rows\n", order[i], date[order[i]], commit[order[i]], rows[order[i]]
+    }' "$DB"
+}
+
+case $1 in
+    run)      do_run "$2" ;;
+    baseline) do_baseline "$2" ;;
+    compare)  do_compare "$2" ;;
+    list)     do_list ;;
+    *)        usage ;;
+esac